@@ -47,6 +47,8 @@ class ApbEnv : public OpenGymEnv
     float GetReward() override;
     std::string GetExtraInfo() override;
     bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+    bool GetObservationFlat(const OpenGymFlatLayout& obs) override;
+    bool ExecuteActionsFlat(const OpenGymFlatLayout& action) override;
 
     uint32_t m_a;
     uint32_t m_b;
@@ -139,6 +141,22 @@ ApbEnv::ExecuteActions(Ptr<OpenGymDataContainer> action)
     return true;
 }
 
+bool
+ApbEnv::GetObservationFlat(const OpenGymFlatLayout& obs)
+{
+    uint32_t* data = obs.GetData<uint32_t>();
+    data[0] = m_a;
+    data[1] = m_b;
+    return true;
+}
+
+bool
+ApbEnv::ExecuteActionsFlat(const OpenGymFlatLayout& action)
+{
+    m_sum = action.GetData<uint32_t>()[0];
+    return true;
+}
+
 } // namespace ns3
 
 int
@@ -146,6 +164,10 @@ main(int argc, char* argv[])
 {
     using namespace ns3;
 
+    // e.g. --OpenGymInterface::EmbeddedAgent=apb to run the agent in the simulation
+    CommandLine cmd;
+    cmd.Parse(argc, argv);
+
     Ptr<ApbEnv> apb = CreateObject<ApbEnv>();
 
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
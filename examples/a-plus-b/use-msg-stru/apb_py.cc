@@ -48,6 +48,8 @@ PYBIND11_MODULE(ns3ai_apb_py_stru, m)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendEnd)
+        .def("PyCheckAttached", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyCheckAttached)
+        .def("PyResetSync", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyResetSync)
         .def("PyGetFinished", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyGetFinished)
         .def("GetCpp2PyStruct",
              &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetCpp2PyStruct,
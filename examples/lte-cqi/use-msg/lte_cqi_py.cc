@@ -54,6 +54,10 @@ PYBIND11_MODULE(ns3ai_ltecqi_py, m)
              &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PySendBegin)
         .def("PySendEnd",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PySendEnd)
+        .def("PyCheckAttached",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PyCheckAttached)
+        .def("PyResetSync",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PyResetSync)
         .def("PyGetFinished",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PyGetFinished)
         .def("GetCpp2PyStruct",
@@ -23,7 +23,6 @@
 #include "tcp-rl-env.h"
 
 #include <iostream>
-#include <numeric>
 
 namespace ns3
 {
@@ -104,11 +103,11 @@ TcpTimeStepEnv::ScheduleNotify()
 {
     Simulator::Schedule(m_timeStep, &TcpTimeStepEnv::ScheduleNotify, this);
 
-    uint64_t bytesInFlightSum = std::accumulate(m_bytesInFlight.begin(), m_bytesInFlight.end(), 0);
-    m_bytesInFlight.clear();
+    uint64_t bytesInFlightSum = m_bytesInFlightSum;
+    m_bytesInFlightSum = 0;
 
-    uint64_t segmentsAckedSum = std::accumulate(m_segmentsAcked.begin(), m_segmentsAcked.end(), 0);
-    m_segmentsAcked.clear();
+    uint64_t segmentsAckedSum = m_segmentsAckedSum;
+    m_segmentsAckedSum = 0;
 
     std::cerr << "At " << (uint64_t)(Simulator::Now().GetMilliSeconds()) << "ms:\n";
     std::cerr << "\tstate --"
@@ -145,7 +144,7 @@ TcpTimeStepEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFligh
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " GetSsThresh, BytesInFlight: " << bytesInFlight);
     m_tcb = tcb;
-    m_bytesInFlight.push_back(bytesInFlight);
+    m_bytesInFlightSum += bytesInFlight;
 
     if (!m_started)
     {
@@ -163,8 +162,8 @@ TcpTimeStepEnv::IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " IncreaseWindow, SegmentsAcked: " << segmentsAcked);
     m_tcb = tcb;
-    m_segmentsAcked.push_back(segmentsAcked);
-    m_bytesInFlight.push_back(tcb->m_bytesInFlight);
+    m_segmentsAckedSum += segmentsAcked;
+    m_bytesInFlightSum += tcb->m_bytesInFlight;
 
     if (!m_started)
     {
@@ -263,11 +262,11 @@ TcpEventBasedEnv::RxPktTrace(Ptr<const Packet>, const TcpHeader&, Ptr<const TcpS
 void
 TcpEventBasedEnv::Notify()
 {
-    uint64_t bytesInFlightSum = std::accumulate(m_bytesInFlight.begin(), m_bytesInFlight.end(), 0);
-    m_bytesInFlight.clear();
+    uint64_t bytesInFlightSum = m_bytesInFlightSum;
+    m_bytesInFlightSum = 0;
 
-    uint64_t segmentsAckedSum = std::accumulate(m_segmentsAcked.begin(), m_segmentsAcked.end(), 0);
-    m_segmentsAcked.clear();
+    uint64_t segmentsAckedSum = m_segmentsAckedSum;
+    m_segmentsAckedSum = 0;
 
     std::cerr << "At " << (uint64_t)(Simulator::Now().GetMilliSeconds()) << "ms:\n";
     std::cerr << "\tstate --"
@@ -304,7 +303,7 @@ TcpEventBasedEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFli
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " GetSsThresh, BytesInFlight: " << bytesInFlight);
     m_tcb = tcb;
-    m_bytesInFlight.push_back(bytesInFlight);
+    m_bytesInFlightSum += bytesInFlight;
 
     Notify();
 
@@ -318,8 +317,8 @@ TcpEventBasedEnv::IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " IncreaseWindow, SegmentsAcked: " << segmentsAcked);
     m_tcb = tcb;
-    m_segmentsAcked.push_back(segmentsAcked);
-    m_bytesInFlight.push_back(tcb->m_bytesInFlight);
+    m_segmentsAckedSum += segmentsAcked;
+    m_bytesInFlightSum += tcb->m_bytesInFlight;
 
     Notify();
 
@@ -90,8 +90,8 @@ class TcpTimeStepEnv : public Object
 
     // state
     Ptr<const TcpSocketState> m_tcb;
-    std::vector<uint32_t> m_bytesInFlight;
-    std::vector<uint32_t> m_segmentsAcked;
+    uint64_t m_bytesInFlightSum{0};
+    uint64_t m_segmentsAckedSum{0};
 
     uint64_t m_rttSampleNum{0};
     Time m_rttSum{MicroSeconds(0.0)};
@@ -136,8 +136,8 @@ class TcpEventBasedEnv : public Object
 
     // state
     Ptr<const TcpSocketState> m_tcb;
-    std::vector<uint32_t> m_bytesInFlight;
-    std::vector<uint32_t> m_segmentsAcked;
+    uint64_t m_bytesInFlightSum{0};
+    uint64_t m_segmentsAckedSum{0};
 
     uint64_t m_rttSampleNum{0};
     Time m_rttSum{MicroSeconds(0.0)};
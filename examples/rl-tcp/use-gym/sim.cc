@@ -286,6 +286,11 @@ main(int argc, char* argv[])
     }
 
     Simulator::Stop(Seconds(stop_time));
+    if (openGymInterface)
+    {
+        // in fork-server mode, every episode starts from here
+        openGymInterface->Checkpoint();
+    }
     Simulator::Run();
 
     if (flow_monitor)
@@ -27,7 +27,6 @@
 #include "ns3/tcp-header.h"
 #include "ns3/tcp-socket-base.h"
 
-#include <numeric>
 #include <vector>
 
 namespace ns3
@@ -208,6 +207,20 @@ TcpEnvBase::ExecuteActions(Ptr<OpenGymDataContainer> action)
     return true;
 }
 
+/*
+Execute received actions in place, when the flat layout is used
+*/
+bool
+TcpEnvBase::ExecuteActionsFlat(const OpenGymFlatLayout& action)
+{
+    const uint32_t* data = action.GetData<uint32_t>();
+    m_new_ssThresh = data[0];
+    m_new_cWnd = data[1];
+
+    NS_LOG_INFO("MyExecuteActionsFlat: " << m_new_ssThresh << ", " << m_new_cWnd);
+    return true;
+}
+
 NS_OBJECT_ENSURE_REGISTERED(TcpTimeStepEnv);
 
 TcpTimeStepEnv::TcpTimeStepEnv()
@@ -308,75 +321,36 @@ TcpTimeStepEnv::GetObservation()
     box->AddValue(m_tcb->m_cWnd);
     box->AddValue(m_tcb->m_segmentSize);
 
-    // bytesInFlightSum
-    uint64_t bytesInFlightSum = std::accumulate(m_bytesInFlight.begin(), m_bytesInFlight.end(), 0);
-    box->AddValue(bytesInFlightSum);
+    // bytesInFlightSum, bytesInFlightAvg
+    m_bytesInFlight.AddTo(box, {OpenGymStreamStats::SUM, OpenGymStreamStats::MEAN});
 
-    // bytesInFlightAvg
-    uint64_t bytesInFlightAvg = 0;
-    if (!m_bytesInFlight.empty())
-    {
-        bytesInFlightAvg = bytesInFlightSum / m_bytesInFlight.size();
-    }
-    box->AddValue(bytesInFlightAvg);
-
-    // segmentsAckedSum
-    uint64_t segmentsAckedSum = std::accumulate(m_segmentsAcked.begin(), m_segmentsAcked.end(), 0);
-    box->AddValue(segmentsAckedSum);
-
-    // segmentsAckedAvg
-    uint64_t segmentsAckedAvg = 0;
-    if (!m_segmentsAcked.empty())
-    {
-        segmentsAckedAvg = segmentsAckedSum / m_segmentsAcked.size();
-    }
-    box->AddValue(segmentsAckedAvg);
+    // segmentsAckedSum, segmentsAckedAvg
+    m_segmentsAcked.AddTo(box, {OpenGymStreamStats::SUM, OpenGymStreamStats::MEAN});
 
     // avgRtt
-    Time avgRtt = Seconds(0.0);
-    if (m_rttSampleNum)
-    {
-        avgRtt = m_rttSum / m_rttSampleNum;
-    }
-    box->AddValue(avgRtt.GetMicroSeconds());
+    box->AddValue(Seconds(m_rtt.GetMean()).GetMicroSeconds());
 
     // m_minRtt
     box->AddValue(m_tcb->m_minRtt.GetMicroSeconds());
 
     // avgInterTx
-    Time avgInterTx = Seconds(0.0);
-    if (m_interTxTimeNum)
-    {
-        avgInterTx = m_interTxTimeSum / m_interTxTimeNum;
-    }
-    box->AddValue(avgInterTx.GetMicroSeconds());
+    box->AddValue(Seconds(m_interTxTime.GetMean()).GetMicroSeconds());
 
     // avgInterRx
-    Time avgInterRx = Seconds(0.0);
-    if (m_interRxTimeNum)
-    {
-        avgInterRx = m_interRxTimeSum / m_interRxTimeNum;
-    }
-    box->AddValue(avgInterRx.GetMicroSeconds());
+    box->AddValue(Seconds(m_interRxTime.GetMean()).GetMicroSeconds());
 
     // throughput  bytes/s
-    float throughput = (segmentsAckedSum * m_tcb->m_segmentSize) / m_timeStep.GetSeconds();
+    float throughput = (m_segmentsAcked.GetSum() * m_tcb->m_segmentSize) / m_timeStep.GetSeconds();
     box->AddValue(throughput);
 
     // Print data
     NS_LOG_INFO("MyGetObservation: " << box);
 
-    m_bytesInFlight.clear();
-    m_segmentsAcked.clear();
-
-    m_rttSampleNum = 0;
-    m_rttSum = MicroSeconds(0.0);
-
-    m_interTxTimeNum = 0;
-    m_interTxTimeSum = MicroSeconds(0.0);
-
-    m_interRxTimeNum = 0;
-    m_interRxTimeSum = MicroSeconds(0.0);
+    m_bytesInFlight.Reset();
+    m_segmentsAcked.Reset();
+    m_rtt.Reset();
+    m_interTxTime.Reset();
+    m_interRxTime.Reset();
 
     return box;
 }
@@ -387,9 +361,7 @@ TcpTimeStepEnv::TxPktTrace(Ptr<const Packet>, const TcpHeader&, Ptr<const TcpSoc
     NS_LOG_FUNCTION(this);
     if (m_lastPktTxTime > MicroSeconds(0.0))
     {
-        Time interTxTime = Simulator::Now() - m_lastPktTxTime;
-        m_interTxTimeSum += interTxTime;
-        m_interTxTimeNum++;
+        m_interTxTime.Add((Simulator::Now() - m_lastPktTxTime).GetSeconds());
     }
 
     m_lastPktTxTime = Simulator::Now();
@@ -401,9 +373,7 @@ TcpTimeStepEnv::RxPktTrace(Ptr<const Packet>, const TcpHeader&, Ptr<const TcpSoc
     NS_LOG_FUNCTION(this);
     if (m_lastPktRxTime > MicroSeconds(0.0))
     {
-        Time interRxTime = Simulator::Now() - m_lastPktRxTime;
-        m_interRxTimeSum += interRxTime;
-        m_interRxTimeNum++;
+        m_interRxTime.Add((Simulator::Now() - m_lastPktRxTime).GetSeconds());
     }
 
     m_lastPktRxTime = Simulator::Now();
@@ -416,7 +386,7 @@ TcpTimeStepEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFligh
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " GetSsThresh, BytesInFlight: " << bytesInFlight);
     m_tcb = tcb;
-    m_bytesInFlight.push_back(bytesInFlight);
+    m_bytesInFlight.Add(bytesInFlight);
 
     if (!m_started)
     {
@@ -436,8 +406,8 @@ TcpTimeStepEnv::IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " IncreaseWindow, SegmentsAcked: " << segmentsAcked);
     m_tcb = tcb;
-    m_segmentsAcked.push_back(segmentsAcked);
-    m_bytesInFlight.push_back(tcb->m_bytesInFlight);
+    m_segmentsAcked.Add(segmentsAcked);
+    m_bytesInFlight.Add(tcb->m_bytesInFlight);
 
     if (!m_started)
     {
@@ -456,8 +426,7 @@ TcpTimeStepEnv::PktsAcked(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked, const
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId << " PktsAcked, SegmentsAcked: "
                                  << segmentsAcked << " Rtt: " << rtt);
     m_tcb = tcb;
-    m_rttSum += rtt;
-    m_rttSampleNum++;
+    m_rtt.Add(rtt.GetSeconds());
 }
 
 void
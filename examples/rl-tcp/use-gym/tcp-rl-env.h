@@ -54,6 +54,7 @@ class TcpEnvBase : public OpenGymEnv
     float GetReward() override;
     std::string GetExtraInfo() override;
     bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+    bool ExecuteActionsFlat(const OpenGymFlatLayout& action) override;
 
     Ptr<OpenGymSpace> GetObservationSpace() override = 0;
     Ptr<OpenGymDataContainer> GetObservation() override = 0;
@@ -129,18 +130,14 @@ class TcpTimeStepEnv : public TcpEnvBase
     Time m_timeStep;
     // state
     Ptr<const TcpSocketState> m_tcb;
-    std::vector<uint32_t> m_bytesInFlight;
-    std::vector<uint32_t> m_segmentsAcked;
-
-    uint64_t m_rttSampleNum{0};
-    Time m_rttSum{MicroSeconds(0.0)};
+    OpenGymStreamStats m_bytesInFlight;
+    OpenGymStreamStats m_segmentsAcked;
+    OpenGymStreamStats m_rtt; ///< in seconds
 
     Time m_lastPktTxTime{MicroSeconds(0.0)};
     Time m_lastPktRxTime{MicroSeconds(0.0)};
-    uint64_t m_interTxTimeNum{0};
-    Time m_interTxTimeSum{MicroSeconds(0.0)};
-    uint64_t m_interRxTimeNum{0};
-    Time m_interRxTimeSum{MicroSeconds(0.0)};
+    OpenGymStreamStats m_interTxTime; ///< in seconds
+    OpenGymStreamStats m_interRxTime; ///< in seconds
 };
 
 class TcpEventBasedEnv : public TcpEnvBase
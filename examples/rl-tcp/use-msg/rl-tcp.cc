@@ -75,6 +75,8 @@ int
 main(int argc, char* argv[])
 {
     double tcpEnvTimeStep = 0.1;
+    bool asyncAction = false;
+    bool batchQueries = false;
     uint32_t nLeaf = 1;
     std::string transport_prot = "TcpRlTimeBased";
     double error_p = 0.0;
@@ -99,6 +101,13 @@ main(int argc, char* argv[])
     cmd.AddValue("envTimeStep",
                  "Time step interval for TcpRlTimeBased. Default: 0.1s",
                  tcpEnvTimeStep);
+    cmd.AddValue("asyncAction",
+                 "Do not wait for Python at each step in TcpRlTimeBased. Default: false",
+                 asyncAction);
+    cmd.AddValue("batchQueries",
+                 "Send queries of all flows at the same time in one message in TcpRlTimeBased. "
+                 "Default: false",
+                 batchQueries);
     cmd.AddValue("nLeaf", "Number of left and right side leaf nodes", nLeaf);
     cmd.AddValue("transport_prot",
                  "Transport protocol to use: TcpNewReno, TcpHybla, TcpHighSpeed, TcpHtcp, "
@@ -129,6 +138,8 @@ main(int argc, char* argv[])
     if (transport_prot == "TcpRlTimeBased")
     {
         Config::SetDefault("ns3::TcpTimeStepEnv::StepTime", TimeValue(Seconds(tcpEnvTimeStep)));
+        Config::SetDefault("ns3::TcpTimeStepEnv::AsyncAction", BooleanValue(asyncAction));
+        Config::SetDefault("ns3::TcpTimeStepEnv::BatchQueries", BooleanValue(batchQueries));
     }
 
     transport_prot = std::string("ns3::") + transport_prot;
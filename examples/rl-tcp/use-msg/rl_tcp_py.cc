@@ -21,10 +21,14 @@
 
 #include <ns3/ai-module.h>
 
+#include <iostream>
 #include <pybind11/pybind11.h>
 
 namespace py = pybind11;
 
+PYBIND11_MAKE_OPAQUE(ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Cpp2PyMsgVector);
+PYBIND11_MAKE_OPAQUE(ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Py2CppMsgVector);
+
 PYBIND11_MODULE(ns3ai_rltcp_msg_py, m)
 {
     py::class_<ns3::TcpRlEnv>(m, "PyEnvStruct")
@@ -44,6 +48,58 @@ PYBIND11_MODULE(ns3ai_rltcp_msg_py, m)
         .def_readwrite("new_ssThresh", &ns3::TcpRlAct::new_ssThresh)
         .def_readwrite("new_cWnd", &ns3::TcpRlAct::new_cWnd);
 
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Cpp2PyMsgVector>(
+        m,
+        "PyEnvVector")
+        .def("resize",
+             static_cast<void (
+                 ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Cpp2PyMsgVector::*)(
+                 ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv,
+                                            ns3::TcpRlAct>::Cpp2PyMsgVector::size_type)>(
+                 &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv,
+                                             ns3::TcpRlAct>::Cpp2PyMsgVector::resize))
+        .def("__len__",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Cpp2PyMsgVector::size)
+        .def(
+            "__getitem__",
+            [](ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Cpp2PyMsgVector& vec,
+               uint32_t i) -> ns3::TcpRlEnv& {
+                if (i >= vec.size())
+                {
+                    std::cerr << "Invalid index " << i << " for vector, whose size is "
+                              << vec.size() << std::endl;
+                    exit(1);
+                }
+                return vec.at(i);
+            },
+            py::return_value_policy::reference);
+
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Py2CppMsgVector>(
+        m,
+        "PyActVector")
+        .def("resize",
+             static_cast<void (
+                 ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Py2CppMsgVector::*)(
+                 ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv,
+                                            ns3::TcpRlAct>::Py2CppMsgVector::size_type)>(
+                 &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv,
+                                             ns3::TcpRlAct>::Py2CppMsgVector::resize))
+        .def("__len__",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Py2CppMsgVector::size)
+        .def(
+            "__getitem__",
+            [](ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::Py2CppMsgVector& vec,
+               uint32_t i) -> ns3::TcpRlAct& {
+                if (i >= vec.size())
+                {
+                    std::cerr << "Invalid index " << i << " for vector, whose size is "
+                              << vec.size() << std::endl;
+                    exit(1);
+                }
+                return vec.at(i);
+            },
+            py::return_value_policy::reference);
+
     py::class_<ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>>(m, "Ns3AiMsgInterfaceImpl")
         .def(py::init<bool,
                       bool,
@@ -57,12 +113,31 @@ PYBIND11_MODULE(ns3ai_rltcp_msg_py, m)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PySendEnd)
+        .def("PyCheckAttached",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyCheckAttached)
+        .def("PyResetSync",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyResetSync)
         .def("PyGetFinished",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyGetFinished)
+        .def("PySetStop", &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PySetStop)
+        .def("PySendControl",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PySendControl)
+        .def("PyRecvControl",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyRecvControl)
+        .def("PyGetControlCode",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyGetControlCode)
+        .def("PyGetControlValue",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::PyGetControlValue)
         .def("GetCpp2PyStruct",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::GetCpp2PyStruct,
              py::return_value_policy::reference)
         .def("GetPy2CppStruct",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::GetPy2CppStruct,
+             py::return_value_policy::reference)
+        .def("GetCpp2PyVector",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::GetCpp2PyVector,
+             py::return_value_policy::reference)
+        .def("GetPy2CppVector",
+             &ns3::Ns3AiMsgInterfaceImpl<ns3::TcpRlEnv, ns3::TcpRlAct>::GetPy2CppVector,
              py::return_value_policy::reference);
 }
@@ -68,6 +68,12 @@ parser.add_argument('--use_rl', action='store_true',
                     help='whether use rl algorithm')
 parser.add_argument('--rl_algo', type=str,
                     default='DeepQ', help='RL Algorithm, Q or DeepQ')
+parser.add_argument('--async_action', action='store_true',
+                    help='whether simulation continues without waiting for actions')
+parser.add_argument('--batch', action='store_true',
+                    help='whether queries of all flows at the same time come in one message')
+parser.add_argument('--max_steps', type=int,
+                    help='request the simulation to stop after this number of steps')
 
 args = parser.parse_args()
 my_seed = 42
@@ -97,12 +103,16 @@ if args.result:
         globals()[res] = []
 
 stepIdx = 0
+numSteps = 0
 
 ns3Settings = {
     'transport_prot': 'TcpRlTimeBased',
     'duration': my_duration,
-    'simSeed': my_sim_seed}
-exp = Experiment("ns3ai_rltcp_msg", "../../../../../", py_binding, handleFinish=True)
+    'simSeed': my_sim_seed,
+    'asyncAction': str(args.async_action).lower(),
+    'batchQueries': str(args.batch).lower()}
+exp = Experiment("ns3ai_rltcp_msg", "../../../../../", py_binding, handleFinish=True,
+                 useVector=args.batch, vectorSize=0)
 msgInterface = exp.run(setting=ns3Settings, show_output=True)
 
 try:
@@ -112,6 +122,37 @@ try:
         if msgInterface.PyGetFinished():
             print("Simulation ended")
             break
+
+        numSteps += 1
+        if args.max_steps and numSteps == args.max_steps:
+            # the stop request does not wait behind data transfers
+            msgInterface.PySetStop()
+
+        if args.batch:
+            # one query per flow, answered in the same order
+            obsVec = msgInterface.GetCpp2PyVector()
+            queries = [(obsVec[i].socketUid,
+                        [obsVec[i].ssThresh, obsVec[i].cWnd, obsVec[i].segmentsAcked,
+                         obsVec[i].segmentSize, obsVec[i].bytesInFlight])
+                       for i in range(len(obsVec))]
+            msgInterface.PyRecvEnd()
+
+            acts = [get_agent(socketId, args.use_rl).get_action(obs)
+                    for socketId, obs in queries]
+
+            msgInterface.PySendBegin()
+            actVec = msgInterface.GetPy2CppVector()
+            actVec.resize(len(acts))
+            for i, act in enumerate(acts):
+                actVec[i].new_cWnd = act[0]
+                actVec[i].new_ssThresh = act[1]
+            msgInterface.PySendEnd()
+
+            if args.show_log:
+                print("Step:", stepIdx, "batch size:", len(acts))
+                stepIdx += 1
+            continue
+
         ssThresh = msgInterface.GetCpp2PyStruct().ssThresh
         cWnd = msgInterface.GetCpp2PyStruct().cWnd
         segmentsAcked = msgInterface.GetCpp2PyStruct().segmentsAcked
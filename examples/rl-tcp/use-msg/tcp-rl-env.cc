@@ -22,8 +22,8 @@
 
 #include "tcp-rl-env.h"
 
+#include <algorithm>
 #include <iostream>
-#include <numeric>
 
 namespace ns3
 {
@@ -57,11 +57,43 @@ TcpTimeStepEnv::GetTypeId()
                                           "Step interval used in TCP env. Default: 100ms",
                                           TimeValue(MilliSeconds(100)),
                                           MakeTimeAccessor(&TcpTimeStepEnv::m_timeStep),
-                                          MakeTimeChecker());
+                                          MakeTimeChecker())
+                            .AddAttribute("AsyncAction",
+                                          "Do not wait for Python at each step, but continue "
+                                          "with the latest action available. Default: false",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&TcpTimeStepEnv::m_asyncAction),
+                                          MakeBooleanChecker())
+                            .AddAttribute("BatchQueries",
+                                          "Send queries of all flows at the same time to Python "
+                                          "in one vector message. Default: false",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&TcpTimeStepEnv::m_batchQueries),
+                                          MakeBooleanChecker());
 
     return tid;
 }
 
+void
+TcpTimeStepEnv::NotifyConstructionCompleted()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_asyncAction && m_batchQueries,
+                    "AsyncAction and BatchQueries cannot be enabled together");
+    auto interface = Ns3AiMsgInterface::Get();
+    interface->SetAsync(m_asyncAction);
+    interface->SetUseVector(m_batchQueries);
+    Object::NotifyConstructionCompleted();
+}
+
+Ns3AiMsgBatcher<TcpRlEnv, TcpRlAct>*
+TcpTimeStepEnv::GetBatcher()
+{
+    static Ns3AiMsgBatcher<TcpRlEnv, TcpRlAct> batcher(
+        Ns3AiMsgInterface::Get()->GetInterface<TcpRlEnv, TcpRlAct>());
+    return &batcher;
+}
+
 void
 TcpTimeStepEnv::SetNodeId(uint32_t id)
 {
@@ -107,13 +139,73 @@ TcpTimeStepEnv::RxPktTrace(Ptr<const Packet>, const TcpHeader&, Ptr<const TcpSoc
 void
 TcpTimeStepEnv::ScheduleNotify()
 {
-    Simulator::Schedule(m_timeStep, &TcpTimeStepEnv::ScheduleNotify, this);
-
     Ns3AiMsgInterfaceImpl<TcpRlEnv, TcpRlAct>* msgInterface =
         Ns3AiMsgInterface::Get()->GetInterface<TcpRlEnv, TcpRlAct>();
+    if (msgInterface->CppGetStopRequested())
+    {
+        NS_LOG_INFO("Python requested to stop at " << Simulator::Now().As(Time::S));
+        Simulator::Stop();
+        return;
+    }
 
-    msgInterface->CppSendBegin();
-    auto env = msgInterface->GetCpp2PyStruct();
+    Simulator::Schedule(m_timeStep, &TcpTimeStepEnv::ScheduleNotify, this);
+
+    if (m_batchQueries)
+    {
+        // the action is applied when the batch is flushed, at the current time
+        TcpRlEnv env;
+        FillEnv(&env);
+        GetBatcher()->Submit(env, MakeCallback(&TcpTimeStepEnv::ApplyAction, this));
+        ResetStats();
+        return;
+    }
+
+    // in async mode, the observation is skipped (and accumulated into the next
+    // one) if Python is still reading the previous observation
+    bool canSend = true;
+    if (m_asyncAction)
+    {
+        canSend = msgInterface->CppTrySendBegin();
+    }
+    else
+    {
+        canSend = msgInterface->CppSendBegin();
+    }
+
+    if (canSend)
+    {
+        FillEnv(msgInterface->GetCpp2PyStruct());
+        msgInterface->CppSendEnd(Simulator::Now().GetTimeStep());
+    }
+
+    // in async mode, the latest action is applied if one has arrived,
+    // otherwise the previous action is kept
+    bool canRecv = true;
+    if (m_asyncAction)
+    {
+        canRecv = msgInterface->CppTryRecvBegin();
+    }
+    else
+    {
+        canRecv = msgInterface->CppRecvBegin();
+    }
+
+    if (canRecv)
+    {
+        ApplyAction(*msgInterface->GetPy2CppStruct());
+        m_actStaleSteps = msgInterface->CppGetReplyStaleness();
+        m_actStaleTime = Simulator::Now() - TimeStep(msgInterface->CppGetReplyStamp());
+        msgInterface->CppRecvEnd();
+        NS_LOG_DEBUG("Node " << m_nodeId << " action is " << m_actStaleSteps << " steps ("
+                             << m_actStaleTime.As(Time::MS) << ") stale");
+    }
+
+    ResetStats();
+}
+
+void
+TcpTimeStepEnv::FillEnv(TcpRlEnv* env)
+{
     env->socketUid = m_socketUuid;
     env->envType = 1;
     env->simTime_us = Simulator::Now().GetMicroSeconds();
@@ -122,13 +214,13 @@ TcpTimeStepEnv::ScheduleNotify()
     env->cWnd = m_tcb->m_cWnd;
     env->segmentSize = m_tcb->m_segmentSize;
 
-    uint64_t bytesInFlightSum = std::accumulate(m_bytesInFlight.begin(), m_bytesInFlight.end(), 0);
+    uint64_t bytesInFlightSum = m_bytesInFlightSum;
     env->bytesInFlight = bytesInFlightSum;
-    m_bytesInFlight.clear();
+    m_bytesInFlightSum = 0;
 
-    uint64_t segmentsAckedSum = std::accumulate(m_segmentsAcked.begin(), m_segmentsAcked.end(), 0);
+    uint64_t segmentsAckedSum = m_segmentsAckedSum;
     env->segmentsAcked = segmentsAckedSum;
-    m_segmentsAcked.clear();
+    m_segmentsAckedSum = 0;
     //  std::cerr << "At " << (uint64_t)(Simulator::Now().GetMilliSeconds()) << "ms:\n";
     //  std::cerr << "\tstate --"
     //            << " ssThresh=" << env->ssThresh
@@ -137,18 +229,23 @@ TcpTimeStepEnv::ScheduleNotify()
     //            << " segmentAcked=" << env->segmentsAcked
     //            << " bytesInFlightSum=" << bytesInFlightSum
     //            << std::endl;
-    msgInterface->CppSendEnd();
-
-    msgInterface->CppRecvBegin();
-    auto act = msgInterface->GetPy2CppStruct();
-    m_new_cWnd = act->new_cWnd;
-    m_new_ssThresh = act->new_ssThresh;
-    msgInterface->CppRecvEnd();
+}
 
+void
+TcpTimeStepEnv::ApplyAction(const TcpRlAct& act)
+{
+    m_new_cWnd = act.new_cWnd;
+    m_new_ssThresh = act.new_ssThresh;
+    m_hasAction = true;
     //  std::cerr << "\taction --"
     //            << " new_cWnd=" << m_new_cWnd
     //            << " new_ssThresh=" << m_new_ssThresh
     //            << std::endl;
+}
+
+void
+TcpTimeStepEnv::ResetStats()
+{
     m_rttSampleNum = 0;
     m_rttSum = MicroSeconds(0.0);
 
@@ -166,7 +263,7 @@ TcpTimeStepEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFligh
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " GetSsThresh, BytesInFlight: " << bytesInFlight);
     m_tcb = tcb;
-    m_bytesInFlight.push_back(bytesInFlight);
+    m_bytesInFlightSum += bytesInFlight;
 
     if (!m_started)
     {
@@ -174,6 +271,12 @@ TcpTimeStepEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFligh
         ScheduleNotify();
     }
 
+    // no action has arrived yet (async mode), fall back to NewReno's rule
+    if (!m_hasAction)
+    {
+        return std::max(2 * tcb->m_segmentSize, bytesInFlight / 2);
+    }
+
     // action
     return m_new_ssThresh;
 }
@@ -185,16 +288,19 @@ TcpTimeStepEnv::IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " IncreaseWindow, SegmentsAcked: " << segmentsAcked);
     m_tcb = tcb;
-    m_segmentsAcked.push_back(segmentsAcked);
-    m_bytesInFlight.push_back(tcb->m_bytesInFlight);
+    m_segmentsAckedSum += segmentsAcked;
+    m_bytesInFlightSum += tcb->m_bytesInFlight;
 
     if (!m_started)
     {
         m_started = true;
         ScheduleNotify();
     }
-    // action
-    tcb->m_cWnd = m_new_cWnd;
+    // action (in async mode, keep the window untouched until an action arrives)
+    if (m_hasAction)
+    {
+        tcb->m_cWnd = m_new_cWnd;
+    }
 }
 
 void
@@ -302,7 +408,13 @@ TcpEventBasedEnv::Notify()
     Ns3AiMsgInterfaceImpl<TcpRlEnv, TcpRlAct>* msgInterface =
         Ns3AiMsgInterface::Get()->GetInterface<TcpRlEnv, TcpRlAct>();
 
-    msgInterface->CppSendBegin();
+    // Python requested to stop, and nothing must be written
+    if (!msgInterface->CppSendBegin())
+    {
+        NS_LOG_INFO("Python requested to stop at " << Simulator::Now().As(Time::S));
+        Simulator::Stop();
+        return;
+    }
     auto env = msgInterface->GetCpp2PyStruct();
     env->socketUid = m_socketUuid;
     env->envType = 1;
@@ -312,13 +424,13 @@ TcpEventBasedEnv::Notify()
     env->cWnd = m_tcb->m_cWnd;
     env->segmentSize = m_tcb->m_segmentSize;
 
-    uint64_t bytesInFlightSum = std::accumulate(m_bytesInFlight.begin(), m_bytesInFlight.end(), 0);
+    uint64_t bytesInFlightSum = m_bytesInFlightSum;
     env->bytesInFlight = bytesInFlightSum;
-    m_bytesInFlight.clear();
+    m_bytesInFlightSum = 0;
 
-    uint64_t segmentsAckedSum = std::accumulate(m_segmentsAcked.begin(), m_segmentsAcked.end(), 0);
+    uint64_t segmentsAckedSum = m_segmentsAckedSum;
     env->segmentsAcked = segmentsAckedSum;
-    m_segmentsAcked.clear();
+    m_segmentsAckedSum = 0;
     std::cerr << "At " << (uint64_t)(Simulator::Now().GetMilliSeconds()) << "ms:\n";
     std::cerr << "\tstate --"
               << " ssThresh=" << env->ssThresh << " cWnd=" << env->cWnd
@@ -326,7 +438,12 @@ TcpEventBasedEnv::Notify()
               << " bytesInFlightSum=" << bytesInFlightSum << std::endl;
     msgInterface->CppSendEnd();
 
-    msgInterface->CppRecvBegin();
+    if (!msgInterface->CppRecvBegin())
+    {
+        NS_LOG_INFO("Python requested to stop at " << Simulator::Now().As(Time::S));
+        Simulator::Stop();
+        return;
+    }
     auto act = msgInterface->GetPy2CppStruct();
     m_new_cWnd = act->new_cWnd;
     m_new_ssThresh = act->new_ssThresh;
@@ -351,7 +468,7 @@ TcpEventBasedEnv::GetSsThresh(Ptr<const TcpSocketState> tcb, uint32_t bytesInFli
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " GetSsThresh, BytesInFlight: " << bytesInFlight);
     m_tcb = tcb;
-    m_bytesInFlight.push_back(bytesInFlight);
+    m_bytesInFlightSum += bytesInFlight;
 
     Notify();
 
@@ -366,8 +483,8 @@ TcpEventBasedEnv::IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked
     NS_LOG_INFO(Simulator::Now() << " Node: " << m_nodeId
                                  << " IncreaseWindow, SegmentsAcked: " << segmentsAcked);
     m_tcb = tcb;
-    m_segmentsAcked.push_back(segmentsAcked);
-    m_bytesInFlight.push_back(tcb->m_bytesInFlight);
+    m_segmentsAckedSum += segmentsAcked;
+    m_bytesInFlightSum += tcb->m_bytesInFlight;
 
     Notify();
 
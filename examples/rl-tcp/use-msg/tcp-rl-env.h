@@ -70,6 +70,9 @@ class TcpTimeStepEnv : public Object
     void CongestionStateSet(Ptr<TcpSocketState> tcb, const TcpSocketState::TcpCongState_t newState);
     void CwndEvent(Ptr<TcpSocketState> tcb, const TcpSocketState::TcpCAEvent_t event);
 
+  protected:
+    void NotifyConstructionCompleted() override;
+
   private:
     uint32_t m_nodeId;
     uint32_t m_socketUuid;
@@ -84,13 +87,26 @@ class TcpTimeStepEnv : public Object
     uint32_t m_new_ssThresh;
     uint32_t m_new_cWnd;
     void ScheduleNotify();
+    void FillEnv(TcpRlEnv* env);
+    void ApplyAction(const TcpRlAct& act);
+    void ResetStats();
     bool m_started{false};
     Time m_timeStep;
 
+    // batch mode: queries of all flows at the same time are sent in one message
+    bool m_batchQueries;
+    static Ns3AiMsgBatcher<TcpRlEnv, TcpRlAct>* GetBatcher();
+
+    // async mode: simulation continues with the latest action available
+    bool m_asyncAction;
+    bool m_hasAction{false};
+    uint64_t m_actStaleSteps{0};
+    Time m_actStaleTime{MicroSeconds(0.0)};
+
     // state
     Ptr<const TcpSocketState> m_tcb;
-    std::vector<uint32_t> m_bytesInFlight;
-    std::vector<uint32_t> m_segmentsAcked;
+    uint64_t m_bytesInFlightSum{0};
+    uint64_t m_segmentsAckedSum{0};
 
     uint64_t m_rttSampleNum{0};
     Time m_rttSum{MicroSeconds(0.0)};
@@ -133,8 +149,8 @@ class TcpEventBasedEnv : public Object
 
     // state
     Ptr<const TcpSocketState> m_tcb;
-    std::vector<uint32_t> m_bytesInFlight;
-    std::vector<uint32_t> m_segmentsAcked;
+    uint64_t m_bytesInFlightSum{0};
+    uint64_t m_segmentsAckedSum{0};
 
     uint64_t m_rttSampleNum{0};
     Time m_rttSum{MicroSeconds(0.0)};
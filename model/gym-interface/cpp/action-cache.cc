@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "action-cache.h"
+
+#include <ns3/log.h>
+
+#include <iterator>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymActionCache");
+
+OpenGymActionCache::OpenGymActionCache()
+    : m_capacity(0),
+      m_hits(0),
+      m_misses(0)
+{
+}
+
+void
+OpenGymActionCache::SetCapacity(uint32_t capacity)
+{
+    NS_LOG_FUNCTION(this << capacity);
+    m_capacity = capacity;
+    Clear();
+    m_index.reserve(capacity);
+}
+
+bool
+OpenGymActionCache::IsEnabled() const
+{
+    return m_capacity > 0;
+}
+
+std::string*
+OpenGymActionCache::Lookup(std::string_view observation)
+{
+    auto it = m_index.find(observation);
+    if (it == m_index.end())
+    {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->second;
+}
+
+void
+OpenGymActionCache::Insert(std::string_view observation, std::string_view action)
+{
+    if (!m_capacity)
+    {
+        return;
+    }
+    auto it = m_index.find(observation);
+    if (it != m_index.end())
+    {
+        it->second->second.assign(action.data(), action.size());
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+    if (m_entries.size() < m_capacity)
+    {
+        m_entries.emplace_front();
+    }
+    else
+    {
+        // the least recently used entry takes the new one, keeping its buffers
+        m_index.erase(m_entries.back().first);
+        m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+    }
+    Entry& entry = m_entries.front();
+    entry.first.assign(observation.data(), observation.size());
+    entry.second.assign(action.data(), action.size());
+    m_index[entry.first] = m_entries.begin();
+}
+
+void
+OpenGymActionCache::Clear()
+{
+    NS_LOG_FUNCTION(this);
+    m_index.clear();
+    m_entries.clear();
+}
+
+uint32_t
+OpenGymActionCache::GetSize() const
+{
+    return m_entries.size();
+}
+
+uint64_t
+OpenGymActionCache::GetHits() const
+{
+    return m_hits;
+}
+
+uint64_t
+OpenGymActionCache::GetMisses() const
+{
+    return m_misses;
+}
+
+} // namespace ns3
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_ACTION_CACHE_H
+#define OPENGYM_ACTION_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace ns3
+{
+
+/**
+ * \brief Actions of an agent keyed by the bytes of their observation.
+ *
+ * With a frozen deterministic policy, e.g. during evaluation, an observation
+ * seen before gets the same action, which the cache returns instead of the
+ * agent. The observations are hashed, and compared in full, so that a hit
+ * is exact. The least recently used action is evicted once the cache is
+ * full, reusing its storage.
+ */
+class OpenGymActionCache
+{
+  public:
+    OpenGymActionCache();
+
+    /**
+     * Set the largest number of actions, 0 to disable the cache. Cached
+     * actions are dropped.
+     */
+    void SetCapacity(uint32_t capacity);
+    bool IsEnabled() const;
+
+    /**
+     * Get the action of the observation, which becomes the most recently
+     * used, or null if it is not cached
+     */
+    std::string* Lookup(std::string_view observation);
+
+    /**
+     * Cache the action of an observation, as the most recently used
+     */
+    void Insert(std::string_view observation, std::string_view action);
+
+    /**
+     * Drop all the actions, e.g. after the policy changed
+     */
+    void Clear();
+
+    uint32_t GetSize() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+  private:
+    /// observation and action
+    using Entry = std::pair<std::string, std::string>;
+
+    uint32_t m_capacity;
+    std::list<Entry> m_entries; ///< most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index; ///< by observation
+    uint64_t m_hits;
+    uint64_t m_misses;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_ACTION_CACHE_H
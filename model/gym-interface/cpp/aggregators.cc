@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "aggregators.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymAggregators");
+
+OpenGymStreamStats::OpenGymStreamStats()
+    : m_alpha(0),
+      m_ewma(0),
+      m_ewmaStarted(false),
+      m_last(0)
+{
+    Reset();
+}
+
+void
+OpenGymStreamStats::SetEwmaAlpha(double alpha)
+{
+    NS_LOG_FUNCTION(this << alpha);
+    NS_ABORT_MSG_IF(alpha < 0 || alpha > 1, "The EWMA weight must be in (0, 1], or 0");
+    m_alpha = alpha;
+}
+
+void
+OpenGymStreamStats::Add(double value)
+{
+    ++m_count;
+    m_sum += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+    if (m_alpha > 0)
+    {
+        m_ewma = m_ewmaStarted ? m_ewma + m_alpha * (value - m_ewma) : value;
+        m_ewmaStarted = true;
+    }
+    m_last = value;
+}
+
+void
+OpenGymStreamStats::Reset()
+{
+    m_count = 0;
+    m_sum = 0;
+    m_min = std::numeric_limits<double>::infinity();
+    m_max = -std::numeric_limits<double>::infinity();
+    m_mean = 0;
+    m_m2 = 0;
+}
+
+void
+OpenGymStreamStats::Clear()
+{
+    Reset();
+    m_ewma = 0;
+    m_ewmaStarted = false;
+    m_last = 0;
+}
+
+uint64_t
+OpenGymStreamStats::GetCount() const
+{
+    return m_count;
+}
+
+double
+OpenGymStreamStats::GetSum() const
+{
+    return m_sum;
+}
+
+double
+OpenGymStreamStats::GetMean() const
+{
+    return m_mean;
+}
+
+double
+OpenGymStreamStats::GetMin() const
+{
+    return m_count ? m_min : 0;
+}
+
+double
+OpenGymStreamStats::GetMax() const
+{
+    return m_count ? m_max : 0;
+}
+
+double
+OpenGymStreamStats::GetVariance() const
+{
+    return m_count ? m_m2 / m_count : 0;
+}
+
+double
+OpenGymStreamStats::GetStdDev() const
+{
+    return std::sqrt(GetVariance());
+}
+
+double
+OpenGymStreamStats::GetEwma() const
+{
+    return m_ewma;
+}
+
+double
+OpenGymStreamStats::GetLast() const
+{
+    return m_last;
+}
+
+double
+OpenGymStreamStats::Get(Statistic statistic) const
+{
+    switch (statistic)
+    {
+    case COUNT:
+        return static_cast<double>(m_count);
+    case SUM:
+        return GetSum();
+    case MEAN:
+        return GetMean();
+    case MIN:
+        return GetMin();
+    case MAX:
+        return GetMax();
+    case VARIANCE:
+        return GetVariance();
+    case STDDEV:
+        return GetStdDev();
+    case EWMA:
+        return GetEwma();
+    case LAST:
+        return GetLast();
+    }
+    NS_ABORT_MSG("Unknown statistic " << statistic);
+    return 0;
+}
+
+OpenGymStreamQuantile::OpenGymStreamQuantile(double p)
+    : m_p(p)
+{
+    NS_ABORT_MSG_IF(p < 0 || p > 1, "The quantile must be in [0, 1]");
+    Reset();
+}
+
+void
+OpenGymStreamQuantile::Add(double value)
+{
+    if (m_count < 5)
+    {
+        m_heights[m_count++] = value;
+        if (m_count == 5)
+        {
+            std::sort(m_heights, m_heights + 5);
+        }
+        return;
+    }
+    ++m_count;
+
+    // cell of the value, extending the extremes
+    int k;
+    if (value < m_heights[0])
+    {
+        m_heights[0] = value;
+        k = 0;
+    }
+    else if (value >= m_heights[4])
+    {
+        m_heights[4] = value;
+        k = 3;
+    }
+    else
+    {
+        k = static_cast<int>(std::upper_bound(m_heights + 1, m_heights + 4, value) - m_heights) -
+            1;
+    }
+    for (int i = k + 1; i < 5; ++i)
+    {
+        m_positions[i] += 1;
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        m_desired[i] += m_increments[i];
+    }
+
+    // move the middle markers towards their desired positions
+    for (int i = 1; i < 4; ++i)
+    {
+        double d = m_desired[i] - m_positions[i];
+        if ((d >= 1 && m_positions[i + 1] - m_positions[i] > 1) ||
+            (d <= -1 && m_positions[i - 1] - m_positions[i] < -1))
+        {
+            int step = d > 0 ? 1 : -1;
+            double height = Parabolic(i, step);
+            if (m_heights[i - 1] < height && height < m_heights[i + 1])
+            {
+                m_heights[i] = height;
+            }
+            else
+            {
+                m_heights[i] = Linear(i, step);
+            }
+            m_positions[i] += step;
+        }
+    }
+}
+
+double
+OpenGymStreamQuantile::Parabolic(int i, int d) const
+{
+    const double* q = m_heights;
+    const double* n = m_positions;
+    return q[i] + d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+double
+OpenGymStreamQuantile::Linear(int i, int d) const
+{
+    return m_heights[i] +
+           d * (m_heights[i + d] - m_heights[i]) / (m_positions[i + d] - m_positions[i]);
+}
+
+void
+OpenGymStreamQuantile::Reset()
+{
+    m_count = 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        m_heights[i] = 0;
+        m_positions[i] = i + 1;
+    }
+    m_desired[0] = 1;
+    m_desired[1] = 1 + 2 * m_p;
+    m_desired[2] = 1 + 4 * m_p;
+    m_desired[3] = 3 + 2 * m_p;
+    m_desired[4] = 5;
+    m_increments[0] = 0;
+    m_increments[1] = m_p / 2;
+    m_increments[2] = m_p;
+    m_increments[3] = (1 + m_p) / 2;
+    m_increments[4] = 1;
+}
+
+uint64_t
+OpenGymStreamQuantile::GetCount() const
+{
+    return m_count;
+}
+
+double
+OpenGymStreamQuantile::Get() const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    if (m_count < 5)
+    {
+        double sorted[5];
+        std::copy(m_heights, m_heights + m_count, sorted);
+        std::sort(sorted, sorted + m_count);
+        return sorted[static_cast<uint64_t>(std::lround(m_p * (m_count - 1)))];
+    }
+    return m_heights[2];
+}
+
+OpenGymNormalizer::OpenGymNormalizer()
+    : m_clip(0),
+      m_frozen(false)
+{
+    Reset();
+}
+
+void
+OpenGymNormalizer::SetClip(double clip)
+{
+    NS_ABORT_MSG_IF(clip < 0, "The clip of a normalizer must be positive, or 0");
+    m_clip = clip;
+}
+
+void
+OpenGymNormalizer::SetFrozen(bool frozen)
+{
+    m_frozen = frozen;
+}
+
+void
+OpenGymNormalizer::Add(double value)
+{
+    if (m_frozen)
+    {
+        return;
+    }
+    ++m_count;
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+}
+
+void
+OpenGymNormalizer::Reset()
+{
+    m_count = 0;
+    m_mean = 0;
+    m_m2 = 0;
+}
+
+double
+OpenGymNormalizer::Normalize(double value) const
+{
+    double stdDev = GetStdDev();
+    if (stdDev <= 0)
+    {
+        return 0;
+    }
+    double z = (value - m_mean) / stdDev;
+    return m_clip > 0 ? std::clamp(z, -m_clip, m_clip) : z;
+}
+
+double
+OpenGymNormalizer::AddAndNormalize(double value)
+{
+    Add(value);
+    return Normalize(value);
+}
+
+uint64_t
+OpenGymNormalizer::GetCount() const
+{
+    return m_count;
+}
+
+double
+OpenGymNormalizer::GetMean() const
+{
+    return m_mean;
+}
+
+double
+OpenGymNormalizer::GetStdDev() const
+{
+    return m_count > 1 ? std::sqrt(m_m2 / m_count) : 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_AGGREGATORS_H
+#define OPENGYM_AGGREGATORS_H
+
+#include "container.h"
+
+#include <ns3/callback.h>
+#include <ns3/nstime.h>
+#include <ns3/object.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * Value of a sample for the aggregators, in seconds for a Time
+ */
+template <typename T>
+inline double
+OpenGymSampleValue(const T& value)
+{
+    return static_cast<double>(value);
+}
+
+inline double
+OpenGymSampleValue(const Time& value)
+{
+    return value.GetSeconds();
+}
+
+/**
+ * Size of an object with GetSize, e.g. the bytes of a Ptr<const Packet>
+ */
+template <typename T>
+inline double
+OpenGymSampleValue(const Ptr<T>& value)
+{
+    return static_cast<double>(value->GetSize());
+}
+
+/**
+ * \brief Connection of an aggregator to trace sources.
+ *
+ * Reducer is the aggregator, which gets the samples with Add(double). The
+ * aggregator must outlive the connections and must not be moved, since the
+ * callbacks are bound to it.
+ */
+template <typename Reducer>
+class OpenGymTraceSink
+{
+  public:
+    /**
+     * Callback adding the value of a TracedCallback<T>
+     */
+    template <typename T>
+    Callback<void, T> MakeSampleCallback()
+    {
+        return MakeCallback(&OpenGymTraceSink::template RecordSample<T>, this);
+    }
+
+    /**
+     * Callback adding the new value of a TracedValue<T>
+     */
+    template <typename T>
+    Callback<void, T, T> MakeValueCallback()
+    {
+        return MakeCallback(&OpenGymTraceSink::template RecordValue<T>, this);
+    }
+
+    template <typename T>
+    bool ConnectSample(Ptr<Object> object, const std::string& traceName)
+    {
+        return object->TraceConnectWithoutContext(traceName, MakeSampleCallback<T>());
+    }
+
+    template <typename T>
+    bool ConnectValue(Ptr<Object> object, const std::string& traceName)
+    {
+        return object->TraceConnectWithoutContext(traceName, MakeValueCallback<T>());
+    }
+
+  private:
+    template <typename T>
+    void RecordSample(T value)
+    {
+        static_cast<Reducer*>(this)->Add(OpenGymSampleValue(value));
+    }
+
+    template <typename T>
+    void RecordValue(T oldValue, T newValue)
+    {
+        static_cast<Reducer*>(this)->Add(OpenGymSampleValue(newValue));
+    }
+};
+
+/**
+ * \brief Statistics of the samples of a window, e.g. a step.
+ *
+ * Every sample costs a few arithmetic operations and no memory: the count,
+ * sum, extremes, and the mean and variance with Welford's algorithm. The
+ * EWMA, if enabled, and the last sample span the windows, e.g. the current
+ * value of a TracedValue that did not change during a step.
+ */
+class OpenGymStreamStats : public OpenGymTraceSink<OpenGymStreamStats>
+{
+  public:
+    enum Statistic
+    {
+        COUNT,
+        SUM,
+        MEAN,
+        MIN,
+        MAX,
+        VARIANCE,
+        STDDEV,
+        EWMA,
+        LAST,
+    };
+
+    OpenGymStreamStats();
+
+    /**
+     * Set the weight of a new sample in the EWMA, in (0, 1], or 0 to disable it
+     */
+    void SetEwmaAlpha(double alpha);
+
+    void Add(double value);
+
+    /**
+     * Start a window, keeping the EWMA and the last sample
+     */
+    void Reset();
+
+    /**
+     * Reset the EWMA and the last sample as well
+     */
+    void Clear();
+
+    uint64_t GetCount() const;
+    double GetSum() const;
+    /// the statistics of an empty window are 0
+    double GetMean() const;
+    double GetMin() const;
+    double GetMax() const;
+    /// population variance
+    double GetVariance() const;
+    double GetStdDev() const;
+    /// 0 before the first sample
+    double GetEwma() const;
+    /// 0 before the first sample
+    double GetLast() const;
+
+    double Get(Statistic statistic) const;
+
+    /**
+     * Append statistics to a Box, e.g. an observation being built
+     */
+    template <typename T>
+    bool AddTo(Ptr<OpenGymBoxContainer<T>> box,
+               std::initializer_list<Statistic> statistics) const
+    {
+        for (Statistic statistic : statistics)
+        {
+            if (!box->AddValue(static_cast<T>(Get(statistic))))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Write a statistic into an existing element of a Box, e.g. a container
+     * reused across steps
+     */
+    template <typename T>
+    bool SetIn(Ptr<OpenGymBoxContainer<T>> box, uint32_t idx, Statistic statistic) const
+    {
+        return box->SetValue(idx, static_cast<T>(Get(statistic)));
+    }
+
+  private:
+    uint64_t m_count;
+    double m_sum;
+    double m_min;
+    double m_max;
+    double m_mean;
+    double m_m2; ///< sum of the squared deviations from the mean
+    double m_alpha;
+    double m_ewma;
+    bool m_ewmaStarted;
+    double m_last;
+};
+
+/**
+ * \brief Approximate quantile of the samples of a window.
+ *
+ * The P-square algorithm of Jain and Chlamtac keeps five markers, whose
+ * heights are adjusted with every sample, so that the memory and the cost of
+ * a sample do not depend on their number. The quantile is exact up to five
+ * samples.
+ */
+class OpenGymStreamQuantile : public OpenGymTraceSink<OpenGymStreamQuantile>
+{
+  public:
+    /**
+     * \param p the quantile, in [0, 1], e.g. 0.99
+     */
+    OpenGymStreamQuantile(double p = 0.5);
+
+    void Add(double value);
+    void Reset();
+
+    uint64_t GetCount() const;
+    /// 0 for an empty window
+    double Get() const;
+
+  private:
+    double Parabolic(int i, int d) const;
+    double Linear(int i, int d) const;
+
+    double m_p;
+    uint64_t m_count;
+    double m_heights[5];
+    double m_positions[5];
+    double m_desired[5];
+    double m_increments[5];
+};
+
+/**
+ * \brief Online normalization of a feature.
+ *
+ * The mean and variance of all the samples added, not reset per step, give
+ * the standard score of a value, clipped to [-clip, clip]. Freeze the
+ * statistics for evaluation.
+ */
+class OpenGymNormalizer : public OpenGymTraceSink<OpenGymNormalizer>
+{
+  public:
+    OpenGymNormalizer();
+
+    /**
+     * Set the bound of the normalized values, 0 for none
+     */
+    void SetClip(double clip);
+
+    /**
+     * Stop updating the statistics with the samples added
+     */
+    void SetFrozen(bool frozen);
+
+    void Add(double value);
+    void Reset();
+
+    /**
+     * Normalize a value with the statistics of the samples, 0 before the
+     * second sample
+     */
+    double Normalize(double value) const;
+
+    /**
+     * Add a sample, and normalize it
+     */
+    double AddAndNormalize(double value);
+
+    uint64_t GetCount() const;
+    double GetMean() const;
+    double GetStdDev() const;
+
+  private:
+    double m_clip;
+    bool m_frozen;
+    uint64_t m_count;
+    double m_mean;
+    double m_m2; ///< sum of the squared deviations from the mean
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_AGGREGATORS_H
@@ -21,8 +21,11 @@
 
 #include "container.h"
 
+#include <ns3/abort.h>
 #include <ns3/log.h>
 
+#include <cstring>
+
 namespace ns3
 {
 
@@ -166,6 +169,157 @@ OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3_ai_gym::DataContainer& da
     return actDataContainer;
 }
 
+namespace
+{
+
+template <typename T>
+Ptr<OpenGymBoxContainer<T>>
+CreateBoxFromPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>();
+    NS_ABORT_MSG_IF(!box->UpdateFromDataPbMsgV2(dataPbMsg),
+                    "Box data of type " << ns3_ai_gym::DataType_Name(dataPbMsg.box().dtype())
+                                        << " cannot be read");
+    return box;
+}
+
+float
+HalfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f)
+    {
+        // infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // subnormal half is a normal float
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+Ptr<OpenGymDataContainer>
+OpenGymDataContainer::CreateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg,
+                                            Ptr<OpenGymDataContainer> reuse)
+{
+    if (reuse && reuse->UpdateFromDataPbMsgV2(dataPbMsg))
+    {
+        return reuse;
+    }
+
+    Ptr<OpenGymDataContainer> actDataContainer;
+
+    switch (dataPbMsg.data_case())
+    {
+    case ns3_ai_gym::DataV2::kDiscrete: {
+        Ptr<OpenGymDiscreteContainer> discrete = CreateObject<OpenGymDiscreteContainer>();
+        discrete->SetValue(dataPbMsg.discrete());
+        actDataContainer = discrete;
+        break;
+    }
+    case ns3_ai_gym::DataV2::kBox: {
+        const ns3_ai_gym::BoxDataV2& boxPbMsg = dataPbMsg.box();
+        switch (boxPbMsg.dtype())
+        {
+        case ns3_ai_gym::INT8:
+            actDataContainer = CreateBoxFromPbMsgV2<int8_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::INT16:
+            actDataContainer = CreateBoxFromPbMsgV2<int16_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::INT32:
+            actDataContainer = CreateBoxFromPbMsgV2<int32_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::INT64:
+            actDataContainer = CreateBoxFromPbMsgV2<int64_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::UINT8:
+        case ns3_ai_gym::BOOL:
+            // numpy stores bool in one byte, and C++ sees it as uint8_t
+            actDataContainer = CreateBoxFromPbMsgV2<uint8_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::UINT16:
+            actDataContainer = CreateBoxFromPbMsgV2<uint16_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::UINT32:
+            actDataContainer = CreateBoxFromPbMsgV2<uint32_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::UINT64:
+            actDataContainer = CreateBoxFromPbMsgV2<uint64_t>(dataPbMsg);
+            break;
+        case ns3_ai_gym::FLOAT16: {
+            // C++ has no half type, convert to float
+            const std::string& bytes = boxPbMsg.data();
+            NS_ABORT_MSG_IF(bytes.size() % sizeof(uint16_t) != 0,
+                            "Box data of " << bytes.size()
+                                           << " bytes is not a whole number of elements");
+            std::vector<uint32_t> shape(boxPbMsg.shape().begin(), boxPbMsg.shape().end());
+            Ptr<OpenGymBoxContainer<float>> box = CreateObject<OpenGymBoxContainer<float>>(shape);
+            for (std::size_t i = 0; i < bytes.size(); i += sizeof(uint16_t))
+            {
+                uint16_t half;
+                std::memcpy(&half, bytes.data() + i, sizeof(half));
+                box->AddValue(HalfToFloat(half));
+            }
+            actDataContainer = box;
+            break;
+        }
+        case ns3_ai_gym::FLOAT64:
+            actDataContainer = CreateBoxFromPbMsgV2<double>(dataPbMsg);
+            break;
+        default:
+            actDataContainer = CreateBoxFromPbMsgV2<float>(dataPbMsg);
+            break;
+        }
+        break;
+    }
+    case ns3_ai_gym::DataV2::kTuple: {
+        Ptr<OpenGymTupleContainer> tupleData = CreateObject<OpenGymTupleContainer>();
+        for (const auto& element : dataPbMsg.tuple().element())
+        {
+            tupleData->Add(OpenGymDataContainer::CreateFromDataPbMsgV2(element));
+        }
+        actDataContainer = tupleData;
+        break;
+    }
+    case ns3_ai_gym::DataV2::kDict: {
+        Ptr<OpenGymDictContainer> dictData = CreateObject<OpenGymDictContainer>();
+        for (const auto& element : dataPbMsg.dict().element())
+        {
+            dictData->Add(element.name(), OpenGymDataContainer::CreateFromDataPbMsgV2(element));
+        }
+        actDataContainer = dictData;
+        break;
+    }
+    default:
+        break;
+    }
+    return actDataContainer;
+}
+
 TypeId
 OpenGymDiscreteContainer::GetTypeId()
 {
@@ -217,6 +371,23 @@ OpenGymDiscreteContainer::GetDataContainerPbMsg()
     return dataContainerPbMsg;
 }
 
+void
+OpenGymDiscreteContainer::FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg,
+                                          OpenGymPayloadArea* payload)
+{
+    dataPbMsg->set_discrete(GetValue());
+}
+
+bool
+OpenGymDiscreteContainer::UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    if (!dataPbMsg.has_discrete())
+    {
+        return false;
+    }
+    return SetValue(dataPbMsg.discrete());
+}
+
 bool
 OpenGymDiscreteContainer::SetValue(uint32_t value)
 {
@@ -289,6 +460,41 @@ OpenGymTupleContainer::GetDataContainerPbMsg()
     return dataContainerPbMsg;
 }
 
+void
+OpenGymTupleContainer::FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg,
+                                       OpenGymPayloadArea* payload)
+{
+    auto elements = dataPbMsg->mutable_tuple()->mutable_element();
+    int idx = 0;
+    for (auto it = m_tuple.begin(); it != m_tuple.end(); ++it, ++idx)
+    {
+        (*it)->FillDataPbMsgV2(idx < elements->size() ? elements->Mutable(idx) : elements->Add(),
+                               payload);
+    }
+    while (elements->size() > idx)
+    {
+        elements->RemoveLast();
+    }
+}
+
+bool
+OpenGymTupleContainer::UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    if (!dataPbMsg.has_tuple() || dataPbMsg.tuple().element_size() != (int)m_tuple.size())
+    {
+        return false;
+    }
+    int idx = 0;
+    for (auto it = m_tuple.begin(); it != m_tuple.end(); ++it, ++idx)
+    {
+        if (!(*it)->UpdateFromDataPbMsgV2(dataPbMsg.tuple().element(idx)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool
 OpenGymTupleContainer::Add(Ptr<OpenGymDataContainer> space)
 {
@@ -388,6 +594,43 @@ OpenGymDictContainer::GetDataContainerPbMsg()
     return dataContainerPbMsg;
 }
 
+void
+OpenGymDictContainer::FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg,
+                                      OpenGymPayloadArea* payload)
+{
+    auto elements = dataPbMsg->mutable_dict()->mutable_element();
+    int idx = 0;
+    for (auto it = m_dict.begin(); it != m_dict.end(); ++it, ++idx)
+    {
+        ns3_ai_gym::DataV2* element =
+            idx < elements->size() ? elements->Mutable(idx) : elements->Add();
+        it->second->FillDataPbMsgV2(element, payload);
+        element->set_name(it->first);
+    }
+    while (elements->size() > idx)
+    {
+        elements->RemoveLast();
+    }
+}
+
+bool
+OpenGymDictContainer::UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    if (!dataPbMsg.has_dict() || dataPbMsg.dict().element_size() != (int)m_dict.size())
+    {
+        return false;
+    }
+    for (const auto& element : dataPbMsg.dict().element())
+    {
+        auto it = m_dict.find(element.name());
+        if (it == m_dict.end() || !it->second->UpdateFromDataPbMsgV2(element))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool
 OpenGymDictContainer::Add(std::string key, Ptr<OpenGymDataContainer> data)
 {
@@ -408,6 +651,17 @@ OpenGymDictContainer::Get(std::string key)
     return data;
 }
 
+std::vector<std::string>
+OpenGymDictContainer::GetKeys() const
+{
+    std::vector<std::string> keys;
+    for (const auto& it : m_dict)
+    {
+        keys.push_back(it.first);
+    }
+    return keys;
+}
+
 void
 OpenGymDictContainer::Print(std::ostream& where) const
 {
@@ -23,10 +23,16 @@
 #define OPENGYM_CONTAINER_H
 
 #include "messages.pb.h"
+#include "payload-area.h"
+#include "spaces.h"
 
+#include <ns3/abort.h>
 #include <ns3/object.h>
 #include <ns3/type-name.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace ns3
 {
 
@@ -42,6 +48,28 @@ class OpenGymDataContainer : public Object
     static Ptr<OpenGymDataContainer> CreateFromDataContainerPbMsg(
         ns3_ai_gym::DataContainer& dataContainer);
 
+    /**
+     * Write the data into a protocol v2 message, reusing its fields. Box data
+     * larger than the threshold of the payload area is written there instead,
+     * unless payload is null.
+     */
+    virtual void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) = 0;
+
+    /**
+     * Overwrite the data in place with a protocol v2 message. Returns false,
+     * possibly after a partial update, if the message does not have the
+     * structure and element types of the container.
+     */
+    virtual bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) = 0;
+
+    /**
+     * Create a container from a protocol v2 message. If reuse is given and
+     * can be updated in place from the message, it is returned instead.
+     */
+    static Ptr<OpenGymDataContainer> CreateFromDataPbMsgV2(
+        const ns3_ai_gym::DataV2& dataPbMsg,
+        Ptr<OpenGymDataContainer> reuse = Ptr<OpenGymDataContainer>());
+
     virtual void Print(std::ostream& where) const = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const Ptr<OpenGymDataContainer> container)
@@ -66,6 +94,8 @@ class OpenGymDiscreteContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) override;
+    bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) override;
 
     void Print(std::ostream& where) const override;
 
@@ -98,6 +128,8 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) override;
+    bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) override;
 
     void Print(std::ostream& where) const override;
 
@@ -110,10 +142,18 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     bool AddValue(T value);
     T GetValue(uint32_t idx);
 
-    bool SetData(std::vector<T> data);
-    std::vector<T> GetData();
+    /**
+     * Set the value of an existing element
+     */
+    bool SetValue(uint32_t idx, T value);
+
+    /**
+     * Copy the data, reusing the storage of the container if large enough
+     */
+    bool SetData(const std::vector<T>& data);
+    const std::vector<T>& GetData() const;
 
-    std::vector<uint32_t> GetShape();
+    const std::vector<uint32_t>& GetShape() const;
 
   protected:
     // Inherited
@@ -124,6 +164,7 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     void SetDtype();
     std::vector<uint32_t> m_shape;
     ns3_ai_gym::Dtype m_dtype;
+    ns3_ai_gym::DataType m_dataType;
     std::vector<T> m_data;
 };
 
@@ -182,6 +223,7 @@ OpenGymBoxContainer<T>::SetDtype()
     {
         m_dtype = ns3_ai_gym::FLOAT;
     }
+    m_dataType = OpenGymGetDataType(name);
 }
 
 template <typename T>
@@ -203,11 +245,11 @@ OpenGymBoxContainer<T>::GetDataContainerPbMsg()
     ns3_ai_gym::DataContainer dataContainerPbMsg;
     ns3_ai_gym::BoxDataContainer boxContainerPbMsg;
 
-    std::vector<uint32_t> shape = GetShape();
+    const std::vector<uint32_t>& shape = GetShape();
     *boxContainerPbMsg.mutable_shape() = {shape.begin(), shape.end()};
 
     boxContainerPbMsg.set_dtype(m_dtype);
-    std::vector<T> data = GetData();
+    const std::vector<T>& data = GetData();
 
     if (m_dtype == ns3_ai_gym::INT)
     {
@@ -235,6 +277,53 @@ OpenGymBoxContainer<T>::GetDataContainerPbMsg()
     return dataContainerPbMsg;
 }
 
+template <typename T>
+void
+OpenGymBoxContainer<T>::FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg,
+                                        OpenGymPayloadArea* payload)
+{
+    ns3_ai_gym::BoxDataV2* boxPbMsg = dataPbMsg->mutable_box();
+    boxPbMsg->set_dtype(m_dataType);
+    boxPbMsg->mutable_shape()->Clear();
+    boxPbMsg->mutable_shape()->Add(m_shape.begin(), m_shape.end());
+    // a message reused after sparse data would still be read as sparse
+    boxPbMsg->clear_sparse();
+    uint32_t size = m_data.size() * sizeof(T);
+    if (payload && payload->Write(m_data.data(), size, boxPbMsg->mutable_payload()))
+    {
+        boxPbMsg->mutable_data()->clear();
+        return;
+    }
+    boxPbMsg->clear_payload();
+    // assign() reuses the buffer of the field, set_data() would build a new string
+    boxPbMsg->mutable_data()->assign(reinterpret_cast<const char*>(m_data.data()), size);
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    if (!dataPbMsg.has_box())
+    {
+        return false;
+    }
+    // numpy stores bool in one byte, and C++ sees it as uint8_t
+    ns3_ai_gym::DataType dataType = dataPbMsg.box().dtype();
+    if (dataType != m_dataType &&
+        !(dataType == ns3_ai_gym::BOOL && m_dataType == ns3_ai_gym::UINT8))
+    {
+        return false;
+    }
+    const ns3_ai_gym::BoxDataV2& boxPbMsg = dataPbMsg.box();
+    const std::string& bytes = boxPbMsg.data();
+    NS_ABORT_MSG_IF(bytes.size() % sizeof(T) != 0,
+                    "Box data of " << bytes.size() << " bytes is not a whole number of elements");
+    m_shape.assign(boxPbMsg.shape().begin(), boxPbMsg.shape().end());
+    m_data.resize(bytes.size() / sizeof(T));
+    std::memcpy(m_data.data(), bytes.data(), bytes.size());
+    return true;
+}
+
 template <typename T>
 bool
 OpenGymBoxContainer<T>::AddValue(T value)
@@ -257,22 +346,34 @@ OpenGymBoxContainer<T>::GetValue(uint32_t idx)
 
 template <typename T>
 bool
-OpenGymBoxContainer<T>::SetData(std::vector<T> data)
+OpenGymBoxContainer<T>::SetValue(uint32_t idx, T value)
+{
+    if (idx >= m_data.size())
+    {
+        return false;
+    }
+    m_data[idx] = value;
+    return true;
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetData(const std::vector<T>& data)
 {
     m_data = data;
     return true;
 }
 
 template <typename T>
-std::vector<uint32_t>
-OpenGymBoxContainer<T>::GetShape()
+const std::vector<uint32_t>&
+OpenGymBoxContainer<T>::GetShape() const
 {
     return m_shape;
 }
 
 template <typename T>
-std::vector<T>
-OpenGymBoxContainer<T>::GetData()
+const std::vector<T>&
+OpenGymBoxContainer<T>::GetData() const
 {
     return m_data;
 }
@@ -295,6 +396,302 @@ OpenGymBoxContainer<T>::Print(std::ostream& where) const
     where << "]";
 }
 
+/**
+ * Box whose data is mostly zero, stored as its nonzero elements, with their
+ * row-major index in the shape (COO). The data is sent the same way, so the
+ * memory and the messages grow with the nonzero elements, not the shape.
+ * Its space is OpenGymSparseBoxSpace.
+ */
+template <typename T = float>
+class OpenGymSparseBoxContainer : public OpenGymDataContainer
+{
+  public:
+    OpenGymSparseBoxContainer();
+    OpenGymSparseBoxContainer(std::vector<uint32_t> shape);
+    ~OpenGymSparseBoxContainer() override;
+
+    static TypeId GetTypeId();
+
+    ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) override;
+    bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) override;
+
+    void Print(std::ostream& where) const override;
+
+    friend std::ostream& operator<<(std::ostream& os,
+                                    const Ptr<OpenGymSparseBoxContainer> container)
+    {
+        container->Print(os);
+        return os;
+    }
+
+    /**
+     * Add an element which is not set yet, in constant time, e.g. when
+     * filling the container after Clear()
+     */
+    bool AddValue(uint32_t idx, T value);
+
+    /**
+     * Set the value of an element, in time linear in the nonzero elements
+     */
+    bool SetValue(uint32_t idx, T value);
+    T GetValue(uint32_t idx) const;
+
+    /**
+     * Remove all the elements, keeping the storage for the next ones
+     */
+    void Clear();
+
+    const std::vector<uint32_t>& GetIndex() const;
+    const std::vector<T>& GetValues() const;
+    const std::vector<uint32_t>& GetShape() const;
+
+    /**
+     * Get all the elements, zeros included
+     */
+    std::vector<T> GetDenseData() const;
+
+  protected:
+    // Inherited
+    void DoInitialize() override;
+    void DoDispose() override;
+
+  private:
+    void SetCount();
+    std::vector<uint32_t> m_shape;
+    uint64_t m_count; ///< elements of the shape
+    ns3_ai_gym::DataType m_dataType;
+    std::vector<uint32_t> m_index;
+    std::vector<T> m_values;
+};
+
+template <typename T>
+TypeId
+OpenGymSparseBoxContainer<T>::GetTypeId()
+{
+    std::string name = TypeNameGet<T>();
+    static TypeId tid = TypeId("ns3::OpenGymSparseBoxContainer<" + name + ">")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .template AddConstructor<OpenGymSparseBoxContainer<T>>();
+    return tid;
+}
+
+template <typename T>
+OpenGymSparseBoxContainer<T>::OpenGymSparseBoxContainer()
+    : m_dataType(OpenGymGetDataType(TypeNameGet<T>()))
+{
+    SetCount();
+}
+
+template <typename T>
+OpenGymSparseBoxContainer<T>::OpenGymSparseBoxContainer(std::vector<uint32_t> shape)
+    : m_shape(shape),
+      m_dataType(OpenGymGetDataType(TypeNameGet<T>()))
+{
+    SetCount();
+}
+
+template <typename T>
+OpenGymSparseBoxContainer<T>::~OpenGymSparseBoxContainer()
+{
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::SetCount()
+{
+    m_count = 1;
+    for (uint32_t dim : m_shape)
+    {
+        m_count *= dim;
+    }
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::DoDispose()
+{
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::DoInitialize()
+{
+}
+
+template <typename T>
+ns3_ai_gym::DataContainer
+OpenGymSparseBoxContainer<T>::GetDataContainerPbMsg()
+{
+    // protocol v1 has no sparse data
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>(m_shape);
+    box->SetData(GetDenseData());
+    return box->GetDataContainerPbMsg();
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg,
+                                              OpenGymPayloadArea* payload)
+{
+    // the nonzero elements are small enough to stay inline
+    ns3_ai_gym::BoxDataV2* boxPbMsg = dataPbMsg->mutable_box();
+    boxPbMsg->set_dtype(m_dataType);
+    boxPbMsg->mutable_shape()->Clear();
+    boxPbMsg->mutable_shape()->Add(m_shape.begin(), m_shape.end());
+    boxPbMsg->mutable_data()->clear();
+    boxPbMsg->clear_payload();
+    boxPbMsg->clear_delta();
+    ns3_ai_gym::BoxSparseV2* sparse = boxPbMsg->mutable_sparse();
+    sparse->mutable_index()->assign(reinterpret_cast<const char*>(m_index.data()),
+                                    m_index.size() * sizeof(uint32_t));
+    sparse->mutable_values()->assign(reinterpret_cast<const char*>(m_values.data()),
+                                     m_values.size() * sizeof(T));
+}
+
+template <typename T>
+bool
+OpenGymSparseBoxContainer<T>::UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg)
+{
+    if (!dataPbMsg.has_box())
+    {
+        return false;
+    }
+    // numpy stores bool in one byte, and C++ sees it as uint8_t
+    ns3_ai_gym::DataType dataType = dataPbMsg.box().dtype();
+    if (dataType != m_dataType &&
+        !(dataType == ns3_ai_gym::BOOL && m_dataType == ns3_ai_gym::UINT8))
+    {
+        return false;
+    }
+    const ns3_ai_gym::BoxDataV2& boxPbMsg = dataPbMsg.box();
+    m_shape.assign(boxPbMsg.shape().begin(), boxPbMsg.shape().end());
+    SetCount();
+    Clear();
+    if (boxPbMsg.has_sparse())
+    {
+        const std::string& index = boxPbMsg.sparse().index();
+        const std::string& values = boxPbMsg.sparse().values();
+        NS_ABORT_MSG_IF(index.size() % sizeof(uint32_t) != 0 ||
+                            values.size() != index.size() / sizeof(uint32_t) * sizeof(T),
+                        "Sparse Box data of " << index.size() << " bytes of index and "
+                                              << values.size() << " bytes of values");
+        m_index.resize(index.size() / sizeof(uint32_t));
+        std::memcpy(m_index.data(), index.data(), index.size());
+        m_values.resize(m_index.size());
+        std::memcpy(m_values.data(), values.data(), values.size());
+        return true;
+    }
+
+    // dense data, e.g. an action sent by Python, keeps its nonzero elements
+    const std::string& bytes = boxPbMsg.data();
+    NS_ABORT_MSG_IF(bytes.size() % sizeof(T) != 0,
+                    "Box data of " << bytes.size() << " bytes is not a whole number of elements");
+    for (uint32_t i = 0; i < bytes.size() / sizeof(T); ++i)
+    {
+        T value;
+        std::memcpy(&value, bytes.data() + i * sizeof(T), sizeof(T));
+        if (value != T(0))
+        {
+            m_index.push_back(i);
+            m_values.push_back(value);
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool
+OpenGymSparseBoxContainer<T>::AddValue(uint32_t idx, T value)
+{
+    if (idx >= m_count)
+    {
+        return false;
+    }
+    m_index.push_back(idx);
+    m_values.push_back(value);
+    return true;
+}
+
+template <typename T>
+bool
+OpenGymSparseBoxContainer<T>::SetValue(uint32_t idx, T value)
+{
+    if (idx >= m_count)
+    {
+        return false;
+    }
+    auto it = std::find(m_index.begin(), m_index.end(), idx);
+    if (it == m_index.end())
+    {
+        return AddValue(idx, value);
+    }
+    m_values[it - m_index.begin()] = value;
+    return true;
+}
+
+template <typename T>
+T
+OpenGymSparseBoxContainer<T>::GetValue(uint32_t idx) const
+{
+    auto it = std::find(m_index.begin(), m_index.end(), idx);
+    return it == m_index.end() ? T(0) : m_values[it - m_index.begin()];
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::Clear()
+{
+    m_index.clear();
+    m_values.clear();
+}
+
+template <typename T>
+const std::vector<uint32_t>&
+OpenGymSparseBoxContainer<T>::GetIndex() const
+{
+    return m_index;
+}
+
+template <typename T>
+const std::vector<T>&
+OpenGymSparseBoxContainer<T>::GetValues() const
+{
+    return m_values;
+}
+
+template <typename T>
+const std::vector<uint32_t>&
+OpenGymSparseBoxContainer<T>::GetShape() const
+{
+    return m_shape;
+}
+
+template <typename T>
+std::vector<T>
+OpenGymSparseBoxContainer<T>::GetDenseData() const
+{
+    std::vector<T> data(m_count, T(0));
+    for (std::size_t i = 0; i < m_index.size(); ++i)
+    {
+        data[m_index[i]] = m_values[i];
+    }
+    return data;
+}
+
+template <typename T>
+void
+OpenGymSparseBoxContainer<T>::Print(std::ostream& where) const
+{
+    where << "{";
+    for (std::size_t i = 0; i < m_index.size(); ++i)
+    {
+        where << (i ? ", " : "") << m_index[i] << ": " << std::to_string(m_values[i]);
+    }
+    where << "}";
+}
+
 class OpenGymTupleContainer : public OpenGymDataContainer
 {
   public:
@@ -304,6 +701,8 @@ class OpenGymTupleContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) override;
+    bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) override;
 
     void Print(std::ostream& where) const override;
 
@@ -333,6 +732,8 @@ class OpenGymDictContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataPbMsgV2(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload) override;
+    bool UpdateFromDataPbMsgV2(const ns3_ai_gym::DataV2& dataPbMsg) override;
 
     void Print(std::ostream& where) const override;
 
@@ -344,6 +745,7 @@ class OpenGymDictContainer : public OpenGymDataContainer
 
     bool Add(std::string key, Ptr<OpenGymDataContainer> value);
     Ptr<OpenGymDataContainer> Get(std::string key);
+    std::vector<std::string> GetKeys() const;
 
   protected:
     // Inherited
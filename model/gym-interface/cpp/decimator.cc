@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "decimator.h"
+
+#include "container.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymDecimator");
+
+namespace
+{
+
+template <typename T>
+double
+ElementAt(const char* data, uint32_t idx)
+{
+    T value;
+    std::memcpy(&value, data + idx * sizeof(T), sizeof(T));
+    return static_cast<double>(value);
+}
+
+/**
+ * Get an element of Box data as a double. Returns false for element types
+ * without a C++ counterpart.
+ */
+bool
+GetElement(const std::string& data, ns3_ai_gym::DataType dataType, uint32_t idx, double* value)
+{
+    switch (dataType)
+    {
+    case ns3_ai_gym::INT8:
+        *value = ElementAt<int8_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::INT16:
+        *value = ElementAt<int16_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::INT32:
+        *value = ElementAt<int32_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::INT64:
+        *value = ElementAt<int64_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::UINT8:
+    case ns3_ai_gym::BOOL:
+        *value = ElementAt<uint8_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::UINT16:
+        *value = ElementAt<uint16_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::UINT32:
+        *value = ElementAt<uint32_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::UINT64:
+        *value = ElementAt<uint64_t>(data.data(), idx);
+        break;
+    case ns3_ai_gym::FLOAT32:
+        *value = ElementAt<float>(data.data(), idx);
+        break;
+    case ns3_ai_gym::FLOAT64:
+        *value = ElementAt<double>(data.data(), idx);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+OpenGymDecimator::OpenGymDecimator()
+    : m_repeat(1),
+      m_tolerance(0),
+      m_stack(1),
+      m_decided(false),
+      m_steps(0),
+      m_reward(0)
+{
+}
+
+void
+OpenGymDecimator::SetRepeat(uint32_t repeat)
+{
+    m_repeat = std::max<uint32_t>(repeat, 1);
+}
+
+uint32_t
+OpenGymDecimator::GetRepeat() const
+{
+    return m_repeat;
+}
+
+void
+OpenGymDecimator::SetTolerance(double tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+void
+OpenGymDecimator::SetStack(uint32_t stack)
+{
+    m_stack = std::max<uint32_t>(stack, 1);
+}
+
+bool
+OpenGymDecimator::IsPassThrough() const
+{
+    return m_repeat == 1 && !NeedsObservation();
+}
+
+bool
+OpenGymDecimator::NeedsObservation() const
+{
+    return m_tolerance > 0 || m_stack > 1;
+}
+
+bool
+OpenGymDecimator::StackSpace(ns3_ai_gym::SpaceV2* space) const
+{
+    if (!space->has_box() || space->box().sparse())
+    {
+        return false;
+    }
+    ns3_ai_gym::BoxSpaceV2* box = space->mutable_box();
+    box->mutable_shape()->Add(m_stack);
+    std::rotate(box->mutable_shape()->rbegin(),
+                box->mutable_shape()->rbegin() + 1,
+                box->mutable_shape()->rend());
+    // bounds given per element are repeated for every observation
+    if (box->low_size() > 1)
+    {
+        std::vector<double> low(box->low().begin(), box->low().end());
+        std::vector<double> high(box->high().begin(), box->high().end());
+        for (uint32_t i = 1; i < m_stack; ++i)
+        {
+            box->mutable_low()->Add(low.begin(), low.end());
+            box->mutable_high()->Add(high.begin(), high.end());
+        }
+    }
+    return true;
+}
+
+void
+OpenGymDecimator::Reset()
+{
+    m_decided = false;
+    m_steps = 0;
+    m_reward = 0;
+    m_decisionObs.Clear();
+    m_history.clear();
+    m_action = nullptr;
+}
+
+bool
+OpenGymDecimator::Step(ns3_ai_gym::DataV2* obs, float* reward, bool isGameOver)
+{
+    NS_LOG_FUNCTION(this << *reward << isGameOver);
+    m_reward += *reward;
+    ++m_steps;
+    if (m_stack > 1)
+    {
+        NS_ABORT_MSG_IF(!obs->has_box() || obs->box().has_sparse(),
+                        "Only dense Box observations can be stacked");
+        if (m_history.size() == m_stack)
+        {
+            // the oldest buffer is reused for the newest data
+            m_history.push_back(std::move(m_history.front()));
+            m_history.pop_front();
+            m_history.back() = obs->box().data();
+        }
+        else
+        {
+            m_history.push_back(obs->box().data());
+        }
+    }
+
+    // the first and the final states always go to the agent
+    bool decide = isGameOver || !m_decided;
+    if (!decide && m_steps >= m_repeat)
+    {
+        decide = m_tolerance <= 0 || LeftBand(*obs, m_decisionObs);
+    }
+    if (!decide)
+    {
+        return false;
+    }
+
+    *reward = m_reward;
+    m_reward = 0;
+    m_steps = 0;
+    m_decided = true;
+    if (m_tolerance > 0)
+    {
+        m_decisionObs = *obs;
+    }
+    if (m_stack > 1)
+    {
+        Stack(obs);
+    }
+    return true;
+}
+
+void
+OpenGymDecimator::SetAction(Ptr<OpenGymDataContainer> action)
+{
+    m_action = action;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymDecimator::GetAction() const
+{
+    return m_action;
+}
+
+bool
+OpenGymDecimator::LeftBand(const ns3_ai_gym::DataV2& obs, const ns3_ai_gym::DataV2& last) const
+{
+    if (obs.data_case() != last.data_case())
+    {
+        return true;
+    }
+    switch (obs.data_case())
+    {
+    case ns3_ai_gym::DataV2::kDiscrete:
+        return obs.discrete() != last.discrete();
+    case ns3_ai_gym::DataV2::kBox: {
+        const ns3_ai_gym::BoxDataV2& box = obs.box();
+        if (box.dtype() != last.box().dtype() || box.data().size() != last.box().data().size())
+        {
+            return true;
+        }
+        // the nonzero elements of sparse Boxes may come in any order, any change leaves the band
+        if (box.has_sparse() || last.box().has_sparse())
+        {
+            return box.sparse().index() != last.box().sparse().index() ||
+                   box.sparse().values() != last.box().sparse().values();
+        }
+        uint32_t count = box.data().size() / OpenGymGetDataTypeSize(box.dtype());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            double value;
+            double lastValue;
+            if (!GetElement(box.data(), box.dtype(), i, &value) ||
+                !GetElement(last.box().data(), box.dtype(), i, &lastValue))
+            {
+                // without a numeric value, any change leaves the band
+                return box.data() != last.box().data();
+            }
+            if (std::abs(value - lastValue) > m_tolerance)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    case ns3_ai_gym::DataV2::kTuple:
+    case ns3_ai_gym::DataV2::kDict: {
+        const auto& elements = obs.has_tuple() ? obs.tuple().element() : obs.dict().element();
+        const auto& lastElements =
+            last.has_tuple() ? last.tuple().element() : last.dict().element();
+        if (elements.size() != lastElements.size())
+        {
+            return true;
+        }
+        for (int i = 0; i < elements.size(); ++i)
+        {
+            if (LeftBand(elements.Get(i), lastElements.Get(i)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+void
+OpenGymDecimator::Stack(ns3_ai_gym::DataV2* obs)
+{
+    ns3_ai_gym::BoxDataV2* box = obs->mutable_box();
+    std::string& data = *box->mutable_data();
+    // until there are enough observations, the oldest one is repeated
+    data.clear();
+    for (uint32_t i = m_history.size(); i < m_stack; ++i)
+    {
+        data += m_history.front();
+    }
+    for (const std::string& observation : m_history)
+    {
+        NS_ABORT_MSG_IF(observation.size() != m_history.back().size(),
+                        "Stacked observations must keep their size");
+        data += observation;
+    }
+    box->mutable_shape()->Add(m_stack);
+    std::rotate(box->mutable_shape()->rbegin(),
+                box->mutable_shape()->rbegin() + 1,
+                box->mutable_shape()->rend());
+}
+
+} // namespace ns3
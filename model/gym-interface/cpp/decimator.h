@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_DECIMATOR_H
+#define OPENGYM_DECIMATOR_H
+
+#include "messages.pb.h"
+
+#include <ns3/ptr.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace ns3
+{
+
+class OpenGymDataContainer;
+
+/**
+ * \brief Selects the steps at which the agent is asked for an action.
+ *
+ * The agent decides every repeat steps and, with a tolerance, only once the
+ * observation has left the band of that tolerance around the observation of
+ * its last decision. In between, the action of the last decision is executed
+ * again and the rewards are summed. The Box observations of the latest steps
+ * can be stacked along a new first axis.
+ */
+class OpenGymDecimator
+{
+  public:
+    OpenGymDecimator();
+
+    /**
+     * Set the number of steps between decisions, 1 to decide at every step
+     */
+    void SetRepeat(uint32_t repeat);
+    uint32_t GetRepeat() const;
+
+    /**
+     * Set the largest change of an observation element which does not call
+     * for a decision, 0 to disable
+     */
+    void SetTolerance(double tolerance);
+
+    /**
+     * Set the number of observations stacked into one, 1 to disable
+     */
+    void SetStack(uint32_t stack);
+
+    /**
+     * Whether every step is a decision with its own observation
+     */
+    bool IsPassThrough() const;
+
+    /**
+     * Whether Step needs the observation of every step
+     */
+    bool NeedsObservation() const;
+
+    /**
+     * Change the description of a Box observation space into that of the
+     * stacked observations. Returns false if the space is not a Box.
+     */
+    bool StackSpace(ns3_ai_gym::SpaceV2* space) const;
+
+    /**
+     * Forget the previous steps, so that the next step is a decision
+     */
+    void Reset();
+
+    /**
+     * Account for a step, given its observation if NeedsObservation(). Returns
+     * true if the agent decides at this step; then the observation is replaced
+     * by the stacked observations, and the reward by the sum of the rewards
+     * since the last decision.
+     */
+    bool Step(ns3_ai_gym::DataV2* obs, float* reward, bool isGameOver);
+
+    /**
+     * Set the action of the last decision, executed again until the next one
+     */
+    void SetAction(Ptr<OpenGymDataContainer> action);
+    Ptr<OpenGymDataContainer> GetAction() const;
+
+  private:
+    bool LeftBand(const ns3_ai_gym::DataV2& obs, const ns3_ai_gym::DataV2& last) const;
+    void Stack(ns3_ai_gym::DataV2* obs);
+
+    uint32_t m_repeat;
+    double m_tolerance;
+    uint32_t m_stack;
+    bool m_decided;   ///< whether the agent has decided since Reset
+    uint32_t m_steps; ///< steps since the last decision
+    float m_reward;   ///< sum of the rewards since the last decision
+    ns3_ai_gym::DataV2 m_decisionObs;
+    std::deque<std::string> m_history; ///< Box data of the latest observations
+    Ptr<OpenGymDataContainer> m_action;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_DECIMATOR_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "delta-encoder.h"
+
+#include "payload-area.h"
+#include "spaces.h"
+
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymDeltaEncoder");
+
+OpenGymDeltaEncoder::OpenGymDeltaEncoder()
+    : m_interval(1),
+      m_count(0),
+      m_keyframe(true),
+      m_box(0)
+{
+}
+
+void
+OpenGymDeltaEncoder::SetKeyframeInterval(uint32_t interval)
+{
+    m_interval = std::max<uint32_t>(interval, 1);
+}
+
+void
+OpenGymDeltaEncoder::Reset()
+{
+    m_count = 0;
+    m_last.clear();
+}
+
+void
+OpenGymDeltaEncoder::Encode(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload)
+{
+    m_keyframe = m_count == 0;
+    m_count = (m_count + 1) % m_interval;
+    m_box = 0;
+    EncodeData(dataPbMsg, payload);
+}
+
+void
+OpenGymDeltaEncoder::EncodeData(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload)
+{
+    switch (dataPbMsg->data_case())
+    {
+    case ns3_ai_gym::DataV2::kBox:
+        EncodeBox(dataPbMsg->mutable_box(), payload);
+        break;
+    case ns3_ai_gym::DataV2::kTuple:
+        for (auto& element : *dataPbMsg->mutable_tuple()->mutable_element())
+        {
+            EncodeData(&element, payload);
+        }
+        break;
+    case ns3_ai_gym::DataV2::kDict:
+        for (auto& element : *dataPbMsg->mutable_dict()->mutable_element())
+        {
+            EncodeData(&element, payload);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void
+OpenGymDeltaEncoder::EncodeBox(ns3_ai_gym::BoxDataV2* boxPbMsg, OpenGymPayloadArea* payload)
+{
+    // sparse Boxes are already sent as few elements
+    if (boxPbMsg->has_sparse())
+    {
+        return;
+    }
+    uint32_t box = m_box++;
+    if (box == m_last.size())
+    {
+        m_last.emplace_back();
+    }
+    std::string& last = m_last[box];
+    std::string& data = *boxPbMsg->mutable_data();
+
+    // a Box whose size changed is sent in full, as in a keyframe
+    bool delta = !m_keyframe && last.size() == data.size();
+    if (delta)
+    {
+        uint32_t elementSize = OpenGymGetDataTypeSize(boxPbMsg->dtype());
+        uint32_t count = data.size() / elementSize;
+        std::string& index = *boxPbMsg->mutable_delta()->mutable_index();
+        std::string& values = *boxPbMsg->mutable_delta()->mutable_values();
+        index.clear();
+        values.clear();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const char* element = data.data() + i * elementSize;
+            if (std::memcmp(element, last.data() + i * elementSize, elementSize) != 0)
+            {
+                index.append(reinterpret_cast<const char*>(&i), sizeof(i));
+                values.append(element, elementSize);
+            }
+        }
+        // worth it only if smaller than the full data
+        delta = index.size() + values.size() < data.size();
+    }
+
+    // the message takes the buffer of the previous data, which keeps allocations away
+    last.swap(data);
+    if (delta)
+    {
+        data.clear();
+        boxPbMsg->clear_payload();
+        return;
+    }
+    boxPbMsg->clear_delta();
+    data = last;
+    if (payload && payload->Write(data.data(), data.size(), boxPbMsg->mutable_payload()))
+    {
+        data.clear();
+        return;
+    }
+    boxPbMsg->clear_payload();
+}
+
+} // namespace ns3
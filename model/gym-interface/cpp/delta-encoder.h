@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_DELTA_ENCODER_H
+#define OPENGYM_DELTA_ENCODER_H
+
+#include "messages.pb.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class OpenGymPayloadArea;
+
+/**
+ * \brief Delta encoding of the Box data of consecutive observations.
+ *
+ * The encoder keeps the data of every Box sent last, in the order the Boxes
+ * appear in the observation. Box data is replaced by the indices and values
+ * of the changed elements, if that is smaller, except in keyframes, which
+ * carry the full data at a fixed interval of states.
+ */
+class OpenGymDeltaEncoder
+{
+  public:
+    OpenGymDeltaEncoder();
+
+    /**
+     * Set the number of states between keyframes, 1 to send only keyframes
+     */
+    void SetKeyframeInterval(uint32_t interval);
+
+    /**
+     * Forget the previous state, so that the next one is a keyframe
+     */
+    void Reset();
+
+    /**
+     * Delta encode the Box data of a filled observation. Full Box data larger
+     * than the threshold of the payload area is then moved there, unless
+     * payload is null.
+     */
+    void Encode(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload);
+
+  private:
+    void EncodeData(ns3_ai_gym::DataV2* dataPbMsg, OpenGymPayloadArea* payload);
+    void EncodeBox(ns3_ai_gym::BoxDataV2* boxPbMsg, OpenGymPayloadArea* payload);
+
+    uint32_t m_interval;
+    uint32_t m_count;               ///< number of states since the last keyframe
+    bool m_keyframe;                ///< whether the state being encoded is a keyframe
+    uint32_t m_box;                 ///< index of the Box being encoded
+    std::vector<std::string> m_last; ///< data of the Boxes sent last
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_DELTA_ENCODER_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "flat-layout.h"
+
+#include <ns3/log.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymFlatLayout");
+
+OpenGymFlatLayout::OpenGymFlatLayout()
+    : m_dataType(ns3_ai_gym::NoDataType),
+      m_count(0),
+      m_size(0),
+      m_buffer(nullptr)
+{
+}
+
+bool
+OpenGymFlatLayout::SetSpace(Ptr<OpenGymSpace> space)
+{
+    NS_LOG_FUNCTION(this << space);
+    if (!DynamicCast<OpenGymBoxSpace>(space))
+    {
+        return false;
+    }
+
+    ns3_ai_gym::SpaceV2 desc = space->GetSpaceDescriptionV2();
+    if (desc.box().sparse())
+    {
+        return false;
+    }
+    m_dataType = desc.box().dtype();
+    m_shape.assign(desc.box().shape().begin(), desc.box().shape().end());
+    m_count = 1;
+    for (uint32_t dim : m_shape)
+    {
+        m_count *= dim;
+    }
+    m_size = m_count * OpenGymGetDataTypeSize(m_dataType);
+    return true;
+}
+
+ns3_ai_gym::DataType
+OpenGymFlatLayout::GetDataType() const
+{
+    return m_dataType;
+}
+
+const std::vector<uint32_t>&
+OpenGymFlatLayout::GetShape() const
+{
+    return m_shape;
+}
+
+uint32_t
+OpenGymFlatLayout::GetCount() const
+{
+    return m_count;
+}
+
+uint32_t
+OpenGymFlatLayout::GetSize() const
+{
+    return m_size;
+}
+
+void
+OpenGymFlatLayout::SetBuffer(uint8_t* buffer)
+{
+    m_buffer = buffer;
+}
+
+uint8_t*
+OpenGymFlatLayout::GetBuffer() const
+{
+    return m_buffer;
+}
+
+} // namespace ns3
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_FLAT_LAYOUT_H
+#define OPENGYM_FLAT_LAYOUT_H
+
+#include "messages.pb.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/type-name.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Fixed binary layout of a Box space, and a view of data laid out
+ * that way in a message.
+ *
+ * The layout is derived from the observation and action spaces at
+ * initialization. Environments access the data in place through GetData.
+ */
+class OpenGymFlatLayout
+{
+  public:
+    OpenGymFlatLayout();
+
+    /**
+     * Derive the layout from a space. Returns false if the space is not a dense Box.
+     */
+    bool SetSpace(Ptr<OpenGymSpace> space);
+
+    ns3_ai_gym::DataType GetDataType() const;
+    const std::vector<uint32_t>& GetShape() const;
+
+    /**
+     * Get the number of elements
+     */
+    uint32_t GetCount() const;
+
+    /**
+     * Get the size of data in bytes
+     */
+    uint32_t GetSize() const;
+
+    /**
+     * Set the memory the data is laid out in
+     */
+    void SetBuffer(uint8_t* buffer);
+    uint8_t* GetBuffer() const;
+
+    /**
+     * Get the data as an array of GetCount() elements. T must match the
+     * element type of the space.
+     */
+    template <typename T>
+    T* GetData() const
+    {
+        NS_ABORT_MSG_IF(OpenGymGetDataType(TypeNameGet<T>()) != m_dataType,
+                        "Flat layout data is not of type " << TypeNameGet<T>());
+        return reinterpret_cast<T*>(m_buffer);
+    };
+
+  private:
+    ns3_ai_gym::DataType m_dataType;
+    std::vector<uint32_t> m_shape;
+    uint32_t m_count;
+    uint32_t m_size;
+    uint8_t* m_buffer;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_FLAT_LAYOUT_H
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "ns3-ai-gym-embedded.h"
+
+#include "container.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#ifdef NS3AI_EMBEDDED_PYTHON
+#include <pybind11/embed.h>
+#include <pybind11/numpy.h>
+
+namespace py = pybind11;
+#endif
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymEmbeddedAgent");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymEmbeddedAgent);
+
+TypeId
+OpenGymEmbeddedAgent::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymEmbeddedAgent")
+                            .SetParent<OpenGymPolicy>()
+                            .SetGroupName("OpenGym");
+    return tid;
+}
+
+#ifdef NS3AI_EMBEDDED_PYTHON
+
+namespace
+{
+
+template <typename T>
+bool
+BoxToPy(Ptr<OpenGymDataContainer> data, py::object& obj)
+{
+    Ptr<OpenGymBoxContainer<T>> box = DynamicCast<OpenGymBoxContainer<T>>(data);
+    if (!box)
+    {
+        return false;
+    }
+    // the capsule holds a reference to the container as long as the array lives
+    py::capsule base(new Ptr<OpenGymBoxContainer<T>>(box),
+                     [](void* p) { delete static_cast<Ptr<OpenGymBoxContainer<T>>*>(p); });
+    const std::vector<T>& values = box->GetData();
+    // flat, like the observations decoded by Ns3Env
+    py::array_t<T> array(values.size(), values.data(), base);
+    array.attr("flags").attr("writeable") = false;
+    obj = array;
+    return true;
+}
+
+template <typename T>
+bool
+SparseBoxToPy(Ptr<OpenGymDataContainer> data, py::object& obj)
+{
+    Ptr<OpenGymSparseBoxContainer<T>> box = DynamicCast<OpenGymSparseBoxContainer<T>>(data);
+    if (!box)
+    {
+        return false;
+    }
+    // the agent gets the dense elements, flat like those of a Box
+    std::vector<T> values = box->GetDenseData();
+    obj = py::array_t<T>(values.size(), values.data());
+    return true;
+}
+
+py::object
+DataToPy(Ptr<OpenGymDataContainer> data)
+{
+    py::object obj = py::none();
+    if (!data)
+    {
+        return obj;
+    }
+
+    if (Ptr<OpenGymDiscreteContainer> discrete = DynamicCast<OpenGymDiscreteContainer>(data))
+    {
+        obj = py::int_(discrete->GetValue());
+    }
+    else if (Ptr<OpenGymTupleContainer> tuple = DynamicCast<OpenGymTupleContainer>(data))
+    {
+        py::list elements;
+        Ptr<OpenGymDataContainer> element;
+        for (uint32_t i = 0; (element = tuple->Get(i)); ++i)
+        {
+            elements.append(DataToPy(element));
+        }
+        obj = py::tuple(elements);
+    }
+    else if (Ptr<OpenGymDictContainer> dict = DynamicCast<OpenGymDictContainer>(data))
+    {
+        py::dict elements;
+        for (const auto& key : dict->GetKeys())
+        {
+            elements[py::str(key)] = DataToPy(dict->Get(key));
+        }
+        obj = elements;
+    }
+    else if (!BoxToPy<float>(data, obj) && !BoxToPy<double>(data, obj) &&
+             !BoxToPy<int8_t>(data, obj) && !BoxToPy<int16_t>(data, obj) &&
+             !BoxToPy<int32_t>(data, obj) && !BoxToPy<int64_t>(data, obj) &&
+             !BoxToPy<uint8_t>(data, obj) && !BoxToPy<uint16_t>(data, obj) &&
+             !BoxToPy<uint32_t>(data, obj) && !BoxToPy<uint64_t>(data, obj) &&
+             !SparseBoxToPy<float>(data, obj) && !SparseBoxToPy<double>(data, obj) &&
+             !SparseBoxToPy<int8_t>(data, obj) && !SparseBoxToPy<int16_t>(data, obj) &&
+             !SparseBoxToPy<int32_t>(data, obj) && !SparseBoxToPy<int64_t>(data, obj) &&
+             !SparseBoxToPy<uint8_t>(data, obj) && !SparseBoxToPy<uint16_t>(data, obj) &&
+             !SparseBoxToPy<uint32_t>(data, obj) && !SparseBoxToPy<uint64_t>(data, obj))
+    {
+        NS_FATAL_ERROR("Unsupported observation container");
+    }
+    return obj;
+}
+
+template <typename T>
+Ptr<OpenGymDataContainer>
+BoxFromPy(py::handle obj)
+{
+    auto array = py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(obj);
+    NS_ABORT_MSG_IF(!array, "Box action cannot be converted to an array");
+    std::vector<uint32_t> shape = {static_cast<uint32_t>(array.size())};
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>(shape);
+    box->SetData(std::vector<T>(array.data(), array.data() + array.size()));
+    return box;
+}
+
+Ptr<OpenGymDataContainer>
+DataFromPy(py::handle obj, Ptr<OpenGymSpace> space)
+{
+    Ptr<OpenGymDataContainer> data;
+
+    if (DynamicCast<OpenGymDiscreteSpace>(space))
+    {
+        Ptr<OpenGymDiscreteContainer> discrete = CreateObject<OpenGymDiscreteContainer>();
+        discrete->SetValue(obj.cast<uint32_t>());
+        data = discrete;
+    }
+    else if (DynamicCast<OpenGymBoxSpace>(space))
+    {
+        switch (space->GetSpaceDescriptionV2().box().dtype())
+        {
+        case ns3_ai_gym::INT8:
+            data = BoxFromPy<int8_t>(obj);
+            break;
+        case ns3_ai_gym::INT16:
+            data = BoxFromPy<int16_t>(obj);
+            break;
+        case ns3_ai_gym::INT32:
+            data = BoxFromPy<int32_t>(obj);
+            break;
+        case ns3_ai_gym::INT64:
+            data = BoxFromPy<int64_t>(obj);
+            break;
+        case ns3_ai_gym::UINT8:
+        case ns3_ai_gym::BOOL:
+            data = BoxFromPy<uint8_t>(obj);
+            break;
+        case ns3_ai_gym::UINT16:
+            data = BoxFromPy<uint16_t>(obj);
+            break;
+        case ns3_ai_gym::UINT32:
+            data = BoxFromPy<uint32_t>(obj);
+            break;
+        case ns3_ai_gym::UINT64:
+            data = BoxFromPy<uint64_t>(obj);
+            break;
+        case ns3_ai_gym::FLOAT64:
+            data = BoxFromPy<double>(obj);
+            break;
+        default:
+            data = BoxFromPy<float>(obj);
+            break;
+        }
+    }
+    else if (Ptr<OpenGymTupleSpace> tupleSpace = DynamicCast<OpenGymTupleSpace>(space))
+    {
+        Ptr<OpenGymTupleContainer> tuple = CreateObject<OpenGymTupleContainer>();
+        uint32_t idx = 0;
+        for (py::handle element : obj)
+        {
+            tuple->Add(DataFromPy(element, tupleSpace->Get(idx++)));
+        }
+        data = tuple;
+    }
+    else if (Ptr<OpenGymDictSpace> dictSpace = DynamicCast<OpenGymDictSpace>(space))
+    {
+        Ptr<OpenGymDictContainer> dict = CreateObject<OpenGymDictContainer>();
+        for (auto item : obj.cast<py::dict>())
+        {
+            std::string key = item.first.cast<std::string>();
+            dict->Add(key, DataFromPy(item.second, dictSpace->Get(key)));
+        }
+        data = dict;
+    }
+    else
+    {
+        NS_FATAL_ERROR("Unsupported action space");
+    }
+    return data;
+}
+
+} // namespace
+
+struct OpenGymEmbeddedAgent::Impl
+{
+    // declared first so that it finalizes after the agent is released
+    std::unique_ptr<py::scoped_interpreter> interpreter; ///< null if Python was already running
+    py::object getAction;
+};
+
+OpenGymEmbeddedAgent::OpenGymEmbeddedAgent(const std::string& module, const std::string& path)
+    : m_impl(std::make_unique<Impl>())
+{
+    NS_LOG_FUNCTION(this << module << path);
+    if (!Py_IsInitialized())
+    {
+        m_impl->interpreter = std::make_unique<py::scoped_interpreter>();
+    }
+    try
+    {
+        if (!path.empty())
+        {
+            py::module_::import("sys").attr("path").attr("insert")(0, path);
+        }
+        m_impl->getAction = py::module_::import(module.c_str()).attr("get_action");
+    }
+    catch (py::error_already_set& e)
+    {
+        NS_FATAL_ERROR("Cannot load embedded agent " << module << ": " << e.what());
+    }
+}
+
+OpenGymEmbeddedAgent::~OpenGymEmbeddedAgent()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymEmbeddedAgent::GetAction(Ptr<OpenGymDataContainer> obs,
+                                float reward,
+                                bool done,
+                                const std::string& info)
+{
+    Ptr<OpenGymDataContainer> action;
+    try
+    {
+        py::dict extraInfo;
+        extraInfo["info"] = info;
+        py::object act = m_impl->getAction(DataToPy(obs), reward, done, extraInfo);
+        if (Ptr<OpenGymSpace> actionSpace = GetActionSpace())
+        {
+            action = DataFromPy(act, actionSpace);
+        }
+    }
+    catch (py::error_already_set& e)
+    {
+        NS_FATAL_ERROR("Embedded agent failed: " << e.what());
+    }
+    return action;
+}
+
+#else
+
+struct OpenGymEmbeddedAgent::Impl
+{
+};
+
+OpenGymEmbeddedAgent::OpenGymEmbeddedAgent(const std::string& module, const std::string& path)
+{
+    NS_FATAL_ERROR("Cannot load embedded agent "
+                   << module << ": ns3-ai is built without NS3AI_EMBEDDED_PYTHON");
+}
+
+OpenGymEmbeddedAgent::~OpenGymEmbeddedAgent()
+{
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymEmbeddedAgent::GetAction(Ptr<OpenGymDataContainer> obs,
+                                float reward,
+                                bool done,
+                                const std::string& info)
+{
+    return Ptr<OpenGymDataContainer>();
+}
+
+#endif // NS3AI_EMBEDDED_PYTHON
+
+} // namespace ns3
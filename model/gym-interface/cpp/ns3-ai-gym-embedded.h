@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_GYM_EMBEDDED_H
+#define NS3_AI_GYM_EMBEDDED_H
+
+#include "policy.h"
+
+#include <memory>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \brief A Python agent running in an interpreter embedded in the simulation.
+ *
+ * The agent is a Python module defining get_action(obs, reward, done, info),
+ * the same function that drives Ns3Env in shared memory mode, run as the
+ * policy of OpenGymInterface. Box observations are passed as read-only numpy
+ * arrays viewing the data of the container, without copy. Only available if
+ * ns3-ai is configured with NS3AI_EMBEDDED_PYTHON, otherwise creating the
+ * agent is a fatal error.
+ */
+class OpenGymEmbeddedAgent : public OpenGymPolicy
+{
+  public:
+    /**
+     * Start the interpreter (if not started yet) and import the agent module.
+     * If path is not empty, it is prepended to Python's sys.path.
+     */
+    OpenGymEmbeddedAgent(const std::string& module, const std::string& path);
+    ~OpenGymEmbeddedAgent() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * Call the agent's get_action and convert its return value into a
+     * container according to the action space
+     */
+    Ptr<OpenGymDataContainer> GetAction(Ptr<OpenGymDataContainer> obs,
+                                        float reward,
+                                        bool done,
+                                        const std::string& info) override;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace ns3
+
+#endif // NS3_AI_GYM_EMBEDDED_H
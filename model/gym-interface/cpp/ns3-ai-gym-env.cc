@@ -21,8 +21,11 @@
 
 #include "ns3-ai-gym-env.h"
 
+#include "container.h"
 #include "ns3-ai-gym-interface.h"
+#include "spaces.h"
 
+#include <ns3/abort.h>
 #include <ns3/log.h>
 #include <ns3/object.h>
 
@@ -33,6 +36,8 @@ NS_OBJECT_ENSURE_REGISTERED(OpenGymEnv);
 NS_LOG_COMPONENT_DEFINE("OpenGymEnv");
 
 OpenGymEnv::OpenGymEnv()
+    : m_isAgent(false),
+      m_agentId(0)
 {
     NS_LOG_FUNCTION(this);
 }
@@ -62,6 +67,102 @@ OpenGymEnv::SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface)
     openGymInterface->SetGetRewardCb(MakeCallback(&OpenGymEnv::GetReward, this));
     openGymInterface->SetGetExtraInfoCb(MakeCallback(&OpenGymEnv::GetExtraInfo, this));
     openGymInterface->SetExecuteActionsCb(MakeCallback(&OpenGymEnv::ExecuteActions, this));
+    openGymInterface->SetGetObservationFlatCb(
+        MakeCallback(&OpenGymEnv::GetObservationFlat, this));
+    openGymInterface->SetExecuteActionsFlatCb(
+        MakeCallback(&OpenGymEnv::ExecuteActionsFlat, this));
+    if (m_isAgent)
+    {
+        openGymInterface->RegisterAgent(m_agentId, this);
+    }
+}
+
+void
+OpenGymEnv::SetAgentId(uint32_t agentId)
+{
+    NS_LOG_FUNCTION(this << agentId);
+    m_isAgent = true;
+    m_agentId = agentId;
+    if (m_openGymInterface)
+    {
+        m_openGymInterface->RegisterAgent(agentId, this);
+    }
+}
+
+uint32_t
+OpenGymEnv::GetAgentId() const
+{
+    return m_agentId;
+}
+
+Ptr<OpenGymSpace>
+OpenGymEnv::GetObservationSpace()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_obsFields.empty(),
+                    "Override GetObservationSpace or add observation fields");
+    if (!m_obsFieldSpace)
+    {
+        m_obsFieldSpace = CreateObject<OpenGymDictSpace>();
+        for (const ObservationField& field : m_obsFields)
+        {
+            m_obsFieldSpace->Add(field.name, field.space);
+        }
+    }
+    return m_obsFieldSpace;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymEnv::GetObservation()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_obsFields.empty(), "Override GetObservation or add observation fields");
+    Ptr<OpenGymDictContainer> obs = CreateObject<OpenGymDictContainer>();
+    for (const ObservationField& field : m_obsFields)
+    {
+        if (!m_openGymInterface || m_openGymInterface->IsObservationFieldRequested(field.name))
+        {
+            obs->Add(field.name, field.producer());
+        }
+    }
+    return obs;
+}
+
+void
+OpenGymEnv::AddObservationField(const std::string& name,
+                                Ptr<OpenGymSpace> space,
+                                Callback<Ptr<OpenGymDataContainer>> producer)
+{
+    NS_LOG_FUNCTION(this << name << space);
+    NS_ABORT_MSG_IF(m_obsFieldSpace, "Observation fields must be added before the first Notify");
+    for (const ObservationField& field : m_obsFields)
+    {
+        NS_ABORT_MSG_IF(field.name == name, "Observation field " << name << " already added");
+    }
+    m_obsFields.push_back({name, space, producer});
+}
+
+std::vector<std::string>
+OpenGymEnv::GetObservationFieldNames() const
+{
+    std::vector<std::string> names;
+    for (const ObservationField& field : m_obsFields)
+    {
+        names.push_back(field.name);
+    }
+    return names;
+}
+
+bool
+OpenGymEnv::GetObservationFlat(const OpenGymFlatLayout& obs)
+{
+    return false;
+}
+
+bool
+OpenGymEnv::ExecuteActionsFlat(const OpenGymFlatLayout& action)
+{
+    return false;
 }
 
 void
@@ -94,6 +195,8 @@ void
 OpenGymEnv::DoDispose()
 {
     NS_LOG_FUNCTION(this);
+    m_obsFields.clear();
+    m_obsFieldSpace = nullptr;
 }
 
 } // namespace ns3
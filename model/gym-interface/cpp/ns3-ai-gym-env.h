@@ -22,13 +22,19 @@
 #ifndef OPENGYM_ENV_H
 #define OPENGYM_ENV_H
 
+#include <ns3/callback.h>
 #include <ns3/object.h>
 
+#include <string>
+#include <vector>
+
 namespace ns3
 {
 
 class OpenGymSpace;
+class OpenGymDictSpace;
 class OpenGymDataContainer;
+class OpenGymFlatLayout;
 class OpenGymInterface;
 
 /**
@@ -48,9 +54,10 @@ class OpenGymEnv : public Object
     virtual Ptr<OpenGymSpace> GetActionSpace() = 0;
 
     /**
-     * Get observation space (Box, Dict, ...) from simulation
+     * Get observation space (Box, Dict, ...) from simulation. By default, the
+     * Dict of the fields added with AddObservationField.
      */
-    virtual Ptr<OpenGymSpace> GetObservationSpace() = 0;
+    virtual Ptr<OpenGymSpace> GetObservationSpace();
 
     /**
      * Get whether game is over (simulation is finished).
@@ -59,9 +66,10 @@ class OpenGymEnv : public Object
     virtual bool GetGameOver() = 0;
 
     /**
-     * Get observation (stored in container)
+     * Get observation (stored in container). By default, the Dict of the
+     * fields added with AddObservationField that the agent requests.
      */
-    virtual Ptr<OpenGymDataContainer> GetObservation() = 0;
+    virtual Ptr<OpenGymDataContainer> GetObservation();
 
     /**
      * Get reward
@@ -78,12 +86,36 @@ class OpenGymEnv : public Object
      */
     virtual bool ExecuteActions(Ptr<OpenGymDataContainer> action) = 0;
 
+    /**
+     * Write the observation in place, when both spaces are Boxes and the flat
+     * layout is used. Return false to use GetObservation instead (default).
+     */
+    virtual bool GetObservationFlat(const OpenGymFlatLayout& obs);
+
+    /**
+     * Execute actions read in place, when both spaces are Boxes and the flat
+     * layout is used. Return false to use ExecuteActions instead (default).
+     */
+    virtual bool ExecuteActionsFlat(const OpenGymFlatLayout& action);
+
     /**
      * Sets the lower level gym interface (shared memory)
      * associated to the environment
      */
     void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface);
 
+    /**
+     * Register the environment as the agent with the given ID, which puts
+     * the interface in multi-agent mode. Must be called before the first Notify.
+     */
+    void SetAgentId(uint32_t agentId);
+    uint32_t GetAgentId() const;
+
+    /**
+     * Get the names of the fields added with AddObservationField
+     */
+    std::vector<std::string> GetObservationFieldNames() const;
+
     /**
      * Notify Python side about the states, and execute the actions
      */
@@ -99,9 +131,31 @@ class OpenGymEnv : public Object
     void DoInitialize() override;
     void DoDispose() override;
 
+    /**
+     * Add a named field of a Dict observation. The producer is only called at
+     * the steps where the agent requests the field, so expensive fields cost
+     * nothing unless they are used. Requires the default GetObservationSpace
+     * and GetObservation.
+     */
+    void AddObservationField(const std::string& name,
+                             Ptr<OpenGymSpace> space,
+                             Callback<Ptr<OpenGymDataContainer>> producer);
+
     Ptr<OpenGymInterface> m_openGymInterface;
 
   private:
+    /// Lazy field of the observation
+    struct ObservationField
+    {
+        std::string name;
+        Ptr<OpenGymSpace> space;
+        Callback<Ptr<OpenGymDataContainer>> producer;
+    };
+
+    bool m_isAgent; ///< whether SetAgentId was called
+    uint32_t m_agentId;
+    std::vector<ObservationField> m_obsFields;
+    Ptr<OpenGymDictSpace> m_obsFieldSpace; ///< Dict of the fields, built at first use
 };
 
 } // end of namespace ns3
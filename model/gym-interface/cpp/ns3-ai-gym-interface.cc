@@ -28,12 +28,26 @@
 
 #include "container.h"
 #include "messages.pb.h"
+#include "ns3-ai-gym-embedded.h"
 #include "ns3-ai-gym-env.h"
 #include "spaces.h"
 
+#include <ns3/boolean.h>
 #include <ns3/config.h>
+#include <ns3/double.h>
 #include <ns3/log.h>
+#include <ns3/rng-seed-manager.h>
 #include <ns3/simulator.h>
+#include <ns3/string.h>
+#include <ns3/uinteger.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/types.h>
+#include <unistd.h>
 
 namespace ns3
 {
@@ -51,7 +65,23 @@ OpenGymInterface::Get()
 OpenGymInterface::OpenGymInterface()
     : m_simEnd(false),
       m_stopEnvRequested(false),
-      m_initSimMsgSent(false)
+      m_initSimMsgSent(false),
+      m_runningEpisodes(false),
+      m_episodeSetup(false),
+      m_episodeReset(false),
+      m_version(1),
+      m_useFlat(false),
+      m_usePayload(false),
+      m_stateBuffer(nullptr),
+      m_actBuffer(nullptr),
+      m_actionRepeat(1),
+      m_decisionTolerance(0),
+      m_observationStack(1),
+      m_profile(false),
+      m_trajectoryChunkRows(4096),
+      m_actionCacheSize(0),
+      m_boundEnv(nullptr),
+      m_usePython(false)
 {
     auto interface = Ns3AiMsgInterface::Get();
     interface->SetIsMemoryCreator(false);
@@ -69,7 +99,126 @@ OpenGymInterface::GetTypeId()
     static TypeId tid = TypeId("OpenGymInterface")
                             .SetParent<Object>()
                             .SetGroupName("OpenGym")
-                            .AddConstructor<OpenGymInterface>();
+                            .AddConstructor<OpenGymInterface>()
+                            .AddAttribute("EmbeddedAgent",
+                                          "Python module of an agent to run in an interpreter "
+                                          "embedded in the simulation, instead of exchanging "
+                                          "messages with a Python process. Empty to disable.",
+                                          StringValue(""),
+                                          MakeStringAccessor(&OpenGymInterface::m_agentModule),
+                                          MakeStringChecker())
+                            .AddAttribute("EmbeddedAgentPath",
+                                          "Directory prepended to Python's module search path "
+                                          "before importing the embedded agent",
+                                          StringValue(""),
+                                          MakeStringAccessor(&OpenGymInterface::m_agentPath),
+                                          MakeStringChecker())
+                            .AddAttribute("ProtocolVersion",
+                                          "Highest Gym protocol version offered to Python. "
+                                          "Version 2 carries Box data as packed bytes with "
+                                          "exact element types.",
+                                          UintegerValue(2),
+                                          MakeUintegerAccessor(&OpenGymInterface::m_maxVersion),
+                                          MakeUintegerChecker<uint32_t>(1, 2))
+                            .AddAttribute("FlatLayout",
+                                          "Offer to exchange states and actions as raw bytes in "
+                                          "a fixed layout, instead of protobuf, when both spaces "
+                                          "are Boxes. Requires protocol version 2.",
+                                          BooleanValue(true),
+                                          MakeBooleanAccessor(&OpenGymInterface::m_offerFlat),
+                                          MakeBooleanChecker())
+                            .AddAttribute("SteadyState",
+                                          "Pass the same action container to every step, "
+                                          "updated in place, instead of a new one. "
+                                          "Environments must not keep the action after "
+                                          "ExecuteActions returns.",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&OpenGymInterface::m_steadyState),
+                                          MakeBooleanChecker())
+                            .AddAttribute("BufferSize",
+                                          "Size in bytes of the buffers of states and actions, "
+                                          "allocated in the shared memory segment at Init. "
+                                          "Sizes up to MSG_BUFFER_SIZE use the buffers of "
+                                          "Ns3AiGymMsg. Requires protocol version 2.",
+                                          UintegerValue(16384),
+                                          MakeUintegerAccessor(&OpenGymInterface::m_bufferSize),
+                                          MakeUintegerChecker<uint32_t>())
+                            .AddAttribute("InlineThreshold",
+                                          "Box data of observations larger than this many bytes "
+                                          "is carried out of band in the shared memory segment, "
+                                          "instead of in the message. Requires protocol "
+                                          "version 2.",
+                                          UintegerValue(1024),
+                                          MakeUintegerAccessor(
+                                              &OpenGymInterface::m_inlineThreshold),
+                                          MakeUintegerChecker<uint32_t>())
+                            .AddAttribute("DeltaKeyframeInterval",
+                                          "Send only the changed elements of Box observations, "
+                                          "with the full data every this many states. 0 to "
+                                          "disable. Requires protocol version 2, and replaces "
+                                          "the flat layout.",
+                                          UintegerValue(0),
+                                          MakeUintegerAccessor(
+                                              &OpenGymInterface::m_keyframeInterval),
+                                          MakeUintegerChecker<uint32_t>())
+                            .AddAttribute("ActionRepeat",
+                                          "Number of steps between decisions of the agent. In "
+                                          "between, the last action is executed again and the "
+                                          "rewards are summed. Python can ask for another value.",
+                                          UintegerValue(1),
+                                          MakeUintegerAccessor(&OpenGymInterface::m_actionRepeat),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("DecisionTolerance",
+                                          "Ask the agent for a decision only once an element of "
+                                          "the observation has changed by more than this since "
+                                          "its last decision. 0 to disable. Requires protocol "
+                                          "version 2.",
+                                          DoubleValue(0),
+                                          MakeDoubleAccessor(
+                                              &OpenGymInterface::m_decisionTolerance),
+                                          MakeDoubleChecker<double>(0))
+                            .AddAttribute("ObservationStack",
+                                          "Number of latest Box observations stacked along a new "
+                                          "first axis of the observation sent at a decision. "
+                                          "Requires protocol version 2.",
+                                          UintegerValue(1),
+                                          MakeUintegerAccessor(
+                                              &OpenGymInterface::m_observationStack),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("Profile",
+                                          "Measure the time spent in every phase of Init and of "
+                                          "the steps, which is printed at the end of the "
+                                          "simulation and sent to Python with the final state.",
+                                          BooleanValue(false),
+                                          MakeBooleanAccessor(&OpenGymInterface::m_profile),
+                                          MakeBooleanChecker())
+                            .AddAttribute("TrajectoryPath",
+                                          "Directory where the states and actions of the "
+                                          "decisions are recorded as columnar files, for "
+                                          "offline RL, in a subdirectory per simulation. "
+                                          "Empty to disable. Requires protocol version 2 "
+                                          "and a single agent.",
+                                          StringValue(""),
+                                          MakeStringAccessor(&OpenGymInterface::m_trajectoryPath),
+                                          MakeStringChecker())
+                            .AddAttribute("TrajectoryChunkRows",
+                                          "Number of rows of the trajectory buffered before "
+                                          "they are written by a background thread",
+                                          UintegerValue(4096),
+                                          MakeUintegerAccessor(
+                                              &OpenGymInterface::m_trajectoryChunkRows),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("ActionCacheSize",
+                                          "Number of actions cached by the bytes of their "
+                                          "observation, for a frozen deterministic policy, e.g. "
+                                          "during evaluation. A state whose observation is "
+                                          "cached gets its action without the agent, which "
+                                          "gets its reward with the next state. 0 to disable. "
+                                          "Requires protocol version 2 and a single agent.",
+                                          UintegerValue(0),
+                                          MakeUintegerAccessor(
+                                              &OpenGymInterface::m_actionCacheSize),
+                                          MakeUintegerChecker<uint32_t>());
     return tid;
 }
 
@@ -82,45 +231,232 @@ OpenGymInterface::Init()
         return;
     }
     m_initSimMsgSent = true;
+    m_profiler.SetEnabled(m_profile);
+    m_pipeline.SetSteadyState(m_steadyState);
+    OpenGymDecimator& decimator = m_pipeline.GetDecimator();
+
+    if (!m_agentModule.empty())
+    {
+        NS_ABORT_MSG_IF(m_policy, "EmbeddedAgent is set along with a policy");
+        m_policy = CreateObject<OpenGymEmbeddedAgent>(m_agentModule, m_agentPath);
+    }
+    bool multiAgent = !m_agents.empty();
+    NS_ABORT_MSG_IF(multiAgent && m_policy, "A policy does not support multiple agents");
+
+    decimator.SetRepeat(m_actionRepeat);
+    decimator.SetTolerance(m_decisionTolerance);
+    decimator.SetStack(m_observationStack);
+    decimator.Reset();
+    NS_ABORT_MSG_IF(decimator.NeedsObservation() && (multiAgent || m_policy),
+                    "DecisionTolerance and ObservationStack require a single agent exchanging "
+                    "messages with Python");
+    NS_ABORT_MSG_IF(!m_trajectoryPath.empty() && (multiAgent || m_maxVersion < 2),
+                    "TrajectoryPath requires a single agent and protocol version 2");
+    NS_ABORT_MSG_IF(m_actionCacheSize > 0 && (multiAgent || m_maxVersion < 2),
+                    "ActionCacheSize requires a single agent and protocol version 2");
+    m_pipeline.GetActionCache().SetCapacity(m_actionCacheSize);
+
+    // a policy set before the first state replaces Python, with no handshake
+    if (m_policy)
+    {
+        Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
+        Ptr<OpenGymSpace> actionSpace = GetActionSpace();
+        m_policy->SetSpaces(obsSpace, actionSpace);
+        if (!m_trajectoryPath.empty())
+        {
+            m_pipeline.GetTrajectory().Open(m_trajectoryPath,
+                                            Ns3AiMsgInterface::Get()->GetSegmentName(),
+                                            obsSpace->GetSpaceDescriptionV2(),
+                                            actionSpace->GetSpaceDescriptionV2(),
+                                            m_trajectoryChunkRows);
+        }
+        return;
+    }
 
-    Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
-    Ptr<OpenGymSpace> actionSpace = GetActionSpace();
+    // in multi-agent mode, the spaces are those of every agent
+    NS_ABORT_MSG_IF(multiAgent && m_maxVersion < 2,
+                    "Multiple agents require protocol version 2");
+    OpenGymProfiler::Scope spaces(m_profiler, OpenGymProfiler::INIT_SPACES);
+    Ptr<OpenGymSpace> obsSpace = multiAgent ? Ptr<OpenGymSpace>() : GetObservationSpace();
+    Ptr<OpenGymSpace> actionSpace = multiAgent ? Ptr<OpenGymSpace>() : GetActionSpace();
+    spaces.Stop();
 
+    // get the interface
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
+        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+
+    // v1 spaces are always sent, for Python sides that only know v1
     ns3_ai_gym::SimInitMsg simInitMsg;
+    simInitMsg.set_version(m_maxVersion);
+
+    // buffers of the following messages, if larger than those of Ns3AiGymMsg
+    uint8_t* stateBuffer = nullptr;
+    uint8_t* actBuffer = nullptr;
+    uint32_t bufferSize = MSG_BUFFER_SIZE;
+    if (m_maxVersion >= 2 && m_bufferSize > MSG_BUFFER_SIZE)
+    {
+        stateBuffer = static_cast<uint8_t*>(msgInterface->AllocatePayload(m_bufferSize));
+        actBuffer = static_cast<uint8_t*>(msgInterface->AllocatePayload(m_bufferSize));
+        NS_ABORT_MSG_IF(!stateBuffer || !actBuffer,
+                        "Cannot allocate message buffers of "
+                            << m_bufferSize << " bytes in shared memory, increase the segment "
+                            << "size (shmSize of Ns3Env) or decrease BufferSize");
+        bufferSize = m_bufferSize;
+        simInitMsg.set_buffersize(bufferSize);
+        simInitMsg.mutable_statebuffer()->set_handle(msgInterface->GetPayloadHandle(stateBuffer));
+        simInitMsg.mutable_statebuffer()->set_size(bufferSize);
+        simInitMsg.mutable_actbuffer()->set_handle(msgInterface->GetPayloadHandle(actBuffer));
+        simInitMsg.mutable_actbuffer()->set_size(bufferSize);
+    }
+
+    // delta encoding works on protobuf messages, so it excludes the flat layout, and on the
+    // same Boxes in every state, so it excludes multiple agents
+    bool delta = m_keyframeInterval > 0 && m_maxVersion >= 2 && !multiAgent;
+    simInitMsg.set_delta(delta);
+    simInitMsg.set_actionrepeat(m_actionRepeat);
+    simInitMsg.set_episodes(m_runningEpisodes);
+
+    // the flat layout needs exact element types, which come with v2, and exchanges every step
+    bool flat = m_offerFlat && !delta && decimator.IsPassThrough() && m_actionRepeat == 1 &&
+                m_maxVersion >= 2 && m_flatObs.SetSpace(obsSpace) &&
+                m_flatAct.SetSpace(actionSpace) &&
+                NS3AI_GYM_FLAT_DATA_OFFSET + m_flatObs.GetSize() <= bufferSize &&
+                NS3AI_GYM_FLAT_DATA_OFFSET + m_flatAct.GetSize() <= bufferSize;
+    simInitMsg.set_flatlayout(flat);
     if (obsSpace)
     {
         ns3_ai_gym::SpaceDescription spaceDesc;
         spaceDesc = obsSpace->GetSpaceDescription();
         simInitMsg.mutable_obsspace()->CopyFrom(spaceDesc);
+        if (m_maxVersion >= 2)
+        {
+            *simInitMsg.mutable_obsspacev2() = obsSpace->GetSpaceDescriptionV2();
+            NS_ABORT_MSG_IF(m_observationStack > 1 &&
+                                !decimator.StackSpace(simInitMsg.mutable_obsspacev2()),
+                            "ObservationStack requires a dense Box observation space");
+        }
     }
     if (actionSpace)
     {
         ns3_ai_gym::SpaceDescription spaceDesc;
         spaceDesc = actionSpace->GetSpaceDescription();
         simInitMsg.mutable_actspace()->CopyFrom(spaceDesc);
+        if (m_maxVersion >= 2)
+        {
+            *simInitMsg.mutable_actspacev2() = actionSpace->GetSpaceDescriptionV2();
+        }
+    }
+    for (const auto& agent : m_agents)
+    {
+        ns3_ai_gym::AgentSpaceV2* agentSpace = simInitMsg.add_agents();
+        agentSpace->set_agentid(agent.first);
+        if (Ptr<OpenGymSpace> space = agent.second->GetObservationSpace())
+        {
+            *agentSpace->mutable_obsspace() = space->GetSpaceDescriptionV2();
+        }
+        if (Ptr<OpenGymSpace> space = agent.second->GetActionSpace())
+        {
+            *agentSpace->mutable_actspace() = space->GetSpaceDescriptionV2();
+        }
     }
 
-    // get the interface
-    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
-        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+    // lazy observation fields, by name across all agents
+    m_obsFieldNames.clear();
+    if (m_boundEnv && !multiAgent)
+    {
+        m_obsFieldNames = m_boundEnv->GetObservationFieldNames();
+    }
+    for (const auto& agent : m_agents)
+    {
+        for (const std::string& name : agent.second->GetObservationFieldNames())
+        {
+            if (std::find(m_obsFieldNames.begin(), m_obsFieldNames.end(), name) ==
+                m_obsFieldNames.end())
+            {
+                m_obsFieldNames.push_back(name);
+            }
+        }
+    }
+    for (const std::string& name : m_obsFieldNames)
+    {
+        simInitMsg.add_obsfields(name);
+    }
 
     // send init msg to python
-    msgInterface->CppSendBegin();
+    OpenGymProfiler::Scope handshake(m_profiler, OpenGymProfiler::INIT_HANDSHAKE);
+    // the gym binding does not expose PySetStop, Python stops the simulation with stopSimReq,
+    // so the exchanges are never refused
+    NS_ABORT_MSG_UNLESS(msgInterface->CppSendBegin(), "Python stopped the exchange");
     msgInterface->GetCpp2PyStruct()->size = simInitMsg.ByteSizeLong();
-    assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
+    NS_ABORT_MSG_IF(msgInterface->GetCpp2PyStruct()->size > MSG_BUFFER_SIZE,
+                    "Init message of " << msgInterface->GetCpp2PyStruct()->size
+                                       << " bytes does not fit in MSG_BUFFER_SIZE, the spaces "
+                                       << "are too large");
     simInitMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
                                 msgInterface->GetCpp2PyStruct()->size);
     msgInterface->CppSendEnd();
 
     // receive init ack msg from python
     ns3_ai_gym::SimInitAck simInitAck;
-    msgInterface->CppRecvBegin();
+    NS_ABORT_MSG_UNLESS(msgInterface->CppRecvBegin(), "Python stopped the exchange");
     simInitAck.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
                               msgInterface->GetPy2CppStruct()->size);
     msgInterface->CppRecvEnd();
+    handshake.Stop();
 
     bool done = simInitAck.done();
     NS_LOG_DEBUG("Sim Init Ack: " << done);
+    m_version = std::clamp<uint32_t>(simInitAck.version(), 1, m_maxVersion);
+    NS_ABORT_MSG_IF(multiAgent && !simInitAck.stopsimreq() &&
+                        (!simInitAck.multiagent() || m_version < 2),
+                    "Python side does not accept multiple agents, use Ns3MultiAgentEnv");
+    m_useFlat = flat && simInitAck.flatlayout();
+    m_usePayload = m_version >= 2 && simInitAck.payload();
+    bool useDelta = delta && m_version >= 2 && simInitAck.delta();
+    m_pipeline.SetProtocol(m_version, useDelta, m_usePayload);
+    if (m_version < 2)
+    {
+        m_pipeline.GetActionCache().SetCapacity(0);
+    }
+    NS_ABORT_MSG_IF(decimator.NeedsObservation() && m_version < 2 && !simInitAck.stopsimreq(),
+                    "DecisionTolerance and ObservationStack require protocol version 2");
+    if (simInitAck.actionrepeat() > 0 && !m_useFlat)
+    {
+        decimator.SetRepeat(simInitAck.actionrepeat());
+    }
+    if (simInitAck.has_obsfields())
+    {
+        ApplyObservationFieldMask(simInitAck.obsfields());
+    }
+    m_pipeline.GetDeltaEncoder().SetKeyframeInterval(m_keyframeInterval);
+    m_pipeline.GetDeltaEncoder().Reset();
+    if (m_usePayload && stateBuffer)
+    {
+        m_stateBuffer = stateBuffer;
+        m_actBuffer = actBuffer;
+        m_bufferSize = bufferSize;
+    }
+    else
+    {
+        if (stateBuffer)
+        {
+            msgInterface->DeallocatePayload(stateBuffer);
+            msgInterface->DeallocatePayload(actBuffer);
+        }
+        m_stateBuffer = msgInterface->GetCpp2PyStruct()->buffer;
+        m_actBuffer = msgInterface->GetPy2CppStruct()->buffer;
+        m_bufferSize = MSG_BUFFER_SIZE;
+        NS_ABORT_MSG_IF(m_useFlat &&
+                            (NS3AI_GYM_FLAT_DATA_OFFSET + m_flatObs.GetSize() > m_bufferSize ||
+                             NS3AI_GYM_FLAT_DATA_OFFSET + m_flatAct.GetSize() > m_bufferSize),
+                        "Python side accepts a flat layout that does not fit in MSG_BUFFER_SIZE");
+    }
+    m_pipeline.GetPayloadArea().SetThreshold(m_inlineThreshold);
+    NS_LOG_DEBUG("Protocol version: " << m_version << ", flat layout: " << m_useFlat
+                                      << ", buffer size: " << m_bufferSize
+                                      << ", payload: " << m_usePayload
+                                      << ", delta: " << useDelta
+                                      << ", action repeat: " << decimator.GetRepeat());
     bool stopSim = simInitAck.stopsimreq();
     if (stopSim)
     {
@@ -130,6 +466,15 @@ OpenGymInterface::Init()
         Simulator::Destroy();
         std::exit(0);
     }
+    m_usePython = true;
+    if (!m_trajectoryPath.empty())
+    {
+        m_pipeline.GetTrajectory().Open(m_trajectoryPath,
+                                        Ns3AiMsgInterface::Get()->GetSegmentName(),
+                                        simInitMsg.obsspacev2(),
+                                        simInitMsg.actspacev2(),
+                                        m_trajectoryChunkRows);
+    }
 }
 
 void
@@ -139,70 +484,433 @@ OpenGymInterface::NotifyCurrentState()
     {
         Init();
     }
-    if (m_stopEnvRequested)
+    // after a reset, the states of the episode are no longer awaited
+    if (m_stopEnvRequested || m_episodeReset)
     {
         return;
     }
-    // collect current env state
-    Ptr<OpenGymDataContainer> obsDataContainer = GetObservation();
-    float reward = GetReward();
-    bool isGameOver = IsGameOver();
-    std::string extraInfo = GetExtraInfo();
-    ns3_ai_gym::EnvStateMsg envStateMsg;
-    // observation
-    ns3_ai_gym::DataContainer obsDataContainerPbMsg;
-    if (obsDataContainer)
+    if (!m_agents.empty())
     {
-        obsDataContainerPbMsg = obsDataContainer->GetDataContainerPbMsg();
-        envStateMsg.mutable_obsdata()->CopyFrom(obsDataContainerPbMsg);
+        NotifyAgents();
+        return;
     }
-    // reward
-    envStateMsg.set_reward(reward);
-    // game over
-    envStateMsg.set_isgameover(false);
-    if (isGameOver)
+    // while a policy acts, Python only gets the final state
+    if (m_useFlat && (!m_policy || m_simEnd))
     {
-        envStateMsg.set_isgameover(true);
-        if (m_simEnd)
+        NotifyCurrentStateFlat();
+        return;
+    }
+    OpenGymStepState& state = m_stepState;
+    CollectState(state);
+
+    // between decisions, the action of the last decision is executed again
+    if (!m_pipeline.Decimate(state))
+    {
+        if (Ptr<OpenGymDataContainer> action = m_pipeline.GetRepeatedAction())
+        {
+            OpenGymProfiler::Scope execute(m_profiler, OpenGymProfiler::EXECUTE);
+            ExecuteActions(action);
+        }
+        return;
+    }
+
+    // the trajectory records the states and actions of the decisions
+    m_pipeline.Record(state);
+    if (m_simEnd)
+    {
+        // Python may kill the simulation once it has the final state
+        m_pipeline.GetTrajectory().Sync();
+    }
+
+    // an observation seen before gets the action the agent gave to it
+    Ptr<OpenGymDataContainer> action;
+    if (const ns3_ai_gym::DataV2* cached = m_pipeline.LookupAction(state))
+    {
+        OpenGymProfiler::Scope decode(m_profiler, OpenGymProfiler::DECODE);
+        action = m_pipeline.DecodeData(*cached);
+        decode.Stop();
+        m_pipeline.AcceptAction(action);
+    }
+    else if (m_policy && !(m_simEnd && m_usePython))
+    {
+        // as in shared memory mode, the policy is not asked to act on the final state
+        if (state.isGameOver)
         {
-            envStateMsg.set_reason(ns3_ai_gym::EnvStateMsg::SimulationEnd);
+            return;
         }
-        else
+        OpenGymProfiler::Scope wait(m_profiler, OpenGymProfiler::WAIT);
+        action = m_policy->GetAction(state.obs, state.reward, state.isGameOver, state.extraInfo);
+        wait.Stop();
+        m_pipeline.AcceptAction(action);
+    }
+    else
+    {
+        if (!ExchangeState(state))
         {
-            envStateMsg.set_reason(ns3_ai_gym::EnvStateMsg::GameOver);
+            return;
         }
+        // first step after reset is called without actions, just to get current state
+        OpenGymProfiler::Scope decode(m_profiler, OpenGymProfiler::DECODE);
+        action = m_pipeline.DecodeAction();
+        decode.Stop();
+        m_pipeline.AcceptAction(action, &m_pipeline.GetReply().actdatav2());
     }
-    // extra info
-    envStateMsg.set_info(extraInfo);
+    OpenGymProfiler::Scope execute(m_profiler, OpenGymProfiler::EXECUTE);
+    ExecuteActions(action);
+}
+
+void
+OpenGymInterface::CollectState(OpenGymStepState& state)
+{
+    OpenGymProfiler::Scope observation(m_profiler, OpenGymProfiler::OBSERVATION);
+    state.obs = GetObservation();
+    observation.Stop();
+    OpenGymProfiler::Scope reward(m_profiler, OpenGymProfiler::REWARD);
+    state.reward = GetReward();
+    state.isGameOver = IsGameOver();
+    state.simEnd = m_simEnd;
+    state.extraInfo = GetExtraInfo();
+}
+
+bool
+OpenGymInterface::ExchangeState(const OpenGymStepState& state)
+{
+    OpenGymProfiler::Scope serialize(m_profiler, OpenGymProfiler::SERIALIZE);
+    const ns3_ai_gym::EnvStateMsg& envStateMsg =
+        m_pipeline.EncodeState(state, m_simEnd && m_profiler.IsEnabled() ? &m_profiler : nullptr);
 
     // get the interface
     Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
         Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
 
     // send env state msg to python
-    msgInterface->CppSendBegin();
+    NS_ABORT_MSG_UNLESS(msgInterface->CppSendBegin(), "Python stopped the exchange");
     msgInterface->GetCpp2PyStruct()->size = envStateMsg.ByteSizeLong();
-    assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
-    envStateMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
-                                 msgInterface->GetCpp2PyStruct()->size);
+    NS_ABORT_MSG_IF(msgInterface->GetCpp2PyStruct()->size > m_bufferSize,
+                    "State of " << msgInterface->GetCpp2PyStruct()->size << " bytes does not fit "
+                                << "in the buffer of " << m_bufferSize << " bytes, increase "
+                                << "BufferSize or decrease InlineThreshold");
+    envStateMsg.SerializeToArray(m_stateBuffer, msgInterface->GetCpp2PyStruct()->size);
+    serialize.Stop();
 
     msgInterface->CppSendEnd();
 
     // receive act msg from python
-    ns3_ai_gym::EnvActMsg envActMsg;
-    msgInterface->CppRecvBegin();
+    OpenGymProfiler::Scope wait(m_profiler, OpenGymProfiler::WAIT);
+    NS_ABORT_MSG_UNLESS(msgInterface->CppRecvBegin(), "Python stopped the exchange");
+    wait.Stop();
+    OpenGymProfiler::Scope parse(m_profiler, OpenGymProfiler::PARSE);
+    const ns3_ai_gym::EnvActMsg& envActMsg =
+        m_pipeline.DecodeReply(m_actBuffer, msgInterface->GetPy2CppStruct()->size);
+    msgInterface->CppRecvEnd();
+    parse.Stop();
+
+    if (m_simEnd)
+    {
+        // if sim end only rx msg and quit, or go on with the next episode
+        m_stopEnvRequested = envActMsg.stopsimreq();
+        return false;
+    }
+
+    if (m_runningEpisodes && envActMsg.resetreq())
+    {
+        EndEpisode();
+        return false;
+    }
+    bool stopSim = envActMsg.stopsimreq();
+    if (stopSim)
+    {
+        NS_LOG_DEBUG("---Stop requested: " << stopSim);
+        m_stopEnvRequested = true;
+        m_pipeline.GetTrajectory().Close();
+        Simulator::Stop();
+        Simulator::Destroy();
+        std::exit(0);
+    }
+
+    if (envActMsg.has_obsfields())
+    {
+        ApplyObservationFieldMask(envActMsg.obsfields());
+    }
+    return true;
+}
+
+void
+OpenGymInterface::NotifyCurrentStateFlat()
+{
+    OpenGymProfiler::Scope rewardScope(m_profiler, OpenGymProfiler::REWARD);
+    float reward = GetReward();
+    bool isGameOver = IsGameOver();
+    std::string extraInfo = GetExtraInfo();
+    rewardScope.Stop();
+    OpenGymTrajectoryWriter& trajectory = m_pipeline.GetTrajectory();
+    OpenGymActionCache& actionCache = m_pipeline.GetActionCache();
+
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
+        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+
+    // write the state in place; Python has read the previous one before replying to it, so
+    // the observation can be written before sending, which is skipped if its action is cached
+    auto state = reinterpret_cast<Ns3AiGymFlatState*>(m_stateBuffer);
+    m_flatObs.SetBuffer(m_stateBuffer + NS3AI_GYM_FLAT_DATA_OFFSET);
+    OpenGymProfiler::Scope observation(m_profiler, OpenGymProfiler::OBSERVATION);
+    if (!GetObservationFlat(m_flatObs))
+    {
+        Ptr<OpenGymDataContainer> obsDataContainer = GetObservation();
+        NS_ABORT_MSG_IF(!obsDataContainer, "No observation");
+        obsDataContainer->FillDataPbMsgV2(&m_flatDataPbMsg, nullptr);
+        const ns3_ai_gym::BoxDataV2& box = m_flatDataPbMsg.box();
+        NS_ABORT_MSG_IF(box.dtype() != m_flatObs.GetDataType() ||
+                            box.data().size() != m_flatObs.GetSize(),
+                        "Observation does not match the observation space");
+        std::memcpy(m_flatObs.GetBuffer(), box.data().data(), box.data().size());
+    }
+    observation.Stop();
+    if (trajectory.IsOpen())
+    {
+        trajectory.AddState(m_flatObs.GetBuffer(),
+                            m_flatObs.GetSize(),
+                            reward,
+                            isGameOver,
+                            extraInfo);
+        if (m_simEnd)
+        {
+            // Python may kill the simulation once it has the final state
+            trajectory.Sync();
+        }
+    }
+
+    // an observation seen before gets the action the agent gave to it
+    bool cacheable = actionCache.IsEnabled() && !isGameOver;
+    std::string_view obsKey(reinterpret_cast<const char*>(m_flatObs.GetBuffer()),
+                            m_flatObs.GetSize());
+    if (cacheable)
+    {
+        if (std::string* cached = actionCache.Lookup(obsKey))
+        {
+            m_pipeline.DeferReward(reward);
+            m_flatAct.SetBuffer(reinterpret_cast<uint8_t*>(cached->data()));
+            if (trajectory.IsOpen())
+            {
+                trajectory.AddAction(m_flatAct.GetBuffer(), m_flatAct.GetSize());
+            }
+            OpenGymProfiler::Scope execute(m_profiler, OpenGymProfiler::EXECUTE);
+            ExecuteFlatAction();
+            return;
+        }
+    }
+    // the agent gets the rewards of the states answered by the cache with this one
+    reward += m_pipeline.TakeDeferredReward();
 
-    envActMsg.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
-                             msgInterface->GetPy2CppStruct()->size);
+    NS_ABORT_MSG_UNLESS(msgInterface->CppSendBegin(), "Python stopped the exchange");
+    Ns3AiGymMsg* stateMsg = msgInterface->GetCpp2PyStruct();
+    OpenGymProfiler::Scope serialize(m_profiler, OpenGymProfiler::SERIALIZE);
+    state->reward = reward;
+    state->isGameOver = isGameOver;
+    state->reason = m_simEnd ? ns3_ai_gym::EnvStateMsg::SimulationEnd
+                             : ns3_ai_gym::EnvStateMsg::GameOver;
+    // the info string follows the observation, aligned to 8 bytes
+    state->infoOffset = NS3AI_GYM_FLAT_DATA_OFFSET + (m_flatObs.GetSize() + 7) / 8 * 8;
+    state->infoSize = extraInfo.size();
+    NS_ABORT_MSG_IF(state->infoOffset + state->infoSize > m_bufferSize,
+                    "Extra info of " << extraInfo.size() << " bytes does not fit in the message");
+    std::memcpy(m_stateBuffer + state->infoOffset, extraInfo.data(), extraInfo.size());
+    stateMsg->size = state->infoOffset + state->infoSize;
+    // the profile so far follows the info in the final state, if it fits
+    state->statsSize = 0;
+    if (m_simEnd && m_profiler.IsEnabled())
+    {
+        ns3_ai_gym::ProfileStats stats;
+        m_profiler.FillStatsPbMsg(&stats);
+        std::size_t statsSize = stats.ByteSizeLong();
+        if (statsSize <= UINT16_MAX && stateMsg->size + statsSize <= m_bufferSize)
+        {
+            stats.SerializeToArray(m_stateBuffer + stateMsg->size, statsSize);
+            state->statsSize = statsSize;
+            stateMsg->size += statsSize;
+        }
+    }
+    serialize.Stop();
+    msgInterface->CppSendEnd();
+
+    // read the action in place
+    OpenGymProfiler::Scope wait(m_profiler, OpenGymProfiler::WAIT);
+    NS_ABORT_MSG_UNLESS(msgInterface->CppRecvBegin(), "Python stopped the exchange");
+    wait.Stop();
+    auto act = reinterpret_cast<const Ns3AiGymFlatAction*>(m_actBuffer);
+    bool stopSim = act->stopSimReq;
+    bool reset = m_runningEpisodes && act->resetReq;
+    if (!m_simEnd && !stopSim && !reset && act->hasAction)
+    {
+        m_flatAct.SetBuffer(m_actBuffer + NS3AI_GYM_FLAT_DATA_OFFSET);
+        if (cacheable)
+        {
+            actionCache.Insert(
+                obsKey,
+                std::string_view(reinterpret_cast<const char*>(m_flatAct.GetBuffer()),
+                                 m_flatAct.GetSize()));
+        }
+        if (trajectory.IsOpen())
+        {
+            trajectory.AddAction(m_flatAct.GetBuffer(), m_flatAct.GetSize());
+        }
+        OpenGymProfiler::Scope execute(m_profiler, OpenGymProfiler::EXECUTE);
+        ExecuteFlatAction();
+    }
     msgInterface->CppRecvEnd();
 
     if (m_simEnd)
     {
-        // if sim end only rx msg and quit
+        m_stopEnvRequested = stopSim;
+        return;
+    }
+    if (reset)
+    {
+        EndEpisode();
         return;
     }
+    if (stopSim)
+    {
+        NS_LOG_DEBUG("---Stop requested: " << stopSim);
+        m_stopEnvRequested = true;
+        trajectory.Close();
+        Simulator::Stop();
+        Simulator::Destroy();
+        std::exit(0);
+    }
+}
 
-    bool stopSim = envActMsg.stopsimreq();
+void
+OpenGymInterface::ExecuteFlatAction()
+{
+    if (ExecuteActionsFlat(m_flatAct))
+    {
+        return;
+    }
+    ns3_ai_gym::BoxDataV2* box = m_flatDataPbMsg.mutable_box();
+    box->set_dtype(m_flatAct.GetDataType());
+    box->mutable_shape()->Clear();
+    box->mutable_shape()->Add(m_flatAct.GetShape().begin(), m_flatAct.GetShape().end());
+    box->mutable_data()->assign(reinterpret_cast<const char*>(m_flatAct.GetBuffer()),
+                                m_flatAct.GetSize());
+    ExecuteActions(m_pipeline.DecodeData(m_flatDataPbMsg));
+}
+
+void
+OpenGymInterface::NotifyAgent(Ptr<OpenGymEnv> entity)
+{
+    NS_LOG_FUNCTION(this << entity);
+    uint32_t agentId = entity->GetAgentId();
+    auto it = m_agents.find(agentId);
+    NS_ABORT_MSG_IF(it == m_agents.end() || it->second != entity,
+                    "Environment notified in multi-agent mode without an agent ID");
+    if (std::find(m_notifiedAgents.begin(), m_notifiedAgents.end(), agentId) ==
+        m_notifiedAgents.end())
+    {
+        m_notifiedAgents.push_back(agentId);
+    }
+    // after the events of the current time scheduled so far, which may notify other agents
+    if (m_notifyAgentsEvent.IsExpired())
+    {
+        m_notifyAgentsEvent = Simulator::ScheduleNow(&OpenGymInterface::NotifyAgents, this);
+    }
+}
+
+void
+OpenGymInterface::NotifyAgents()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_initSimMsgSent)
+    {
+        Init();
+    }
+    if (m_stopEnvRequested || m_episodeReset)
+    {
+        return;
+    }
+    m_notifyAgentsEvent.Cancel();
+    if (m_simEnd)
+    {
+        // every agent gets the final state
+        m_notifiedAgents.clear();
+        for (const auto& agent : m_agents)
+        {
+            m_notifiedAgents.push_back(agent.first);
+        }
+    }
+
+    // collect the states of the notified agents
+    m_pipeline.GetPayloadArea().Reset();
+    OpenGymPayloadArea* payload = m_usePayload ? &m_pipeline.GetPayloadArea() : nullptr;
+    ns3_ai_gym::EnvStateBatchMsg& batchMsg = m_stateBatchMsg;
+    batchMsg.Clear();
+    for (uint32_t agentId : m_notifiedAgents)
+    {
+        Ptr<OpenGymEnv> env = m_agents[agentId];
+        ns3_ai_gym::EnvStateMsg* envStateMsg = batchMsg.add_agents();
+        envStateMsg->set_agentid(agentId);
+        OpenGymProfiler::Scope observation(m_profiler, OpenGymProfiler::OBSERVATION);
+        Ptr<OpenGymDataContainer> obsDataContainer = env->GetObservation();
+        observation.Stop();
+        OpenGymProfiler::Scope serialize(m_profiler, OpenGymProfiler::SERIALIZE);
+        if (obsDataContainer)
+        {
+            obsDataContainer->FillDataPbMsgV2(envStateMsg->mutable_obsdatav2(), payload);
+        }
+        serialize.Stop();
+        OpenGymProfiler::Scope rewardScope(m_profiler, OpenGymProfiler::REWARD);
+        bool isGameOver = env->GetGameOver() || m_simEnd;
+        envStateMsg->set_reward(env->GetReward());
+        envStateMsg->set_isgameover(isGameOver);
+        envStateMsg->set_reason(isGameOver && !m_simEnd ? ns3_ai_gym::EnvStateMsg::GameOver
+                                                        : ns3_ai_gym::EnvStateMsg::SimulationEnd);
+        envStateMsg->set_info(env->GetExtraInfo());
+    }
+    if (m_simEnd && m_profiler.IsEnabled())
+    {
+        m_profiler.FillStatsPbMsg(batchMsg.mutable_stats());
+    }
+    // actions may notify agents again, for the next message
+    m_notifiedAgents.clear();
+
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
+        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+
+    // send the states to python
+    OpenGymProfiler::Scope serialize(m_profiler, OpenGymProfiler::SERIALIZE);
+    NS_ABORT_MSG_UNLESS(msgInterface->CppSendBegin(), "Python stopped the exchange");
+    msgInterface->GetCpp2PyStruct()->size = batchMsg.ByteSizeLong();
+    NS_ABORT_MSG_IF(msgInterface->GetCpp2PyStruct()->size > m_bufferSize,
+                    "States of " << msgInterface->GetCpp2PyStruct()->size << " bytes do not fit "
+                                 << "in the buffer of " << m_bufferSize << " bytes, increase "
+                                 << "BufferSize or decrease InlineThreshold");
+    batchMsg.SerializeToArray(m_stateBuffer, msgInterface->GetCpp2PyStruct()->size);
+    serialize.Stop();
+    msgInterface->CppSendEnd();
+
+    // receive the actions from python
+    ns3_ai_gym::EnvActBatchMsg& actBatchMsg = m_actBatchMsg;
+    OpenGymProfiler::Scope wait(m_profiler, OpenGymProfiler::WAIT);
+    NS_ABORT_MSG_UNLESS(msgInterface->CppRecvBegin(), "Python stopped the exchange");
+    wait.Stop();
+    OpenGymProfiler::Scope parse(m_profiler, OpenGymProfiler::PARSE);
+    actBatchMsg.ParseFromArray(m_actBuffer, msgInterface->GetPy2CppStruct()->size);
+    msgInterface->CppRecvEnd();
+    parse.Stop();
+
+    if (m_simEnd)
+    {
+        // if sim end only rx msg and quit, or go on with the next episode
+        m_stopEnvRequested = actBatchMsg.stopsimreq();
+        return;
+    }
+
+    if (m_runningEpisodes && actBatchMsg.resetreq())
+    {
+        EndEpisode();
+        return;
+    }
+    bool stopSim = actBatchMsg.stopsimreq();
     if (stopSim)
     {
         NS_LOG_DEBUG("---Stop requested: " << stopSim);
@@ -212,11 +920,26 @@ OpenGymInterface::NotifyCurrentState()
         std::exit(0);
     }
 
-    // first step after reset is called without actions, just to get current state
-    ns3_ai_gym::DataContainer actDataContainerPbMsg = envActMsg.actdata();
-    Ptr<OpenGymDataContainer> actDataContainer =
-        OpenGymDataContainer::CreateFromDataContainerPbMsg(actDataContainerPbMsg);
-    ExecuteActions(actDataContainer);
+    if (actBatchMsg.has_obsfields())
+    {
+        ApplyObservationFieldMask(actBatchMsg.obsfields());
+    }
+
+    // agents without an action are skipped, e.g. when they are done
+    for (const ns3_ai_gym::EnvActMsg& envActMsg : actBatchMsg.agents())
+    {
+        auto it = m_agents.find(envActMsg.agentid());
+        NS_ABORT_MSG_IF(it == m_agents.end(), "Action of unknown agent " << envActMsg.agentid());
+        if (envActMsg.actdatav2().data_case() != ns3_ai_gym::DataV2::DATA_NOT_SET)
+        {
+            OpenGymProfiler::Scope decode(m_profiler, OpenGymProfiler::DECODE);
+            Ptr<OpenGymDataContainer> action =
+                OpenGymDataContainer::CreateFromDataPbMsgV2(envActMsg.actdatav2());
+            decode.Stop();
+            OpenGymProfiler::Scope execute(m_profiler, OpenGymProfiler::EXECUTE);
+            it->second->ExecuteActions(action);
+        }
+    }
 }
 
 void
@@ -227,15 +950,165 @@ OpenGymInterface::WaitForStop()
     NotifyCurrentState();
 }
 
+void
+OpenGymInterface::Checkpoint()
+{
+    NS_LOG_FUNCTION(this);
+    // children would share the segment mapped by the server
+    NS_ABORT_MSG_IF(m_initSimMsgSent, "Checkpoint must be reached before the first Notify");
+    if (!std::getenv("NS3AI_FORK_SERVER"))
+    {
+        return;
+    }
+
+    // children are reaped by the system
+    std::signal(SIGCHLD, SIG_IGN);
+    // every request is the name of a segment already created by Python
+    std::string segmentName;
+    while (std::getline(std::cin, segmentName))
+    {
+        if (segmentName.empty())
+        {
+            continue;
+        }
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Cannot fork the episode on segment " << segmentName);
+        if (pid == 0)
+        {
+            std::signal(SIGCHLD, SIG_DFL);
+            setenv("NS3AI_SEGMENT_NAME", segmentName.c_str(), 1);
+            unsetenv("NS3AI_FORK_SERVER");
+            return;
+        }
+        NS_LOG_DEBUG("Episode on segment " << segmentName << " forked as process " << pid);
+    }
+    // Python closed the requests
+    std::exit(0);
+}
+
+void
+OpenGymInterface::RunEpisodes(Callback<void> scenario, const std::vector<uint64_t>& seeds)
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_initSimMsgSent, "RunEpisodes must be called before the first Notify");
+    m_runningEpisodes = true;
+    uint64_t run = RngSeedManager::GetRun();
+    for (uint64_t episode = 0;; ++episode)
+    {
+        RngSeedManager::SetRun(seeds.empty() ? run + episode : seeds[episode % seeds.size()]);
+        m_episodeSetup = true;
+        scenario();
+        m_episodeSetup = false;
+        Simulator::Run();
+        if (!m_episodeReset)
+        {
+            // the episode ran to its end, and Python replies to its final state
+            NotifySimulationEnd();
+        }
+        Simulator::Destroy();
+        // without Python, nothing resets the environment, so every seed runs once
+        if (m_stopEnvRequested || (!m_usePython && episode + 1 >= seeds.size()))
+        {
+            m_pipeline.GetTrajectory().Close();
+            m_policy = nullptr;
+            std::exit(0);
+        }
+
+        // the exchange goes on with the next episode, without a new handshake
+        NS_LOG_DEBUG("Episode " << episode << " is over");
+        m_simEnd = false;
+        m_episodeReset = false;
+        m_boundEnv = nullptr;
+        m_agents.clear();
+        m_notifiedAgents.clear();
+        m_notifyAgentsEvent = EventId();
+        m_pipeline.Reset();
+    }
+}
+
+void
+OpenGymInterface::EndEpisode()
+{
+    NS_LOG_FUNCTION(this);
+    NS_LOG_DEBUG("---Reset requested");
+    m_episodeReset = true;
+    Simulator::Stop();
+}
+
+const OpenGymProfiler&
+OpenGymInterface::GetProfiler() const
+{
+    return m_profiler;
+}
+
+const OpenGymActionCache&
+OpenGymInterface::GetActionCache() const
+{
+    return m_pipeline.GetActionCache();
+}
+
+void
+OpenGymInterface::InvalidateActionCache()
+{
+    NS_LOG_FUNCTION(this);
+    m_pipeline.GetActionCache().Clear();
+}
+
+void
+OpenGymInterface::SetPolicy(Ptr<OpenGymPolicy> policy)
+{
+    NS_LOG_FUNCTION(this << policy);
+    NS_ABORT_MSG_IF(policy && !m_agents.empty(), "A policy does not support multiple agents");
+    NS_ABORT_MSG_IF(policy && m_pipeline.GetDecimator().NeedsObservation(),
+                    "A policy does not support DecisionTolerance and ObservationStack");
+    NS_ABORT_MSG_IF(!policy && m_initSimMsgSent && !m_usePython,
+                    "No Python side to give the decisions back to");
+    if (policy && m_initSimMsgSent)
+    {
+        policy->SetSpaces(GetObservationSpace(), GetActionSpace());
+    }
+    m_policy = policy;
+    // the cached actions are those of the previous policy
+    m_pipeline.GetActionCache().Clear();
+}
+
+Ptr<OpenGymPolicy>
+OpenGymInterface::GetPolicy() const
+{
+    return m_policy;
+}
+
 void
 OpenGymInterface::NotifySimulationEnd()
 {
     NS_LOG_FUNCTION(this);
+    // with multiple agents, every one of them may end the simulation
+    if (m_simEnd)
+    {
+        return;
+    }
     m_simEnd = true;
     if (m_initSimMsgSent)
     {
         WaitForStop();
     }
+    if (m_profiler.IsEnabled())
+    {
+        m_profiler.Print(std::cout);
+    }
+    const OpenGymActionCache& actionCache = m_pipeline.GetActionCache();
+    if (actionCache.IsEnabled())
+    {
+        NS_LOG_INFO("Action cache hits: " << actionCache.GetHits()
+                                          << ", misses: " << actionCache.GetMisses());
+    }
+    // release the policy, which finalizes the embedded interpreter, while the simulation is
+    // still alive
+    if (!m_runningEpisodes)
+    {
+        m_pipeline.GetTrajectory().Close();
+        m_policy = nullptr;
+    }
 }
 
 Ptr<OpenGymSpace>
@@ -322,6 +1195,30 @@ OpenGymInterface::ExecuteActions(Ptr<OpenGymDataContainer> action)
     return reply;
 }
 
+bool
+OpenGymInterface::GetObservationFlat(const OpenGymFlatLayout& obs)
+{
+    NS_LOG_FUNCTION(this);
+    bool written = false;
+    if (!m_obsFlatCb.IsNull())
+    {
+        written = m_obsFlatCb(obs);
+    }
+    return written;
+}
+
+bool
+OpenGymInterface::ExecuteActionsFlat(const OpenGymFlatLayout& action)
+{
+    NS_LOG_FUNCTION(this);
+    bool executed = false;
+    if (!m_actionFlatCb.IsNull())
+    {
+        executed = m_actionFlatCb(action);
+    }
+    return executed;
+}
+
 void
 OpenGymInterface::SetGetActionSpaceCb(Callback<Ptr<OpenGymSpace>> cb)
 {
@@ -337,33 +1234,52 @@ OpenGymInterface::SetGetObservationSpaceCb(Callback<Ptr<OpenGymSpace>> cb)
 void
 OpenGymInterface::SetGetGameOverCb(Callback<bool> cb)
 {
+    m_boundEnv = nullptr;
     m_gameOverCb = cb;
 }
 
 void
 OpenGymInterface::SetGetObservationCb(Callback<Ptr<OpenGymDataContainer>> cb)
 {
+    m_boundEnv = nullptr;
     m_obsCb = cb;
 }
 
 void
 OpenGymInterface::SetGetRewardCb(Callback<float> cb)
 {
+    m_boundEnv = nullptr;
     m_rewardCb = cb;
 }
 
 void
 OpenGymInterface::SetGetExtraInfoCb(Callback<std::string> cb)
 {
+    m_boundEnv = nullptr;
     m_extraInfoCb = cb;
 }
 
 void
 OpenGymInterface::SetExecuteActionsCb(Callback<bool, Ptr<OpenGymDataContainer>> cb)
 {
+    m_boundEnv = nullptr;
     m_actionCb = cb;
 }
 
+void
+OpenGymInterface::SetGetObservationFlatCb(Callback<bool, const OpenGymFlatLayout&> cb)
+{
+    m_boundEnv = nullptr;
+    m_obsFlatCb = cb;
+}
+
+void
+OpenGymInterface::SetExecuteActionsFlatCb(Callback<bool, const OpenGymFlatLayout&> cb)
+{
+    m_boundEnv = nullptr;
+    m_actionFlatCb = cb;
+}
+
 void
 OpenGymInterface::DoInitialize()
 {
@@ -374,6 +1290,9 @@ void
 OpenGymInterface::DoDispose()
 {
     NS_LOG_FUNCTION(this);
+    m_notifyAgentsEvent.Cancel();
+    m_agents.clear();
+    m_policy = nullptr;
 }
 
 void
@@ -381,15 +1300,75 @@ OpenGymInterface::Notify(Ptr<OpenGymEnv> entity)
 {
     NS_LOG_FUNCTION(this);
 
-    SetGetGameOverCb(MakeCallback(&OpenGymEnv::GetGameOver, entity));
-    SetGetObservationCb(MakeCallback(&OpenGymEnv::GetObservation, entity));
-    SetGetRewardCb(MakeCallback(&OpenGymEnv::GetReward, entity));
-    SetGetExtraInfoCb(MakeCallback(&OpenGymEnv::GetExtraInfo, entity));
-    SetExecuteActionsCb(MakeCallback(&OpenGymEnv::ExecuteActions, entity));
+    if (!m_agents.empty())
+    {
+        NotifyAgent(entity);
+        return;
+    }
+
+    // binding allocates, so only rebind when another environment notifies
+    if (PeekPointer(entity) != m_boundEnv)
+    {
+        SetGetGameOverCb(MakeCallback(&OpenGymEnv::GetGameOver, entity));
+        SetGetObservationCb(MakeCallback(&OpenGymEnv::GetObservation, entity));
+        SetGetRewardCb(MakeCallback(&OpenGymEnv::GetReward, entity));
+        SetGetExtraInfoCb(MakeCallback(&OpenGymEnv::GetExtraInfo, entity));
+        SetExecuteActionsCb(MakeCallback(&OpenGymEnv::ExecuteActions, entity));
+        SetGetObservationFlatCb(MakeCallback(&OpenGymEnv::GetObservationFlat, entity));
+        SetExecuteActionsFlatCb(MakeCallback(&OpenGymEnv::ExecuteActionsFlat, entity));
+        m_boundEnv = PeekPointer(entity);
+    }
 
     NotifyCurrentState();
 }
 
+void
+OpenGymInterface::RegisterAgent(uint32_t agentId, Ptr<OpenGymEnv> env)
+{
+    NS_LOG_FUNCTION(this << agentId << env);
+    NS_ABORT_MSG_IF(m_initSimMsgSent && !m_episodeSetup,
+                    "Agents must be registered before the first Notify of the episode");
+    auto it = m_agents.find(agentId);
+    NS_ABORT_MSG_IF(it != m_agents.end() && it->second != env,
+                    "Agent ID " << agentId << " is already registered");
+    // an environment is registered under its last ID only
+    for (auto agent = m_agents.begin(); agent != m_agents.end();)
+    {
+        agent = agent->second == env ? m_agents.erase(agent) : std::next(agent);
+    }
+    m_agents[agentId] = env;
+}
+
+void
+OpenGymInterface::SetObservationFieldMask(const std::vector<std::string>& fields)
+{
+    NS_LOG_FUNCTION(this);
+    m_obsFieldMask = fields;
+}
+
+bool
+OpenGymInterface::IsObservationFieldRequested(const std::string& name) const
+{
+    return m_obsFieldMask.empty() ||
+           std::find(m_obsFieldMask.begin(), m_obsFieldMask.end(), name) != m_obsFieldMask.end();
+}
+
+void
+OpenGymInterface::ApplyObservationFieldMask(const ns3_ai_gym::FieldMask& mask)
+{
+    NS_LOG_FUNCTION(this);
+    for (const std::string& name : mask.fields())
+    {
+        NS_ABORT_MSG_IF(std::find(m_obsFieldNames.begin(), m_obsFieldNames.end(), name) ==
+                            m_obsFieldNames.end(),
+                        "Python requests unknown observation field " << name);
+    }
+    SetObservationFieldMask({mask.fields().begin(), mask.fields().end()});
+    // the observation changes its structure, so the next one is a keyframe and a decision
+    m_pipeline.GetDeltaEncoder().Reset();
+    m_pipeline.GetDecimator().Reset();
+}
+
 Ptr<OpenGymInterface>*
 OpenGymInterface::DoGet()
 {
@@ -23,13 +23,22 @@
 #define NS3_NS3_AI_GYM_INTERFACE_H
 
 #include "../ns3-ai-gym-msg.h"
+#include "flat-layout.h"
+#include "policy.h"
+#include "profiler.h"
+#include "step-pipeline.h"
 
 #include <ns3/ai-module.h>
 #include <ns3/callback.h>
+#include <ns3/event-id.h>
 #include <ns3/object.h>
 #include <ns3/ptr.h>
 #include <ns3/type-id.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 namespace ns3
 {
 
@@ -50,6 +59,27 @@ class OpenGymInterface : public Object
     void WaitForStop();
     void NotifySimulationEnd();
 
+    /**
+     * Mark the end of the scenario setup, before the first Notify. In
+     * fork-server mode (NS3AI_FORK_SERVER environment variable, set by
+     * Experiment), the process waits here for episodes requested by Python,
+     * and forks a child returning from Checkpoint for each one, attached to
+     * the segment named in the request. Otherwise, it returns at once.
+     */
+    void Checkpoint();
+
+    /**
+     * Run episodes in this process. For every episode, the run number of
+     * the random generators is set to the next seed, the scenario builds the
+     * simulation, which is run, and it is destroyed when the episode is over.
+     * Python resets the environment with a message instead of launching the
+     * simulation again, so the segment and the handshake stay alive. Seeds
+     * are used in turn; if there are none, the run number is incremented for
+     * every episode. Does not return: the process exits when Python stops the
+     * simulation, or after every seed once with the embedded agent.
+     */
+    void RunEpisodes(Callback<void> scenario, const std::vector<uint64_t>& seeds);
+
     Ptr<OpenGymSpace> GetActionSpace();
     Ptr<OpenGymSpace> GetObservationSpace();
     Ptr<OpenGymDataContainer> GetObservation();
@@ -57,6 +87,8 @@ class OpenGymInterface : public Object
     bool IsGameOver();
     std::string GetExtraInfo();
     bool ExecuteActions(Ptr<OpenGymDataContainer> action);
+    bool GetObservationFlat(const OpenGymFlatLayout& obs);
+    bool ExecuteActionsFlat(const OpenGymFlatLayout& action);
 
     void SetGetActionSpaceCb(Callback<Ptr<OpenGymSpace>> cb);
     void SetGetObservationSpaceCb(Callback<Ptr<OpenGymSpace>> cb);
@@ -65,9 +97,64 @@ class OpenGymInterface : public Object
     void SetGetGameOverCb(Callback<bool> cb);
     void SetGetExtraInfoCb(Callback<std::string> cb);
     void SetExecuteActionsCb(Callback<bool, Ptr<OpenGymDataContainer>> cb);
+    void SetGetObservationFlatCb(Callback<bool, const OpenGymFlatLayout&> cb);
+    void SetExecuteActionsFlatCb(Callback<bool, const OpenGymFlatLayout&> cb);
 
     void Notify(Ptr<OpenGymEnv> entity);
 
+    /**
+     * Register an environment as the agent with the given ID. With agents
+     * registered, states of the agents notified at the same simulation time
+     * are sent to Python in one message, and their actions are executed
+     * after the events of that time scheduled so far.
+     */
+    void RegisterAgent(uint32_t agentId, Ptr<OpenGymEnv> env);
+
+    /**
+     * Set the observation fields requested by the agent, by name. Empty to
+     * request all of them, which is the default.
+     */
+    void SetObservationFieldMask(const std::vector<std::string>& fields);
+
+    /**
+     * Whether the agent requests the observation field of the given name
+     */
+    bool IsObservationFieldRequested(const std::string& name) const;
+
+    /**
+     * Time spent in the phases of Init and of the steps so far, if the
+     * Profile attribute is set. It is printed at NotifySimulationEnd, and
+     * sent to Python with the final state.
+     */
+    const OpenGymProfiler& GetProfiler() const;
+
+    /**
+     * Actions cached by observation if the ActionCacheSize attribute is set,
+     * with the hits and misses so far
+     */
+    const OpenGymActionCache& GetActionCache() const;
+
+    /**
+     * Drop the cached actions, e.g. after the policy changed
+     */
+    void InvalidateActionCache();
+
+    /**
+     * Set a policy acting in this process from the next state on, instead of
+     * the agent in Python, e.g. a native module for evaluation. A policy set
+     * before the first Notify replaces Python for the whole run, and there is
+     * no handshake. Otherwise Python waits while the policy acts, and gets the
+     * final state of the simulation; setting a null policy gives the
+     * decisions back to it. Cached actions are dropped.
+     */
+    void SetPolicy(Ptr<OpenGymPolicy> policy);
+
+    /**
+     * The policy acting instead of Python, null if none. It is the embedded
+     * agent if the EmbeddedAgent attribute is set.
+     */
+    Ptr<OpenGymPolicy> GetPolicy() const;
+
   protected:
     // Inherited
     void DoInitialize() override;
@@ -75,11 +162,61 @@ class OpenGymInterface : public Object
 
   private:
     static Ptr<OpenGymInterface>* DoGet();
+    void CollectState(OpenGymStepState& state);
+    bool ExchangeState(const OpenGymStepState& state);
+    void NotifyCurrentStateFlat();
+    void NotifyAgent(Ptr<OpenGymEnv> entity);
+    void NotifyAgents();
+    void ApplyObservationFieldMask(const ns3_ai_gym::FieldMask& mask);
+    void EndEpisode();
+    void ExecuteFlatAction();
     //    static void Delete();
 
     bool m_simEnd;
     bool m_stopEnvRequested;
     bool m_initSimMsgSent;
+    bool m_runningEpisodes; ///< whether RunEpisodes runs the episodes in this process
+    bool m_episodeSetup;    ///< whether the scenario of the next episode is being built
+    bool m_episodeReset;    ///< whether Python reset the environment during the episode
+    uint32_t m_maxVersion; ///< highest protocol version offered to Python
+    uint32_t m_version;    ///< protocol version chosen by Python
+    bool m_offerFlat;      ///< whether the flat layout is offered to Python
+    bool m_useFlat;        ///< whether the flat layout is accepted by Python
+    OpenGymFlatLayout m_flatObs;
+    OpenGymFlatLayout m_flatAct;
+    uint32_t m_bufferSize;      ///< size of the message buffers, proposed and then in use
+    uint32_t m_inlineThreshold; ///< size of Box data above which it is carried out of band
+    bool m_usePayload;          ///< whether Python accepts the buffers and out-of-band data
+    uint8_t* m_stateBuffer;
+    uint8_t* m_actBuffer;
+    uint32_t m_keyframeInterval; ///< states between keyframes of delta encoding, 0 to disable
+    uint32_t m_actionRepeat;     ///< steps between decisions, proposed and then in use
+    double m_decisionTolerance;  ///< change of the observation calling for a decision
+    uint32_t m_observationStack; ///< number of observations stacked into one
+    std::vector<std::string> m_obsFieldNames; ///< lazy observation fields of the environments
+    std::vector<std::string> m_obsFieldMask;  ///< requested observation fields, empty for all
+    bool m_profile; ///< whether the time spent in the phases of the exchanges is measured
+    OpenGymProfiler m_profiler;
+    std::string m_trajectoryPath;   ///< directory of the trajectory, empty to disable
+    uint32_t m_trajectoryChunkRows; ///< rows of the trajectory written at once
+    uint32_t m_actionCacheSize;     ///< actions cached by observation, 0 to disable
+    bool m_steadyState; ///< whether the action container is updated in place
+    OpenGymStepPipeline m_pipeline;
+    OpenGymStepState m_stepState;       ///< reused across steps, as the messages of the pipeline
+    ns3_ai_gym::DataV2 m_flatDataPbMsg; ///< for environments without flat callbacks
+    OpenGymEnv* m_boundEnv; ///< environment the callbacks were bound to by Notify
+
+    // multi-agent mode
+    std::map<uint32_t, Ptr<OpenGymEnv>> m_agents;
+    std::vector<uint32_t> m_notifiedAgents; ///< agents notified since the last message
+    EventId m_notifyAgentsEvent;
+    ns3_ai_gym::EnvStateBatchMsg m_stateBatchMsg;
+    ns3_ai_gym::EnvActBatchMsg m_actBatchMsg;
+
+    std::string m_agentModule;   ///< module of the embedded agent, empty to use shared memory
+    std::string m_agentPath;     ///< directory added to Python's path for the embedded agent
+    Ptr<OpenGymPolicy> m_policy; ///< acting instead of Python, null if none
+    bool m_usePython;            ///< whether Python completed the handshake
 
     Callback<Ptr<OpenGymSpace>> m_actionSpaceCb;
     Callback<Ptr<OpenGymSpace>> m_observationSpaceCb;
@@ -88,6 +225,8 @@ class OpenGymInterface : public Object
     Callback<float> m_rewardCb;
     Callback<std::string> m_extraInfoCb;
     Callback<bool, Ptr<OpenGymDataContainer>> m_actionCb;
+    Callback<bool, const OpenGymFlatLayout&> m_obsFlatCb;
+    Callback<bool, const OpenGymFlatLayout&> m_actionFlatCb;
 };
 
 } // end of namespace ns3
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "observation-builder.h"
+
+#include <ns3/log.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymObservationBuilder");
+
+OpenGymObservationBuilder::OpenGymObservationBuilder()
+    : m_alpha(0)
+{
+}
+
+void
+OpenGymObservationBuilder::SetEwmaAlpha(double alpha)
+{
+    NS_LOG_FUNCTION(this << alpha);
+    m_alpha = alpha;
+}
+
+uint32_t
+OpenGymObservationBuilder::GetSize() const
+{
+    return m_features.size();
+}
+
+const std::vector<std::string>&
+OpenGymObservationBuilder::GetNames() const
+{
+    return m_names;
+}
+
+void
+OpenGymObservationBuilder::Reset()
+{
+    for (auto& reducer : m_reducers)
+    {
+        reducer.Reset();
+    }
+}
+
+Config::MatchContainer
+OpenGymObservationBuilder::Resolve(const std::string& path, std::string* name)
+{
+    std::string::size_type pos = path.rfind('/');
+    NS_ABORT_MSG_IF(pos == std::string::npos || pos + 1 == path.size(),
+                    "The path " << path << " does not end with a name");
+    *name = path.substr(pos + 1);
+    Config::MatchContainer matches = Config::LookupMatches(path.substr(0, pos));
+    NS_ABORT_MSG_IF(matches.GetN() == 0, "No object matches " << path);
+    NS_LOG_DEBUG(path << " matches " << matches.GetN() << " objects");
+    return matches;
+}
+
+OpenGymStreamStats*
+OpenGymObservationBuilder::AddReducer(
+    const std::string& path,
+    std::initializer_list<OpenGymStreamStats::Statistic> statistics)
+{
+    NS_ABORT_MSG_IF(statistics.size() == 0, "No statistic of " << path);
+    m_reducers.emplace_back();
+    OpenGymStreamStats& reducer = m_reducers.back();
+    reducer.SetEwmaAlpha(m_alpha);
+    for (auto statistic : statistics)
+    {
+        NS_ABORT_MSG_IF(statistic == OpenGymStreamStats::EWMA && m_alpha <= 0,
+                        "The EWMA of " << path << " needs SetEwmaAlpha");
+        m_features.push_back({false, static_cast<uint32_t>(m_reducers.size() - 1), statistic});
+        m_names.push_back(path + ":" + GetStatisticName(statistic));
+    }
+    return &reducer;
+}
+
+std::string
+OpenGymObservationBuilder::GetStatisticName(OpenGymStreamStats::Statistic statistic)
+{
+    switch (statistic)
+    {
+    case OpenGymStreamStats::COUNT:
+        return "count";
+    case OpenGymStreamStats::SUM:
+        return "sum";
+    case OpenGymStreamStats::MEAN:
+        return "mean";
+    case OpenGymStreamStats::MIN:
+        return "min";
+    case OpenGymStreamStats::MAX:
+        return "max";
+    case OpenGymStreamStats::VARIANCE:
+        return "variance";
+    case OpenGymStreamStats::STDDEV:
+        return "stddev";
+    case OpenGymStreamStats::EWMA:
+        return "ewma";
+    case OpenGymStreamStats::LAST:
+        return "last";
+    }
+    return "";
+}
+
+double
+OpenGymObservationBuilder::GetValue(const Feature& feature) const
+{
+    if (feature.attribute)
+    {
+        const AttributeSource& source = m_attributes[feature.source];
+        return source.read(source);
+    }
+    return m_reducers[feature.source].Get(feature.statistic);
+}
+
+} // namespace ns3
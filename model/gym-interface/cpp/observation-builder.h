@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_OBSERVATION_BUILDER_H
+#define OPENGYM_OBSERVATION_BUILDER_H
+
+#include "aggregators.h"
+#include "container.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/attribute.h>
+#include <ns3/config.h>
+#include <ns3/type-name.h>
+
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Box observation assembled from trace sources and attributes.
+ *
+ * Every feature is declared once with the Config path of a trace source or
+ * an attribute. The path is resolved when the feature is added: the trace
+ * sources matched are connected to a reducer, and the accessors of the
+ * attributes matched are kept with their objects, so that a step reads them
+ * without any lookup. The objects must exist by then, e.g. the sockets of an
+ * application which already started.
+ *
+ * The observation is a 1-D Box with the features in the order they were
+ * added, written by GetObservation into a container kept across steps, or by
+ * Extract into a buffer, e.g. the flat layout. Both start a new window of the
+ * reducers.
+ */
+class OpenGymObservationBuilder
+{
+  public:
+    OpenGymObservationBuilder();
+
+    /**
+     * Add statistics of the new values of a TracedValue<T>, e.g. LAST for
+     * the last value traced, which is kept across the windows. The sources
+     * of all the objects matched are reduced together. A TracedValue is
+     * traced when it changes, and is not readable through its trace source,
+     * so LAST is 0 until the value first changes after the source is
+     * connected; the current value of an attribute is read with
+     * AddAttribute.
+     */
+    template <typename T>
+    void AddTracedValue(const std::string& path,
+                        std::initializer_list<OpenGymStreamStats::Statistic> statistics);
+
+    /**
+     * Add statistics of the samples of a TracedCallback<T>
+     */
+    template <typename T>
+    void AddTraceSample(const std::string& path,
+                        std::initializer_list<OpenGymStreamStats::Statistic> statistics);
+
+    /**
+     * Add the value of an attribute, read at every step, for every object
+     * matched. V is the type of the value, e.g. UintegerValue or TimeValue.
+     */
+    template <typename V>
+    void AddAttribute(const std::string& path);
+
+    /**
+     * Set the weight of a new sample in the EWMA of the following traces
+     */
+    void SetEwmaAlpha(double alpha);
+
+    uint32_t GetSize() const;
+
+    /**
+     * Names of the features, from their paths
+     */
+    const std::vector<std::string>& GetNames() const;
+
+    /**
+     * Box space of the observation, of elements T
+     */
+    template <typename T = float>
+    Ptr<OpenGymBoxSpace> GetSpace(double low, double high) const;
+
+    /**
+     * Write the features into a container reused across steps, and start a
+     * new window
+     */
+    template <typename T = float>
+    Ptr<OpenGymBoxContainer<T>> GetObservation();
+
+    /**
+     * Write the features into GetSize() elements, and start a new window
+     */
+    template <typename T>
+    void Extract(T* out);
+
+    /**
+     * Start a new window without reading the features, e.g. after a reset
+     */
+    void Reset();
+
+  private:
+    /// attribute of an object, with the accessor resolved
+    struct AttributeSource
+    {
+        Ptr<Object> object;
+        Ptr<const AttributeAccessor> accessor;
+        Ptr<AttributeValue> value;
+        double (*read)(const AttributeSource& source);
+    };
+
+    /// element of the observation
+    struct Feature
+    {
+        bool attribute;
+        uint32_t source;
+        OpenGymStreamStats::Statistic statistic;
+    };
+
+    template <typename V>
+    static double ReadAttribute(const AttributeSource& source);
+
+    /**
+     * Objects matched by the path without its last segment, which is the
+     * name of the trace source or attribute
+     */
+    static Config::MatchContainer Resolve(const std::string& path, std::string* name);
+
+    OpenGymStreamStats* AddReducer(const std::string& path,
+                                   std::initializer_list<OpenGymStreamStats::Statistic> statistics);
+    static std::string GetStatisticName(OpenGymStreamStats::Statistic statistic);
+
+    double GetValue(const Feature& feature) const;
+
+    double m_alpha;
+    std::deque<OpenGymStreamStats> m_reducers; ///< stable, bound to the traces
+    std::vector<AttributeSource> m_attributes;
+    std::vector<Feature> m_features;
+    std::vector<std::string> m_names;
+    Ptr<OpenGymDataContainer> m_observation; ///< reused across steps
+};
+
+template <typename T>
+void
+OpenGymObservationBuilder::AddTracedValue(
+    const std::string& path,
+    std::initializer_list<OpenGymStreamStats::Statistic> statistics)
+{
+    std::string name;
+    Config::MatchContainer matches = Resolve(path, &name);
+    OpenGymStreamStats* reducer = AddReducer(path, statistics);
+    for (uint32_t i = 0; i < matches.GetN(); ++i)
+    {
+        NS_ABORT_MSG_UNLESS(reducer->ConnectValue<T>(matches.Get(i), name),
+                            "No trace source " << name << " in " << matches.GetMatchedPath(i));
+    }
+}
+
+template <typename T>
+void
+OpenGymObservationBuilder::AddTraceSample(
+    const std::string& path,
+    std::initializer_list<OpenGymStreamStats::Statistic> statistics)
+{
+    std::string name;
+    Config::MatchContainer matches = Resolve(path, &name);
+    OpenGymStreamStats* reducer = AddReducer(path, statistics);
+    for (uint32_t i = 0; i < matches.GetN(); ++i)
+    {
+        NS_ABORT_MSG_UNLESS(reducer->ConnectSample<T>(matches.Get(i), name),
+                            "No trace source " << name << " in " << matches.GetMatchedPath(i));
+    }
+}
+
+template <typename V>
+void
+OpenGymObservationBuilder::AddAttribute(const std::string& path)
+{
+    std::string name;
+    Config::MatchContainer matches = Resolve(path, &name);
+    for (uint32_t i = 0; i < matches.GetN(); ++i)
+    {
+        Ptr<Object> object = matches.Get(i);
+        TypeId::AttributeInformation info;
+        NS_ABORT_MSG_UNLESS(object->GetInstanceTypeId().LookupAttributeByName(name, &info) &&
+                                info.accessor->HasGetter(),
+                            "No readable attribute " << name << " in "
+                                                     << matches.GetMatchedPath(i));
+        m_attributes.push_back({object, info.accessor, Create<V>(), &ReadAttribute<V>});
+        m_features.push_back({true,
+                              static_cast<uint32_t>(m_attributes.size() - 1),
+                              OpenGymStreamStats::LAST});
+        m_names.push_back(matches.GetMatchedPath(i) + "/" + name);
+    }
+}
+
+template <typename V>
+double
+OpenGymObservationBuilder::ReadAttribute(const AttributeSource& source)
+{
+    V& value = static_cast<V&>(*source.value);
+    source.accessor->Get(PeekPointer(source.object), value);
+    return OpenGymSampleValue(value.Get());
+}
+
+template <typename T>
+Ptr<OpenGymBoxSpace>
+OpenGymObservationBuilder::GetSpace(double low, double high) const
+{
+    std::vector<uint32_t> shape = {GetSize()};
+    return CreateObject<OpenGymBoxSpace>(low, high, shape, TypeNameGet<T>());
+}
+
+template <typename T>
+Ptr<OpenGymBoxContainer<T>>
+OpenGymObservationBuilder::GetObservation()
+{
+    Ptr<OpenGymBoxContainer<T>> box = DynamicCast<OpenGymBoxContainer<T>>(m_observation);
+    if (!box)
+    {
+        box = CreateObject<OpenGymBoxContainer<T>>(std::vector<uint32_t>{GetSize()});
+        m_observation = box;
+    }
+    // the elements are added once, then overwritten
+    bool filled = box->GetData().size() == m_features.size();
+    for (uint32_t i = 0; i < m_features.size(); ++i)
+    {
+        T value = static_cast<T>(GetValue(m_features[i]));
+        if (filled)
+        {
+            box->SetValue(i, value);
+        }
+        else
+        {
+            box->AddValue(value);
+        }
+    }
+    Reset();
+    return box;
+}
+
+template <typename T>
+void
+OpenGymObservationBuilder::Extract(T* out)
+{
+    for (uint32_t i = 0; i < m_features.size(); ++i)
+    {
+        out[i] = static_cast<T>(GetValue(m_features[i]));
+    }
+    Reset();
+}
+
+} // namespace ns3
+
+#endif // OPENGYM_OBSERVATION_BUILDER_H
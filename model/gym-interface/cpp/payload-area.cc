@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "payload-area.h"
+
+#include "../ns3-ai-gym-msg.h"
+
+#include <ns3/abort.h>
+#include <ns3/ai-module.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymPayloadArea");
+
+OpenGymPayloadArea::OpenGymPayloadArea()
+    : m_buffer(nullptr),
+      m_capacity(0),
+      m_size(0),
+      m_threshold(UINT32_MAX)
+{
+}
+
+void
+OpenGymPayloadArea::SetThreshold(uint32_t threshold)
+{
+    m_threshold = threshold;
+}
+
+uint32_t
+OpenGymPayloadArea::GetThreshold() const
+{
+    return m_threshold;
+}
+
+void
+OpenGymPayloadArea::Reset()
+{
+    m_size = 0;
+    if (!m_retired.empty())
+    {
+        auto msgInterface = Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+        for (uint8_t* buffer : m_retired)
+        {
+            msgInterface->DeallocatePayload(buffer);
+        }
+        m_retired.clear();
+    }
+}
+
+bool
+OpenGymPayloadArea::Write(const void* data, uint32_t size, ns3_ai_gym::PayloadRef* ref)
+{
+    if (size <= m_threshold)
+    {
+        return false;
+    }
+
+    auto msgInterface = Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+    // payloads are aligned to 8 bytes, so that any element type can be viewed in place
+    uint32_t offset = (m_size + 7) / 8 * 8;
+    if (offset + size > m_capacity)
+    {
+        // earlier payloads of this message stay in the old buffer until Reset
+        uint32_t capacity = std::max(m_capacity * 2, size);
+        NS_LOG_DEBUG("Growing payload area to " << capacity << " bytes");
+        auto buffer = static_cast<uint8_t*>(msgInterface->AllocatePayload(capacity));
+        NS_ABORT_MSG_IF(!buffer,
+                        "Cannot allocate " << capacity << " bytes of payload in shared memory, "
+                                           << "increase the segment size (shmSize of Ns3Env)");
+        if (m_buffer)
+        {
+            m_retired.push_back(m_buffer);
+        }
+        m_buffer = buffer;
+        m_capacity = capacity;
+        offset = 0;
+    }
+    std::memcpy(m_buffer + offset, data, size);
+    m_size = offset + size;
+    ref->set_handle(msgInterface->GetPayloadHandle(m_buffer + offset));
+    ref->set_size(size);
+    return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_PAYLOAD_AREA_H
+#define OPENGYM_PAYLOAD_AREA_H
+
+#include "messages.pb.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Area in the shared memory segment for Box data carried out of band.
+ *
+ * Data larger than the threshold is written to the area and only described
+ * in the message. The area grows as needed; once it has grown to the size of
+ * a state, writing allocates nothing.
+ */
+class OpenGymPayloadArea
+{
+  public:
+    OpenGymPayloadArea();
+
+    /**
+     * Set the size in bytes above which data is carried out of band
+     */
+    void SetThreshold(uint32_t threshold);
+    uint32_t GetThreshold() const;
+
+    /**
+     * Start a new message, whose payloads overwrite those of the previous one
+     */
+    void Reset();
+
+    /**
+     * Write data out of band if it is larger than the threshold, and describe
+     * it in ref. Returns false if the data is to be kept inline.
+     */
+    bool Write(const void* data, uint32_t size, ns3_ai_gym::PayloadRef* ref);
+
+  private:
+    uint8_t* m_buffer;
+    uint32_t m_capacity;
+    uint32_t m_size;
+    uint32_t m_threshold;
+    std::vector<uint8_t*> m_retired; ///< outgrown buffers still referred to by the message
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_PAYLOAD_AREA_H
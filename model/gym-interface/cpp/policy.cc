@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "policy.h"
+
+#include "container.h"
+#include "spaces.h"
+
+#include <ns3/log.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymPolicy");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymPolicy);
+NS_OBJECT_ENSURE_REGISTERED(OpenGymCallbackPolicy);
+
+OpenGymPolicy::OpenGymPolicy()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymPolicy::~OpenGymPolicy()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+TypeId
+OpenGymPolicy::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymPolicy").SetParent<Object>().SetGroupName("OpenGym");
+    return tid;
+}
+
+void
+OpenGymPolicy::SetSpaces(Ptr<OpenGymSpace> obsSpace, Ptr<OpenGymSpace> actionSpace)
+{
+    NS_LOG_FUNCTION(this << obsSpace << actionSpace);
+    m_obsSpace = obsSpace;
+    m_actionSpace = actionSpace;
+}
+
+Ptr<OpenGymSpace>
+OpenGymPolicy::GetObservationSpace() const
+{
+    return m_obsSpace;
+}
+
+Ptr<OpenGymSpace>
+OpenGymPolicy::GetActionSpace() const
+{
+    return m_actionSpace;
+}
+
+void
+OpenGymPolicy::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_obsSpace = nullptr;
+    m_actionSpace = nullptr;
+}
+
+OpenGymCallbackPolicy::OpenGymCallbackPolicy(
+    Callback<Ptr<OpenGymDataContainer>, Ptr<OpenGymDataContainer>> cb)
+    : m_cb(cb)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymCallbackPolicy::~OpenGymCallbackPolicy()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+TypeId
+OpenGymCallbackPolicy::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymCallbackPolicy")
+                            .SetParent<OpenGymPolicy>()
+                            .SetGroupName("OpenGym");
+    return tid;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymCallbackPolicy::GetAction(Ptr<OpenGymDataContainer> obs,
+                                 float reward,
+                                 bool done,
+                                 const std::string& info)
+{
+    return m_cb(obs);
+}
+
+} // namespace ns3
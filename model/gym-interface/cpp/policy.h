@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_POLICY_H
+#define OPENGYM_POLICY_H
+
+#include <ns3/callback.h>
+#include <ns3/object.h>
+#include <ns3/ptr.h>
+
+#include <string>
+
+namespace ns3
+{
+
+class OpenGymSpace;
+class OpenGymDataContainer;
+
+/**
+ * \brief A policy acting in the simulation process, instead of an agent in
+ * Python.
+ *
+ * OpenGymInterface gives it the states of the environment, as the
+ * containers returned by GetObservation, and executes the actions it
+ * returns, without any message. Subclasses implement GetAction, e.g. with a
+ * libtorch module.
+ */
+class OpenGymPolicy : public Object
+{
+  public:
+    OpenGymPolicy();
+    ~OpenGymPolicy() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * Called with the spaces of the environment before the first action
+     */
+    virtual void SetSpaces(Ptr<OpenGymSpace> obsSpace, Ptr<OpenGymSpace> actionSpace);
+
+    /**
+     * Get the action of a state. The observation is only valid during the
+     * call, and the action, which may be kept and returned again, is executed
+     * before the next state. Not called with the final state.
+     */
+    virtual Ptr<OpenGymDataContainer> GetAction(Ptr<OpenGymDataContainer> obs,
+                                                float reward,
+                                                bool done,
+                                                const std::string& info) = 0;
+
+    Ptr<OpenGymSpace> GetObservationSpace() const;
+    Ptr<OpenGymSpace> GetActionSpace() const;
+
+  protected:
+    // Inherited
+    void DoDispose() override;
+
+  private:
+    Ptr<OpenGymSpace> m_obsSpace;
+    Ptr<OpenGymSpace> m_actionSpace;
+};
+
+/**
+ * \brief Policy calling a function of the observation
+ */
+class OpenGymCallbackPolicy : public OpenGymPolicy
+{
+  public:
+    OpenGymCallbackPolicy(Callback<Ptr<OpenGymDataContainer>, Ptr<OpenGymDataContainer>> cb);
+    ~OpenGymCallbackPolicy() override;
+
+    static TypeId GetTypeId();
+
+    Ptr<OpenGymDataContainer> GetAction(Ptr<OpenGymDataContainer> obs,
+                                        float reward,
+                                        bool done,
+                                        const std::string& info) override;
+
+  private:
+    Callback<Ptr<OpenGymDataContainer>, Ptr<OpenGymDataContainer>> m_cb;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_POLICY_H
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "profiler.h"
+
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymProfiler");
+
+OpenGymProfiler::Scope::Scope(OpenGymProfiler& profiler, Phase phase)
+    : m_profiler(profiler.m_enabled ? &profiler : nullptr),
+      m_phase(phase)
+{
+    if (m_profiler)
+    {
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+OpenGymProfiler::Scope::~Scope()
+{
+    Stop();
+}
+
+void
+OpenGymProfiler::Scope::Stop()
+{
+    if (m_profiler)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        m_profiler->Add(m_phase,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        m_profiler = nullptr;
+    }
+}
+
+OpenGymProfiler::OpenGymProfiler()
+    : m_enabled(false)
+{
+}
+
+void
+OpenGymProfiler::SetEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool
+OpenGymProfiler::IsEnabled() const
+{
+    return m_enabled;
+}
+
+void
+OpenGymProfiler::Add(Phase phase, uint64_t ns)
+{
+    PhaseStats& stats = m_phases[phase];
+    stats.min = stats.count ? std::min(stats.min, ns) : ns;
+    stats.max = std::max(stats.max, ns);
+    stats.count++;
+    stats.total += ns;
+    uint32_t bucket = 0;
+    while (ns >>= 1)
+    {
+        bucket++;
+    }
+    stats.histogram[std::min(bucket, HISTOGRAM_SIZE - 1)]++;
+}
+
+void
+OpenGymProfiler::Reset()
+{
+    m_phases.fill(PhaseStats());
+}
+
+const char*
+OpenGymProfiler::GetPhaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case INIT_SPACES:
+        return "InitSpaces";
+    case INIT_HANDSHAKE:
+        return "InitHandshake";
+    case OBSERVATION:
+        return "Observation";
+    case REWARD:
+        return "Reward";
+    case SERIALIZE:
+        return "Serialize";
+    case WAIT:
+        return "Wait";
+    case PARSE:
+        return "Parse";
+    case DECODE:
+        return "Decode";
+    case EXECUTE:
+        return "Execute";
+    default:
+        return "";
+    }
+}
+
+uint64_t
+OpenGymProfiler::GetCount(Phase phase) const
+{
+    return m_phases[phase].count;
+}
+
+uint64_t
+OpenGymProfiler::GetTotal(Phase phase) const
+{
+    return m_phases[phase].total;
+}
+
+uint64_t
+OpenGymProfiler::GetMin(Phase phase) const
+{
+    return m_phases[phase].min;
+}
+
+uint64_t
+OpenGymProfiler::GetMax(Phase phase) const
+{
+    return m_phases[phase].max;
+}
+
+const std::array<uint64_t, OpenGymProfiler::HISTOGRAM_SIZE>&
+OpenGymProfiler::GetHistogram(Phase phase) const
+{
+    return m_phases[phase].histogram;
+}
+
+void
+OpenGymProfiler::FillStatsPbMsg(ns3_ai_gym::ProfileStats* stats) const
+{
+    stats->clear_phases();
+    for (uint32_t i = 0; i < PHASE_COUNT; i++)
+    {
+        const PhaseStats& phase = m_phases[i];
+        ns3_ai_gym::PhaseStats* phasePbMsg = stats->add_phases();
+        phasePbMsg->set_name(GetPhaseName(static_cast<Phase>(i)));
+        phasePbMsg->set_count(phase.count);
+        phasePbMsg->set_totalns(phase.total);
+        phasePbMsg->set_minns(phase.min);
+        phasePbMsg->set_maxns(phase.max);
+        // trailing empty buckets are not sent
+        uint32_t size = HISTOGRAM_SIZE;
+        while (size > 0 && phase.histogram[size - 1] == 0)
+        {
+            size--;
+        }
+        phasePbMsg->mutable_histogram()->Add(phase.histogram.begin(),
+                                             phase.histogram.begin() + size);
+    }
+}
+
+void
+OpenGymProfiler::Print(std::ostream& os) const
+{
+    os << std::left << std::setw(16) << "Phase" << std::right << std::setw(12) << "Count"
+       << std::setw(16) << "Total (us)" << std::setw(12) << "Mean (us)" << std::setw(12)
+       << "Min (us)" << std::setw(12) << "Max (us)" << std::endl;
+    os << std::fixed << std::setprecision(3);
+    for (uint32_t i = 0; i < PHASE_COUNT; i++)
+    {
+        const PhaseStats& phase = m_phases[i];
+        if (!phase.count)
+        {
+            continue;
+        }
+        os << std::left << std::setw(16) << GetPhaseName(static_cast<Phase>(i)) << std::right
+           << std::setw(12) << phase.count << std::setw(16) << phase.total / 1e3 << std::setw(12)
+           << phase.total / 1e3 / phase.count << std::setw(12) << phase.min / 1e3
+           << std::setw(12) << phase.max / 1e3 << std::endl;
+    }
+    os << std::defaultfloat;
+}
+
+} // namespace ns3
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_PROFILER_H
+#define OPENGYM_PROFILER_H
+
+#include "messages.pb.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace ns3
+{
+
+/**
+ * \brief Cumulative time spent in the phases of the exchanges with Python.
+ *
+ * Every phase has a count, a total, extremes and a histogram of durations,
+ * whose bucket i counts those in [2^i, 2^(i+1)) ns, the last one being open.
+ * When disabled, a phase costs a branch.
+ */
+class OpenGymProfiler
+{
+  public:
+    enum Phase : uint8_t
+    {
+        INIT_SPACES,    ///< spaces described in Init
+        INIT_HANDSHAKE, ///< init message sent and its ack received
+        OBSERVATION,    ///< GetObservation, or its flat version
+        REWARD,         ///< GetReward, IsGameOver and GetExtraInfo
+        SERIALIZE,      ///< state message filled and serialized into the buffer
+        WAIT,           ///< waiting for the action of Python, or of the embedded agent
+        PARSE,          ///< action message parsed
+        DECODE,         ///< action data container created from the message
+        EXECUTE,        ///< ExecuteActions, or its flat version
+        PHASE_COUNT,
+    };
+
+    static constexpr uint32_t HISTOGRAM_SIZE = 40;
+
+    /// Accounts the time until its destruction to a phase
+    class Scope
+    {
+      public:
+        Scope(OpenGymProfiler& profiler, Phase phase);
+        ~Scope();
+
+        /**
+         * End the phase before the destruction
+         */
+        void Stop();
+
+      private:
+        OpenGymProfiler* m_profiler; ///< nullptr if disabled
+        Phase m_phase;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    OpenGymProfiler();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    /**
+     * Account a duration to a phase
+     */
+    void Add(Phase phase, uint64_t ns);
+
+    /**
+     * Forget the durations accounted so far
+     */
+    void Reset();
+
+    static const char* GetPhaseName(Phase phase);
+    uint64_t GetCount(Phase phase) const;
+    uint64_t GetTotal(Phase phase) const; ///< in ns
+    uint64_t GetMin(Phase phase) const;   ///< in ns, 0 if none
+    uint64_t GetMax(Phase phase) const;   ///< in ns
+    const std::array<uint64_t, HISTOGRAM_SIZE>& GetHistogram(Phase phase) const;
+
+    /**
+     * Fill the message sent to Python with the phases accounted so far
+     */
+    void FillStatsPbMsg(ns3_ai_gym::ProfileStats* stats) const;
+
+    /**
+     * Print a table of the phases accounted so far
+     */
+    void Print(std::ostream& os) const;
+
+  private:
+    struct PhaseStats
+    {
+        uint64_t count{0};
+        uint64_t total{0};
+        uint64_t min{0};
+        uint64_t max{0};
+        std::array<uint64_t, HISTOGRAM_SIZE> histogram{};
+    };
+
+    bool m_enabled;
+    std::array<PhaseStats, PHASE_COUNT> m_phases;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_PROFILER_H
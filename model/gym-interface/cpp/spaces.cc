@@ -30,6 +30,49 @@ namespace ns3
 NS_LOG_COMPONENT_DEFINE("OpenGymSpace");
 NS_OBJECT_ENSURE_REGISTERED(OpenGymSpace);
 
+ns3_ai_gym::DataType
+OpenGymGetDataType(const std::string& typeName)
+{
+    static const std::map<std::string, ns3_ai_gym::DataType> dataTypes = {
+        {"int8_t", ns3_ai_gym::INT8},
+        {"int16_t", ns3_ai_gym::INT16},
+        {"int32_t", ns3_ai_gym::INT32},
+        {"int64_t", ns3_ai_gym::INT64},
+        {"uint8_t", ns3_ai_gym::UINT8},
+        {"uint16_t", ns3_ai_gym::UINT16},
+        {"uint32_t", ns3_ai_gym::UINT32},
+        {"uint64_t", ns3_ai_gym::UINT64},
+        {"float", ns3_ai_gym::FLOAT32},
+        {"double", ns3_ai_gym::FLOAT64},
+        {"bool", ns3_ai_gym::BOOL},
+    };
+    auto it = dataTypes.find(typeName);
+    // unknown types are sent as float, as in protocol v1
+    return it != dataTypes.end() ? it->second : ns3_ai_gym::FLOAT32;
+}
+
+uint32_t
+OpenGymGetDataTypeSize(ns3_ai_gym::DataType dataType)
+{
+    switch (dataType)
+    {
+    case ns3_ai_gym::INT8:
+    case ns3_ai_gym::UINT8:
+    case ns3_ai_gym::BOOL:
+        return 1;
+    case ns3_ai_gym::INT16:
+    case ns3_ai_gym::UINT16:
+    case ns3_ai_gym::FLOAT16:
+        return 2;
+    case ns3_ai_gym::INT64:
+    case ns3_ai_gym::UINT64:
+    case ns3_ai_gym::FLOAT64:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
 TypeId
 OpenGymSpace::GetTypeId()
 {
@@ -116,6 +159,15 @@ OpenGymDiscreteSpace::GetSpaceDescription()
     return desc;
 }
 
+ns3_ai_gym::SpaceV2
+OpenGymDiscreteSpace::GetSpaceDescriptionV2()
+{
+    NS_LOG_FUNCTION(this);
+    ns3_ai_gym::SpaceV2 desc;
+    desc.mutable_discrete()->set_n(GetN());
+    return desc;
+}
+
 void
 OpenGymDiscreteSpace::Print(std::ostream& where) const
 {
@@ -137,8 +189,8 @@ OpenGymBoxSpace::OpenGymBoxSpace()
     NS_LOG_FUNCTION(this);
 }
 
-OpenGymBoxSpace::OpenGymBoxSpace(float low,
-                                 float high,
+OpenGymBoxSpace::OpenGymBoxSpace(double low,
+                                 double high,
                                  std::vector<uint32_t> shape,
                                  std::string dtype)
     : m_low(low),
@@ -154,6 +206,22 @@ OpenGymBoxSpace::OpenGymBoxSpace(std::vector<float> low,
                                  std::vector<float> high,
                                  std::vector<uint32_t> shape,
                                  std::string dtype)
+    : m_low(0),
+      m_high(0),
+      m_shape(shape),
+      m_dtypeName(dtype),
+      m_lowVec(low.begin(), low.end()),
+      m_highVec(high.begin(), high.end())
+
+{
+    NS_LOG_FUNCTION(this);
+    SetDtype();
+}
+
+OpenGymBoxSpace::OpenGymBoxSpace(std::vector<double> low,
+                                 std::vector<double> high,
+                                 std::vector<uint32_t> shape,
+                                 std::string dtype)
     : m_low(0),
       m_high(0),
       m_shape(shape),
@@ -207,16 +275,17 @@ OpenGymBoxSpace::SetDtype()
     {
         m_dtype = ns3_ai_gym::FLOAT;
     }
+    m_dataType = OpenGymGetDataType(name);
 }
 
-float
+double
 OpenGymBoxSpace::GetLow()
 {
     NS_LOG_FUNCTION(this);
     return m_low;
 }
 
-float
+double
 OpenGymBoxSpace::GetHigh()
 {
     NS_LOG_FUNCTION(this);
@@ -238,8 +307,9 @@ OpenGymBoxSpace::GetSpaceDescription()
     desc.set_type(ns3_ai_gym::Box);
 
     ns3_ai_gym::BoxSpace boxSpacePb;
-    boxSpacePb.set_low(GetLow());
-    boxSpacePb.set_high(GetHigh());
+    // protocol v1 sends the bounds as float
+    boxSpacePb.set_low(static_cast<float>(GetLow()));
+    boxSpacePb.set_high(static_cast<float>(GetHigh()));
 
     std::vector<uint32_t> shape = GetShape();
     for (auto i = shape.begin(); i != shape.end(); ++i)
@@ -252,6 +322,28 @@ OpenGymBoxSpace::GetSpaceDescription()
     return desc;
 }
 
+ns3_ai_gym::SpaceV2
+OpenGymBoxSpace::GetSpaceDescriptionV2()
+{
+    NS_LOG_FUNCTION(this);
+    ns3_ai_gym::SpaceV2 desc;
+    ns3_ai_gym::BoxSpaceV2* boxSpacePb = desc.mutable_box();
+
+    if (m_lowVec.empty())
+    {
+        boxSpacePb->add_low(m_low);
+        boxSpacePb->add_high(m_high);
+    }
+    else
+    {
+        boxSpacePb->mutable_low()->Add(m_lowVec.begin(), m_lowVec.end());
+        boxSpacePb->mutable_high()->Add(m_highVec.begin(), m_highVec.end());
+    }
+    boxSpacePb->mutable_shape()->Add(m_shape.begin(), m_shape.end());
+    boxSpacePb->set_dtype(m_dataType);
+    return desc;
+}
+
 void
 OpenGymBoxSpace::Print(std::ostream& where) const
 {
@@ -264,6 +356,69 @@ OpenGymBoxSpace::Print(std::ostream& where) const
     where << ") Dtype: " << m_dtypeName;
 }
 
+TypeId
+OpenGymSparseBoxSpace::GetTypeId()
+{
+    static TypeId tid = TypeId("OpenGymSparseBoxSpace")
+                            .SetParent<OpenGymBoxSpace>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymSparseBoxSpace>();
+    return tid;
+}
+
+OpenGymSparseBoxSpace::OpenGymSparseBoxSpace()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymSparseBoxSpace::OpenGymSparseBoxSpace(double low,
+                                             double high,
+                                             std::vector<uint32_t> shape,
+                                             std::string dtype)
+    : OpenGymBoxSpace(low, high, shape, dtype)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymSparseBoxSpace::OpenGymSparseBoxSpace(std::vector<float> low,
+                                             std::vector<float> high,
+                                             std::vector<uint32_t> shape,
+                                             std::string dtype)
+    : OpenGymBoxSpace(low, high, shape, dtype)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymSparseBoxSpace::OpenGymSparseBoxSpace(std::vector<double> low,
+                                             std::vector<double> high,
+                                             std::vector<uint32_t> shape,
+                                             std::string dtype)
+    : OpenGymBoxSpace(low, high, shape, dtype)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymSparseBoxSpace::~OpenGymSparseBoxSpace()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+ns3_ai_gym::SpaceV2
+OpenGymSparseBoxSpace::GetSpaceDescriptionV2()
+{
+    NS_LOG_FUNCTION(this);
+    ns3_ai_gym::SpaceV2 desc = OpenGymBoxSpace::GetSpaceDescriptionV2();
+    desc.mutable_box()->set_sparse(true);
+    return desc;
+}
+
+void
+OpenGymSparseBoxSpace::Print(std::ostream& where) const
+{
+    where << " Sparse";
+    OpenGymBoxSpace::Print(where);
+}
+
 TypeId
 OpenGymTupleSpace::GetTypeId()
 {
@@ -338,6 +493,20 @@ OpenGymTupleSpace::GetSpaceDescription()
     return desc;
 }
 
+ns3_ai_gym::SpaceV2
+OpenGymTupleSpace::GetSpaceDescriptionV2()
+{
+    NS_LOG_FUNCTION(this);
+    ns3_ai_gym::SpaceV2 desc;
+    ns3_ai_gym::TupleSpaceV2* tupleSpacePb = desc.mutable_tuple();
+
+    for (auto i = m_tuple.begin(); i != m_tuple.end(); ++i)
+    {
+        *tupleSpacePb->add_element() = (*i)->GetSpaceDescriptionV2();
+    }
+    return desc;
+}
+
 void
 OpenGymTupleSpace::Print(std::ostream& where) const
 {
@@ -430,6 +599,22 @@ OpenGymDictSpace::GetSpaceDescription()
     return desc;
 }
 
+ns3_ai_gym::SpaceV2
+OpenGymDictSpace::GetSpaceDescriptionV2()
+{
+    NS_LOG_FUNCTION(this);
+    ns3_ai_gym::SpaceV2 desc;
+    ns3_ai_gym::DictSpaceV2* dictSpacePb = desc.mutable_dict();
+
+    for (auto it = m_dict.begin(); it != m_dict.end(); ++it)
+    {
+        ns3_ai_gym::SpaceV2* subDesc = dictSpacePb->add_element();
+        *subDesc = it->second->GetSpaceDescriptionV2();
+        subDesc->set_name(it->first);
+    }
+    return desc;
+}
+
 void
 OpenGymDictSpace::Print(std::ostream& where) const
 {
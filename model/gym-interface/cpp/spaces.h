@@ -29,6 +29,16 @@
 namespace ns3
 {
 
+/**
+ * Get the protocol v2 element type of a C++ type, given its name from TypeNameGet
+ */
+ns3_ai_gym::DataType OpenGymGetDataType(const std::string& typeName);
+
+/**
+ * Get the size in bytes of an element of a protocol v2 element type
+ */
+uint32_t OpenGymGetDataTypeSize(ns3_ai_gym::DataType dataType);
+
 class OpenGymSpace : public Object
 {
   public:
@@ -38,6 +48,7 @@ class OpenGymSpace : public Object
     static TypeId GetTypeId();
 
     virtual ns3_ai_gym::SpaceDescription GetSpaceDescription() = 0;
+    virtual ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() = 0;
     virtual void Print(std::ostream& where) const = 0;
 
   protected:
@@ -56,6 +67,7 @@ class OpenGymDiscreteSpace : public OpenGymSpace
     static TypeId GetTypeId();
 
     ns3_ai_gym::SpaceDescription GetSpaceDescription() override;
+    ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() override;
 
     int GetN();
     void Print(std::ostream& where) const override;
@@ -79,19 +91,24 @@ class OpenGymBoxSpace : public OpenGymSpace
 {
   public:
     OpenGymBoxSpace();
-    OpenGymBoxSpace(float low, float high, std::vector<uint32_t> shape, std::string dtype);
+    OpenGymBoxSpace(double low, double high, std::vector<uint32_t> shape, std::string dtype);
     OpenGymBoxSpace(std::vector<float> low,
                     std::vector<float> high,
                     std::vector<uint32_t> shape,
                     std::string dtype);
+    OpenGymBoxSpace(std::vector<double> low,
+                    std::vector<double> high,
+                    std::vector<uint32_t> shape,
+                    std::string dtype);
     ~OpenGymBoxSpace() override;
 
     static TypeId GetTypeId();
 
     ns3_ai_gym::SpaceDescription GetSpaceDescription() override;
+    ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() override;
 
-    float GetLow();
-    float GetHigh();
+    double GetLow();
+    double GetHigh();
     std::vector<uint32_t> GetShape();
 
     void Print(std::ostream& where) const override;
@@ -110,14 +127,41 @@ class OpenGymBoxSpace : public OpenGymSpace
   private:
     void SetDtype();
 
-    float m_low;
-    float m_high;
+    double m_low;
+    double m_high;
     std::vector<uint32_t> m_shape;
     std::string m_dtypeName;
-    std::vector<float> m_lowVec;
-    std::vector<float> m_highVec;
+    std::vector<double> m_lowVec;
+    std::vector<double> m_highVec;
 
     ns3_ai_gym::Dtype m_dtype;
+    ns3_ai_gym::DataType m_dataType;
+};
+
+/**
+ * Box whose data is mostly zero, and sent as its nonzero elements, see
+ * OpenGymSparseBoxContainer. Python gets the observations as sparse arrays.
+ */
+class OpenGymSparseBoxSpace : public OpenGymBoxSpace
+{
+  public:
+    OpenGymSparseBoxSpace();
+    OpenGymSparseBoxSpace(double low, double high, std::vector<uint32_t> shape, std::string dtype);
+    OpenGymSparseBoxSpace(std::vector<float> low,
+                          std::vector<float> high,
+                          std::vector<uint32_t> shape,
+                          std::string dtype);
+    OpenGymSparseBoxSpace(std::vector<double> low,
+                          std::vector<double> high,
+                          std::vector<uint32_t> shape,
+                          std::string dtype);
+    ~OpenGymSparseBoxSpace() override;
+
+    static TypeId GetTypeId();
+
+    ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() override;
+
+    void Print(std::ostream& where) const override;
 };
 
 class OpenGymTupleSpace : public OpenGymSpace
@@ -129,6 +173,7 @@ class OpenGymTupleSpace : public OpenGymSpace
     static TypeId GetTypeId();
 
     ns3_ai_gym::SpaceDescription GetSpaceDescription() override;
+    ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() override;
 
     bool Add(Ptr<OpenGymSpace> space);
     Ptr<OpenGymSpace> Get(uint32_t idx);
@@ -159,6 +204,7 @@ class OpenGymDictSpace : public OpenGymSpace
     static TypeId GetTypeId();
 
     ns3_ai_gym::SpaceDescription GetSpaceDescription() override;
+    ns3_ai_gym::SpaceV2 GetSpaceDescriptionV2() override;
 
     bool Add(std::string key, Ptr<OpenGymSpace> value);
     Ptr<OpenGymSpace> Get(std::string key);
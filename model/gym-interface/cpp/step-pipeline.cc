@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "step-pipeline.h"
+
+#include "container.h"
+#include "profiler.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <google/protobuf/io/coded_stream.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymStepPipeline");
+
+namespace
+{
+
+/**
+ * Reset a v2 action message before the next one is merged into it. Clear()
+ * would free the action data, so Box data keeps its buffers and only has its
+ * element type reset, which Python always sets.
+ */
+void
+PrepareMerge(ns3_ai_gym::EnvActMsg& msg)
+{
+    msg.set_stopsimreq(false);
+    msg.set_resetreq(false);
+    msg.clear_obsfields();
+    ns3_ai_gym::DataV2* data = msg.mutable_actdatav2();
+    if (data->has_box())
+    {
+        ns3_ai_gym::BoxDataV2* box = data->mutable_box();
+        box->set_dtype(ns3_ai_gym::NoDataType);
+        box->mutable_shape()->Clear();
+        box->mutable_data()->clear();
+    }
+    else
+    {
+        // repeated elements would be appended to, and a discrete value frees nothing
+        data->clear_data();
+    }
+}
+
+/**
+ * Whether the message merged after PrepareMerge() carries an action
+ */
+bool
+HasAction(const ns3_ai_gym::EnvActMsg& msg)
+{
+    const ns3_ai_gym::DataV2& data = msg.actdatav2();
+    return data.has_box() ? data.box().dtype() != ns3_ai_gym::NoDataType
+                          : data.data_case() != ns3_ai_gym::DataV2::DATA_NOT_SET;
+}
+
+/**
+ * Copy inline data into the observation of a state message. A dense Box keeps
+ * the buffers of its fields, its encoding is set afterwards.
+ */
+void
+CopyInline(const ns3_ai_gym::DataV2& from, ns3_ai_gym::DataV2* to)
+{
+    if (!from.has_box() || from.box().has_sparse())
+    {
+        to->CopyFrom(from);
+        return;
+    }
+    ns3_ai_gym::BoxDataV2* box = to->mutable_box();
+    box->set_dtype(from.box().dtype());
+    box->mutable_shape()->CopyFrom(from.box().shape());
+    box->mutable_data()->assign(from.box().data());
+}
+
+} // namespace
+
+OpenGymStepPipeline::OpenGymStepPipeline()
+    : m_version(1),
+      m_useDelta(false),
+      m_usePayload(false),
+      m_steadyState(false),
+      m_obsFilled(false),
+      m_inlineFilled(false),
+      m_cacheable(false),
+      m_cacheHit(false),
+      m_deferredReward(0)
+{
+}
+
+void
+OpenGymStepPipeline::SetProtocol(uint32_t version, bool useDelta, bool usePayload)
+{
+    m_version = version;
+    m_useDelta = useDelta && version >= 2;
+    m_usePayload = usePayload && version >= 2;
+}
+
+uint32_t
+OpenGymStepPipeline::GetVersion() const
+{
+    return m_version;
+}
+
+void
+OpenGymStepPipeline::SetSteadyState(bool steadyState)
+{
+    m_steadyState = steadyState;
+}
+
+OpenGymDecimator&
+OpenGymStepPipeline::GetDecimator()
+{
+    return m_decimator;
+}
+
+OpenGymDeltaEncoder&
+OpenGymStepPipeline::GetDeltaEncoder()
+{
+    return m_delta;
+}
+
+OpenGymPayloadArea&
+OpenGymStepPipeline::GetPayloadArea()
+{
+    return m_payload;
+}
+
+OpenGymTrajectoryWriter&
+OpenGymStepPipeline::GetTrajectory()
+{
+    return m_trajectory;
+}
+
+OpenGymActionCache&
+OpenGymStepPipeline::GetActionCache()
+{
+    return m_actionCache;
+}
+
+const OpenGymActionCache&
+OpenGymStepPipeline::GetActionCache() const
+{
+    return m_actionCache;
+}
+
+void
+OpenGymStepPipeline::Reset()
+{
+    m_delta.Reset();
+    m_decimator.Reset();
+    m_deferredReward = 0;
+}
+
+bool
+OpenGymStepPipeline::Decimate(OpenGymStepState& state)
+{
+    m_obsFilled = false;
+    m_inlineFilled = false;
+    m_cacheable = false;
+    m_cacheHit = false;
+    if (m_decimator.IsPassThrough())
+    {
+        return true;
+    }
+    if (m_decimator.NeedsObservation())
+    {
+        // filled apart from the state message, which carries the encoding of the last one
+        NS_ABORT_MSG_IF(!state.obs, "No observation");
+        state.obs->FillDataPbMsgV2(&m_inlineObs, nullptr);
+        m_obsFilled = true;
+        m_inlineFilled = true;
+    }
+    return m_decimator.Step(&m_inlineObs, &state.reward, state.isGameOver);
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymStepPipeline::GetRepeatedAction() const
+{
+    return m_decimator.GetAction();
+}
+
+const ns3_ai_gym::DataV2&
+OpenGymStepPipeline::GetInlineObservation(const OpenGymStepState& state)
+{
+    // observations filled for the decimator are stacked, and filling reuses the fields
+    if (!m_inlineFilled)
+    {
+        if (state.obs)
+        {
+            state.obs->FillDataPbMsgV2(&m_inlineObs, nullptr);
+        }
+        else
+        {
+            m_inlineObs.Clear();
+        }
+        m_inlineFilled = true;
+    }
+    return m_inlineObs;
+}
+
+void
+OpenGymStepPipeline::Record(const OpenGymStepState& state)
+{
+    if (m_trajectory.IsOpen())
+    {
+        m_trajectory.AddState(GetInlineObservation(state),
+                              state.reward,
+                              state.isGameOver,
+                              state.extraInfo);
+    }
+}
+
+const ns3_ai_gym::DataV2*
+OpenGymStepPipeline::LookupAction(OpenGymStepState& state)
+{
+    // the key is the inline observation, whatever the encoding of the message
+    m_cacheable = m_actionCache.IsEnabled() && !state.isGameOver;
+    if (m_cacheable)
+    {
+        m_cacheKey.clear();
+        GetInlineObservation(state).AppendToString(&m_cacheKey);
+        if (std::string* cached = m_actionCache.Lookup(m_cacheKey))
+        {
+            DeferReward(state.reward);
+            m_cachedAction.ParseFromString(*cached);
+            m_cacheHit = true;
+            return &m_cachedAction;
+        }
+    }
+    state.reward += TakeDeferredReward();
+    return nullptr;
+}
+
+void
+OpenGymStepPipeline::DeferReward(float reward)
+{
+    m_deferredReward += reward;
+}
+
+float
+OpenGymStepPipeline::TakeDeferredReward()
+{
+    float reward = m_deferredReward;
+    m_deferredReward = 0;
+    return reward;
+}
+
+const ns3_ai_gym::EnvStateMsg&
+OpenGymStepPipeline::EncodeState(const OpenGymStepState& state, const OpenGymProfiler* profile)
+{
+    // the message is reused without Clear(), which would free its fields
+    ns3_ai_gym::EnvStateMsg& envStateMsg = m_envStateMsg;
+    if (state.obs && m_version >= 2)
+    {
+        // the payloads of the previous state have been read by Python
+        m_payload.Reset();
+        OpenGymPayloadArea* payload = m_usePayload ? &m_payload : nullptr;
+        ns3_ai_gym::DataV2* obsPbMsg = envStateMsg.mutable_obsdatav2();
+        if (m_obsFilled)
+        {
+            CopyInline(m_inlineObs, obsPbMsg);
+        }
+        if (m_useDelta)
+        {
+            // the encoder needs all data inline, and moves keyframes out of band
+            if (!m_obsFilled)
+            {
+                state.obs->FillDataPbMsgV2(obsPbMsg, nullptr);
+            }
+            m_delta.Encode(obsPbMsg, payload);
+        }
+        else if (m_obsFilled)
+        {
+            // observations filled for the decimator are inline, and only Boxes are stacked
+            if (obsPbMsg->has_box())
+            {
+                ns3_ai_gym::BoxDataV2* box = obsPbMsg->mutable_box();
+                if (payload &&
+                    payload->Write(box->data().data(), box->data().size(), box->mutable_payload()))
+                {
+                    box->mutable_data()->clear();
+                }
+                else
+                {
+                    box->clear_payload();
+                }
+            }
+        }
+        else
+        {
+            state.obs->FillDataPbMsgV2(obsPbMsg, payload);
+        }
+    }
+    else if (state.obs)
+    {
+        *envStateMsg.mutable_obsdata() = state.obs->GetDataContainerPbMsg();
+    }
+    else
+    {
+        envStateMsg.clear_obsdata();
+        envStateMsg.clear_obsdatav2();
+    }
+    envStateMsg.set_reward(state.reward);
+    envStateMsg.set_isgameover(state.isGameOver);
+    envStateMsg.set_reason(state.isGameOver && !state.simEnd
+                               ? ns3_ai_gym::EnvStateMsg::GameOver
+                               : ns3_ai_gym::EnvStateMsg::SimulationEnd);
+    envStateMsg.set_info(state.extraInfo);
+    if (profile)
+    {
+        profile->FillStatsPbMsg(envStateMsg.mutable_stats());
+    }
+    else
+    {
+        envStateMsg.clear_stats();
+    }
+    return envStateMsg;
+}
+
+const ns3_ai_gym::EnvActMsg&
+OpenGymStepPipeline::DecodeReply(const uint8_t* buffer, uint32_t size)
+{
+    if (m_version >= 2)
+    {
+        // merge into the previous message to keep the buffers of its fields
+        PrepareMerge(m_envActMsg);
+        google::protobuf::io::CodedInputStream input(buffer, size);
+        m_envActMsg.MergeFromCodedStream(&input);
+    }
+    else
+    {
+        m_envActMsg.ParseFromArray(buffer, size);
+    }
+    return m_envActMsg;
+}
+
+const ns3_ai_gym::EnvActMsg&
+OpenGymStepPipeline::GetReply() const
+{
+    return m_envActMsg;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymStepPipeline::DecodeAction()
+{
+    if (m_version >= 2)
+    {
+        return HasAction(m_envActMsg) ? DecodeData(m_envActMsg.actdatav2())
+                                      : Ptr<OpenGymDataContainer>();
+    }
+    Ptr<OpenGymDataContainer> action =
+        OpenGymDataContainer::CreateFromDataContainerPbMsg(*m_envActMsg.mutable_actdata());
+    if (m_steadyState && action)
+    {
+        m_actDataContainer = action;
+    }
+    return action;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymStepPipeline::DecodeData(const ns3_ai_gym::DataV2& data)
+{
+    Ptr<OpenGymDataContainer> action = OpenGymDataContainer::CreateFromDataPbMsgV2(
+        data,
+        m_steadyState ? m_actDataContainer : Ptr<OpenGymDataContainer>());
+    if (m_steadyState && action)
+    {
+        m_actDataContainer = action;
+    }
+    return action;
+}
+
+void
+OpenGymStepPipeline::AcceptAction(Ptr<OpenGymDataContainer> action,
+                                  const ns3_ai_gym::DataV2* data)
+{
+    if (m_cacheable && !m_cacheHit && action)
+    {
+        if (!data)
+        {
+            m_cachedAction.Clear();
+            action->FillDataPbMsgV2(&m_cachedAction, nullptr);
+            data = &m_cachedAction;
+        }
+        m_cacheValue.clear();
+        data->AppendToString(&m_cacheValue);
+        m_actionCache.Insert(m_cacheKey, m_cacheValue);
+    }
+    if (m_trajectory.IsOpen() && action)
+    {
+        m_trajectoryData.Clear();
+        action->FillDataPbMsgV2(&m_trajectoryData, nullptr);
+        m_trajectory.AddAction(m_trajectoryData);
+    }
+    m_decimator.SetAction(action);
+}
+
+} // namespace ns3
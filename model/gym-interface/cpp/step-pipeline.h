@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_STEP_PIPELINE_H
+#define OPENGYM_STEP_PIPELINE_H
+
+#include "action-cache.h"
+#include "decimator.h"
+#include "delta-encoder.h"
+#include "messages.pb.h"
+#include "payload-area.h"
+#include "trajectory-writer.h"
+
+#include <ns3/ptr.h>
+
+#include <cstdint>
+#include <string>
+
+namespace ns3
+{
+
+class OpenGymDataContainer;
+class OpenGymProfiler;
+
+/**
+ * \brief State of an environment at a step, as collected from its callbacks
+ */
+struct OpenGymStepState
+{
+    Ptr<OpenGymDataContainer> obs;
+    float reward{0};
+    bool isGameOver{false};
+    bool simEnd{false}; ///< whether the state is the final one of the simulation
+    std::string extraInfo;
+};
+
+/**
+ * \brief The stages of a step of a single agent exchanging protobuf messages.
+ *
+ * OpenGymInterface collects the state of the environment, and runs it through
+ * the stages in order: Decimate, Record, LookupAction, then either asks a
+ * policy, or EncodeState, exchanges the messages with Python, and calls
+ * DecodeReply and DecodeAction. The action taken is passed to AcceptAction
+ * before it is executed. The stages touch neither the shared memory nor the
+ * simulator, so that they can be run on their own. Messages and containers
+ * are reused, so that a step in steady state does not allocate.
+ */
+class OpenGymStepPipeline
+{
+  public:
+    OpenGymStepPipeline();
+
+    /**
+     * Set the protocol version, and whether Python accepts delta encoded
+     * observations and data carried out of band
+     */
+    void SetProtocol(uint32_t version, bool useDelta, bool usePayload);
+    uint32_t GetVersion() const;
+
+    /**
+     * Set whether the same action container is updated in place at every step
+     */
+    void SetSteadyState(bool steadyState);
+
+    OpenGymDecimator& GetDecimator();
+    OpenGymDeltaEncoder& GetDeltaEncoder();
+    OpenGymPayloadArea& GetPayloadArea();
+    OpenGymTrajectoryWriter& GetTrajectory();
+    OpenGymActionCache& GetActionCache();
+    const OpenGymActionCache& GetActionCache() const;
+
+    /**
+     * Start over with a new episode: the next observation is a keyframe and
+     * a decision, and the deferred rewards are dropped
+     */
+    void Reset();
+
+    /**
+     * First stage. Returns whether the agent decides at this step, with the
+     * stacked observation and the rewards summed since the last decision.
+     * Otherwise, GetRepeatedAction is executed again.
+     */
+    bool Decimate(OpenGymStepState& state);
+    Ptr<OpenGymDataContainer> GetRepeatedAction() const;
+
+    /**
+     * Record the state of a decision in the trajectory, if it is open
+     */
+    void Record(const OpenGymStepState& state);
+
+    /**
+     * Get the cached action of the observation, null if it is not cached. Its
+     * container is given by DecodeData. The reward of a cached state is
+     * deferred to the next state sent to the agent, and the deferred rewards
+     * are added to that of a state which is not cached.
+     */
+    const ns3_ai_gym::DataV2* LookupAction(OpenGymStepState& state);
+
+    /**
+     * Defer the reward of a state answered without the agent, or take the
+     * rewards deferred so far
+     */
+    void DeferReward(float reward);
+    float TakeDeferredReward();
+
+    /**
+     * Build the state message sent to Python. The profile so far is added if
+     * given, normally with the final state.
+     */
+    const ns3_ai_gym::EnvStateMsg& EncodeState(const OpenGymStepState& state,
+                                               const OpenGymProfiler* profile);
+
+    /**
+     * Read the reply of Python, merged into the previous one so that the
+     * buffers of its fields are kept
+     */
+    const ns3_ai_gym::EnvActMsg& DecodeReply(const uint8_t* buffer, uint32_t size);
+    const ns3_ai_gym::EnvActMsg& GetReply() const;
+
+    /**
+     * Get the action of the reply, null if it has none, such as the reply to
+     * the first state after a reset
+     */
+    Ptr<OpenGymDataContainer> DecodeAction();
+
+    /**
+     * Get the container of an action, which is the same at every step in
+     * steady state
+     */
+    Ptr<OpenGymDataContainer> DecodeData(const ns3_ai_gym::DataV2& data);
+
+    /**
+     * Last stage, before the action is executed. The action is cached under
+     * the observation of the state, recorded in the trajectory, and repeated
+     * until the next decision. The data of the action is given if available,
+     * to avoid encoding it again for the cache.
+     */
+    void AcceptAction(Ptr<OpenGymDataContainer> action,
+                      const ns3_ai_gym::DataV2* data = nullptr);
+
+  private:
+    const ns3_ai_gym::DataV2& GetInlineObservation(const OpenGymStepState& state);
+
+    uint32_t m_version;
+    bool m_useDelta;
+    bool m_usePayload;
+    bool m_steadyState;
+    OpenGymDecimator m_decimator;
+    OpenGymDeltaEncoder m_delta;
+    OpenGymPayloadArea m_payload;
+    OpenGymTrajectoryWriter m_trajectory;
+    OpenGymActionCache m_actionCache;
+
+    // of the current step
+    bool m_obsFilled;    ///< whether the decimator filled m_inlineObs
+    bool m_inlineFilled; ///< whether m_inlineObs holds the observation
+    bool m_cacheable;    ///< whether the action of the state is cached
+    bool m_cacheHit;     ///< whether the action of the state comes from the cache
+
+    // reused across steps, so that a step in steady state does not allocate
+    ns3_ai_gym::EnvStateMsg m_envStateMsg;
+    ns3_ai_gym::EnvActMsg m_envActMsg;
+    ns3_ai_gym::DataV2 m_inlineObs;      ///< observation with its data inline
+    ns3_ai_gym::DataV2 m_trajectoryData; ///< action of the trajectory
+    ns3_ai_gym::DataV2 m_cachedAction;   ///< action found in or added to the cache
+    std::string m_cacheKey;              ///< observation of the current state in the cache
+    std::string m_cacheValue;            ///< action being cached
+    float m_deferredReward; ///< sum of the rewards of the states answered by the cache
+    Ptr<OpenGymDataContainer> m_actDataContainer;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_STEP_PIPELINE_H
@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "trajectory-writer.h"
+
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+#include <ns3/system-path.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <sys/stat.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymTrajectoryWriter");
+
+namespace
+{
+
+/// chunks waiting for the background thread, beyond which appending rows waits
+constexpr std::size_t MAX_QUEUED_CHUNKS = 4;
+
+} // namespace
+
+OpenGymTrajectoryWriter::OpenGymTrajectoryWriter()
+    : m_open(false),
+      m_rowOpen(false),
+      m_chunkRows(1),
+      m_rows(0),
+      m_chunkRowCount(0),
+      m_pending(0),
+      m_closing(false)
+{
+}
+
+OpenGymTrajectoryWriter::~OpenGymTrajectoryWriter()
+{
+    Close();
+}
+
+void
+OpenGymTrajectoryWriter::Open(const std::string& directory,
+                              const std::string& name,
+                              const ns3_ai_gym::SpaceV2& obsSpace,
+                              const ns3_ai_gym::SpaceV2& actSpace,
+                              uint32_t chunkRows)
+{
+    NS_LOG_FUNCTION(this << directory << name << chunkRows);
+    NS_ABORT_MSG_IF(m_open, "Trajectory is already open");
+    SystemPath::MakeDirectories(directory);
+    // names of segments may have any character
+    std::string prefix = name;
+    std::replace_if(
+        prefix.begin(),
+        prefix.end(),
+        [](unsigned char c) { return !std::isalnum(c) && c != '-' && c != '_'; },
+        '_');
+    // mkdir fails on an existing directory, so concurrent simulations take distinct indexes
+    for (uint32_t n = 0;; n++)
+    {
+        m_directory = directory + "/" + prefix + "-" + std::to_string(n);
+        if (::mkdir(m_directory.c_str(), 0777) == 0)
+        {
+            break;
+        }
+        NS_ABORT_MSG_IF(errno != EEXIST,
+                        "Cannot create the trajectory directory " << m_directory);
+    }
+    InitColumn(OBS, "obs", &obsSpace, "", 0);
+    InitColumn(ACTION, "action", &actSpace, "", 0);
+    InitColumn(ACTED, "acted", nullptr, "uint8", sizeof(uint8_t));
+    InitColumn(REWARD, "reward", nullptr, "float32", sizeof(float));
+    InitColumn(DONE, "done", nullptr, "bool", sizeof(uint8_t));
+    InitColumn(INFO, "info", nullptr, "bytes", 0);
+    for (Column& column : m_columns)
+    {
+        std::string path = m_directory + "/" + column.name;
+        column.data.open(path + ".bin", std::ios::binary | std::ios::trunc);
+        NS_ABORT_MSG_IF(!column.data, "Cannot create the trajectory file " << path << ".bin");
+        if (!column.rowSize)
+        {
+            column.index.open(path + ".idx", std::ios::binary | std::ios::trunc);
+            NS_ABORT_MSG_IF(!column.index, "Cannot create the trajectory file " << path << ".idx");
+        }
+        column.end = 0;
+    }
+    WriteSchema(m_directory);
+
+    m_open = true;
+    m_rowOpen = false;
+    m_chunkRows = std::max<uint32_t>(chunkRows, 1);
+    m_rows = 0;
+    m_chunk = std::make_unique<Chunk>();
+    m_chunkRowCount = 0;
+    m_pending = 0;
+    m_closing = false;
+    m_thread = std::thread(&OpenGymTrajectoryWriter::WriteChunks, this);
+}
+
+bool
+OpenGymTrajectoryWriter::IsOpen() const
+{
+    return m_open;
+}
+
+std::string
+OpenGymTrajectoryWriter::GetDirectory() const
+{
+    return m_directory;
+}
+
+void
+OpenGymTrajectoryWriter::InitColumn(ColumnId id,
+                                    const std::string& name,
+                                    const ns3_ai_gym::SpaceV2* space,
+                                    const std::string& dtype,
+                                    uint32_t rowSize)
+{
+    Column& column = m_columns[id];
+    column.name = name;
+    column.dtype = dtype;
+    column.shape.clear();
+    column.rowSize = rowSize;
+    if (!space)
+    {
+        return;
+    }
+
+    // dense Boxes and Discretes have fixed-size rows, other spaces are serialized
+    if (space->has_box() && !space->box().sparse())
+    {
+        ns3_ai_gym::DataType dataType = space->box().dtype();
+        if (dataType == ns3_ai_gym::NoDataType)
+        {
+            dataType = ns3_ai_gym::FLOAT32;
+        }
+        column.dtype = ns3_ai_gym::DataType_Name(dataType);
+        std::transform(column.dtype.begin(),
+                       column.dtype.end(),
+                       column.dtype.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        column.shape.assign(space->box().shape().begin(), space->box().shape().end());
+        column.rowSize = OpenGymGetDataTypeSize(dataType);
+        for (uint32_t dim : column.shape)
+        {
+            column.rowSize *= dim;
+        }
+    }
+    else if (space->has_discrete())
+    {
+        column.dtype = "int64";
+        column.rowSize = sizeof(int64_t);
+    }
+    else
+    {
+        column.dtype = "bytes";
+    }
+}
+
+void
+OpenGymTrajectoryWriter::WriteSchema(const std::string& directory) const
+{
+    std::ofstream schema(directory + "/schema.json", std::ios::trunc);
+    NS_ABORT_MSG_IF(!schema, "Cannot create the trajectory schema in " << directory);
+    schema << "{\n  \"version\": 1,\n  \"columns\": [\n";
+    for (uint32_t i = 0; i < COLUMN_COUNT; i++)
+    {
+        const Column& column = m_columns[i];
+        schema << "    {\"name\": \"" << column.name << "\", \"dtype\": \"" << column.dtype
+               << "\", \"shape\": [";
+        for (std::size_t j = 0; j < column.shape.size(); j++)
+        {
+            schema << (j ? ", " : "") << column.shape[j];
+        }
+        schema << "], \"variable\": " << (column.rowSize ? "false" : "true") << "}"
+               << (i + 1 < COLUMN_COUNT ? "," : "") << "\n";
+    }
+    schema << "  ]\n}\n";
+}
+
+void
+OpenGymTrajectoryWriter::AddState(const ns3_ai_gym::DataV2& obs,
+                                  float reward,
+                                  bool isGameOver,
+                                  const std::string& info)
+{
+    if (m_rowOpen)
+    {
+        EndRow(false);
+    }
+    Append(OBS, obs);
+    Append(REWARD, &reward, sizeof(reward));
+    uint8_t done = isGameOver;
+    Append(DONE, &done, sizeof(done));
+    Append(INFO, info.data(), info.size());
+    m_rowOpen = true;
+}
+
+void
+OpenGymTrajectoryWriter::AddState(const void* obs,
+                                  std::size_t size,
+                                  float reward,
+                                  bool isGameOver,
+                                  const std::string& info)
+{
+    if (m_rowOpen)
+    {
+        EndRow(false);
+    }
+    Append(OBS, obs, size);
+    Append(REWARD, &reward, sizeof(reward));
+    uint8_t done = isGameOver;
+    Append(DONE, &done, sizeof(done));
+    Append(INFO, info.data(), info.size());
+    m_rowOpen = true;
+}
+
+void
+OpenGymTrajectoryWriter::AddAction(const ns3_ai_gym::DataV2& action)
+{
+    if (m_rowOpen)
+    {
+        Append(ACTION, action);
+        EndRow(true);
+    }
+}
+
+void
+OpenGymTrajectoryWriter::AddAction(const void* action, std::size_t size)
+{
+    if (m_rowOpen)
+    {
+        Append(ACTION, action, size);
+        EndRow(true);
+    }
+}
+
+void
+OpenGymTrajectoryWriter::Append(ColumnId id, const void* data, std::size_t size)
+{
+    Column& column = m_columns[id];
+    NS_ABORT_MSG_IF(column.rowSize && size != column.rowSize,
+                    "Row of " << size << " bytes in the trajectory column " << column.name
+                              << " of " << column.rowSize << " bytes");
+    std::vector<uint8_t>& chunkData = m_chunk->data[id];
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    chunkData.insert(chunkData.end(), bytes, bytes + size);
+    if (!column.rowSize)
+    {
+        column.end += size;
+        m_chunk->index[id].push_back(column.end);
+    }
+}
+
+void
+OpenGymTrajectoryWriter::Append(ColumnId id, const ns3_ai_gym::DataV2& data)
+{
+    if (!m_columns[id].rowSize)
+    {
+        data.SerializeToString(&m_serialized);
+        Append(id, m_serialized.data(), m_serialized.size());
+    }
+    else if (data.has_box())
+    {
+        Append(id, data.box().data().data(), data.box().data().size());
+    }
+    else
+    {
+        int64_t discrete = data.discrete();
+        Append(id, &discrete, sizeof(discrete));
+    }
+}
+
+void
+OpenGymTrajectoryWriter::EndRow(bool acted)
+{
+    if (!acted)
+    {
+        // zeros, or an empty row, stand for the missing action
+        std::vector<uint8_t>& chunkData = m_chunk->data[ACTION];
+        chunkData.resize(chunkData.size() + m_columns[ACTION].rowSize);
+        if (!m_columns[ACTION].rowSize)
+        {
+            m_chunk->index[ACTION].push_back(m_columns[ACTION].end);
+        }
+    }
+    uint8_t actedByte = acted;
+    Append(ACTED, &actedByte, sizeof(actedByte));
+    m_rowOpen = false;
+    m_rows++;
+    if (++m_chunkRowCount >= m_chunkRows)
+    {
+        Flush();
+    }
+}
+
+void
+OpenGymTrajectoryWriter::Flush()
+{
+    if (!m_chunkRowCount)
+    {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // the simulation waits if the disk cannot keep up, which bounds the memory
+        m_cv.wait(lock, [this] { return m_queue.size() < MAX_QUEUED_CHUNKS; });
+        m_queue.push_back(std::move(m_chunk));
+        m_pending++;
+    }
+    m_cv.notify_all();
+    m_chunk = std::make_unique<Chunk>();
+    m_chunkRowCount = 0;
+}
+
+void
+OpenGymTrajectoryWriter::WriteChunks()
+{
+    while (true)
+    {
+        std::unique_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+            if (m_queue.empty())
+            {
+                break;
+            }
+            chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_cv.notify_all();
+        for (uint32_t i = 0; i < COLUMN_COUNT; i++)
+        {
+            Column& column = m_columns[i];
+            column.data.write(reinterpret_cast<const char*>(chunk->data[i].data()),
+                              chunk->data[i].size());
+            if (!column.rowSize)
+            {
+                column.index.write(reinterpret_cast<const char*>(chunk->index[i].data()),
+                                   chunk->index[i].size() * sizeof(uint64_t));
+            }
+            // e.g. a full disk, which would leave the columns inconsistent
+            NS_ABORT_MSG_IF(!column.data || (!column.rowSize && !column.index),
+                            "Cannot write the trajectory column " << column.name << " in "
+                                                                  << m_directory);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending--;
+        }
+        m_cv.notify_all();
+    }
+}
+
+void
+OpenGymTrajectoryWriter::Sync()
+{
+    if (!m_open)
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this);
+    if (m_rowOpen)
+    {
+        EndRow(false);
+    }
+    Flush();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_pending == 0; });
+    // the background thread is idle until the next chunk
+    for (Column& column : m_columns)
+    {
+        column.data.flush();
+        if (!column.rowSize)
+        {
+            column.index.flush();
+        }
+        NS_ABORT_MSG_IF(!column.data || (!column.rowSize && !column.index),
+                        "Cannot write the trajectory column " << column.name << " in "
+                                                              << m_directory);
+    }
+}
+
+void
+OpenGymTrajectoryWriter::Close()
+{
+    if (!m_open)
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this);
+    if (m_rowOpen)
+    {
+        EndRow(false);
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    for (Column& column : m_columns)
+    {
+        // closing flushes the last bytes, which may fail too
+        column.data.close();
+        NS_ABORT_MSG_IF(!column.data,
+                        "Cannot write the trajectory column " << column.name << " in "
+                                                              << m_directory);
+        if (!column.rowSize)
+        {
+            column.index.close();
+            NS_ABORT_MSG_IF(!column.index,
+                            "Cannot write the trajectory column " << column.name << " in "
+                                                                  << m_directory);
+        }
+    }
+    m_chunk.reset();
+    m_open = false;
+    NS_LOG_INFO("Trajectory of " << m_rows << " rows written to " << m_directory);
+}
+
+uint64_t
+OpenGymTrajectoryWriter::GetRows() const
+{
+    return m_rows;
+}
+
+} // namespace ns3
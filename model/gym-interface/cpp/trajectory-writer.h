@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef OPENGYM_TRAJECTORY_WRITER_H
+#define OPENGYM_TRAJECTORY_WRITER_H
+
+#include "messages.pb.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Appends the states and actions exchanged with the agent to columnar
+ * files, for offline RL.
+ *
+ * Every simulation writes its trajectory to its own subdirectory of the
+ * trajectory path, so relaunched and parallel simulations never overwrite
+ * each other. A trajectory is a directory with schema.json, describing the columns, and
+ * one <column>.bin file per column. Row t holds the state of step t (obs,
+ * reward, done, info) and the action the agent answered with (action, and
+ * acted, 0 if there was none, e.g. for the final state). Columns of dense
+ * Box and Discrete spaces have fixed-size rows of packed elements in native
+ * byte order, which can be memory-mapped as arrays. Other columns hold
+ * serialized DataV2 or strings, with the end offset of every row as uint64 in
+ * <column>.idx. Rows are buffered in chunks, which a background thread
+ * appends to the files, so trajectories can be larger than the memory.
+ */
+class OpenGymTrajectoryWriter
+{
+  public:
+    OpenGymTrajectoryWriter();
+    ~OpenGymTrajectoryWriter();
+
+    /**
+     * Create the trajectory in a new subdirectory <name>-<n> of the
+     * directory, created if needed, n being the first index not taken, with
+     * the columns of the observation and action spaces. Rows are written by
+     * chunks of the given number.
+     */
+    void Open(const std::string& directory,
+              const std::string& name,
+              const ns3_ai_gym::SpaceV2& obsSpace,
+              const ns3_ai_gym::SpaceV2& actSpace,
+              uint32_t chunkRows);
+    bool IsOpen() const;
+
+    /**
+     * Subdirectory of the trajectory, once open
+     */
+    std::string GetDirectory() const;
+
+    /**
+     * Start the row of a state, ending the previous one without an action if
+     * it had none. The observation has its Box data inline.
+     */
+    void AddState(const ns3_ai_gym::DataV2& obs,
+                  float reward,
+                  bool isGameOver,
+                  const std::string& info);
+
+    /**
+     * Start the row of a state whose observation is packed Box data
+     */
+    void AddState(const void* obs,
+                  std::size_t size,
+                  float reward,
+                  bool isGameOver,
+                  const std::string& info);
+
+    /**
+     * End the row of the last state with the action of the agent
+     */
+    void AddAction(const ns3_ai_gym::DataV2& action);
+
+    /**
+     * End the row of the last state with an action of packed Box data
+     */
+    void AddAction(const void* action, std::size_t size);
+
+    /**
+     * End the row of the last state without an action, and wait until the
+     * rows so far are in the files, e.g. before the final state is sent to
+     * Python, which may kill the simulation once it has it
+     */
+    void Sync();
+
+    /**
+     * Write the rows so far and close the files
+     */
+    void Close();
+
+    /**
+     * Number of rows ended so far
+     */
+    uint64_t GetRows() const;
+
+  private:
+    enum ColumnId
+    {
+        OBS,
+        ACTION,
+        ACTED,
+        REWARD,
+        DONE,
+        INFO,
+        COLUMN_COUNT,
+    };
+
+    struct Column
+    {
+        std::string name;
+        std::string dtype;           ///< numpy dtype of the elements, "bytes" if variable
+        std::vector<uint32_t> shape; ///< of a row
+        uint32_t rowSize{0};         ///< 0 if rows are variable
+        std::ofstream data;
+        std::ofstream index; ///< end offsets of variable rows
+        uint64_t end{0};     ///< end offset of the last variable row
+    };
+
+    /// Rows buffered for the background thread
+    struct Chunk
+    {
+        std::vector<uint8_t> data[COLUMN_COUNT];
+        std::vector<uint64_t> index[COLUMN_COUNT];
+    };
+
+    void InitColumn(ColumnId id,
+                    const std::string& name,
+                    const ns3_ai_gym::SpaceV2* space,
+                    const std::string& dtype,
+                    uint32_t rowSize);
+    void Append(ColumnId id, const void* data, std::size_t size);
+    void Append(ColumnId id, const ns3_ai_gym::DataV2& data);
+    void EndRow(bool acted);
+    void Flush();
+    void WriteChunks();
+    void WriteSchema(const std::string& directory) const;
+
+    bool m_open;
+    std::string m_directory; ///< subdirectory of this trajectory
+    bool m_rowOpen; ///< whether the row of the last state awaits its action
+    uint32_t m_chunkRows;
+    uint64_t m_rows;
+    Column m_columns[COLUMN_COUNT];
+    std::unique_ptr<Chunk> m_chunk;
+    uint32_t m_chunkRowCount;
+    std::string m_serialized; ///< reused to serialize variable rows
+
+    // background thread appending the chunks to the files
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::unique_ptr<Chunk>> m_queue;
+    uint32_t m_pending; ///< chunks queued or being written
+    bool m_closing;
+};
+
+} // namespace ns3
+
+#endif // OPENGYM_TRAJECTORY_WRITER_H
@@ -30,4 +30,36 @@ struct Ns3AiGymMsg
     uint32_t size;
 };
 
+/**
+ * Offset of the observation or action in a message of the flat layout,
+ * which is used instead of protobuf when both spaces are Boxes
+ */
+#define NS3AI_GYM_FLAT_DATA_OFFSET 16
+
+/**
+ * Header of a state message in the flat layout. The observation starts at
+ * NS3AI_GYM_FLAT_DATA_OFFSET, and the extra info string at infoOffset. In the
+ * final state, a serialized ProfileStats may follow the extra info.
+ */
+struct Ns3AiGymFlatState
+{
+    float reward;
+    uint8_t isGameOver;
+    uint8_t reason;     ///< EnvStateMsg::Reason
+    uint16_t statsSize; ///< size of the ProfileStats, 0 if none
+    uint32_t infoOffset;
+    uint32_t infoSize;
+};
+
+/**
+ * Header of an action message in the flat layout. The action starts at
+ * NS3AI_GYM_FLAT_DATA_OFFSET.
+ */
+struct Ns3AiGymFlatAction
+{
+    uint8_t stopSimReq;
+    uint8_t hasAction;
+    uint8_t resetReq; ///< end the episode, when the simulation runs episodes in process
+};
+
 #endif // NS3_NS3_AI_GYM_MSG_H
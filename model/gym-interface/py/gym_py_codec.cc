@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "gym_py_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+void
+Check(bool ok)
+{
+    if (!ok)
+    {
+        throw std::runtime_error("Malformed Gym message");
+    }
+}
+
+py::dtype
+DtypeOf(ns3_ai_gym::DataType dataType)
+{
+    switch (dataType)
+    {
+    case ns3_ai_gym::INT8:
+        return py::dtype("int8");
+    case ns3_ai_gym::INT16:
+        return py::dtype("int16");
+    case ns3_ai_gym::INT32:
+        return py::dtype("int32");
+    case ns3_ai_gym::INT64:
+        return py::dtype("int64");
+    case ns3_ai_gym::UINT8:
+        return py::dtype("uint8");
+    case ns3_ai_gym::UINT16:
+        return py::dtype("uint16");
+    case ns3_ai_gym::UINT32:
+        return py::dtype("uint32");
+    case ns3_ai_gym::UINT64:
+        return py::dtype("uint64");
+    case ns3_ai_gym::FLOAT16:
+        return py::dtype("float16");
+    case ns3_ai_gym::FLOAT64:
+        return py::dtype("float64");
+    case ns3_ai_gym::BOOL:
+        return py::dtype("bool");
+    default:
+        return py::dtype("float32");
+    }
+}
+
+/**
+ * Set the observation field mask of an action message, given as a serialized
+ * FieldMask, or clear it if None
+ */
+template <typename Msg>
+void
+SetObsFields(py::handle obsFields, Msg& msg)
+{
+    if (obsFields.is_none())
+    {
+        msg.clear_obsfields();
+        return;
+    }
+    if (!msg.mutable_obsfields()->ParseFromString(obsFields.cast<std::string>()))
+    {
+        throw py::value_error("Malformed observation field mask");
+    }
+}
+
+/**
+ * Serialize an action message into the buffer
+ */
+uint32_t
+Serialize(const google::protobuf::MessageLite& msg, py::buffer& buffer)
+{
+    py::buffer_info info = buffer.request(true);
+    std::size_t bufferSize = info.size * info.itemsize;
+    std::size_t size = msg.ByteSizeLong();
+    if (size > bufferSize)
+    {
+        throw py::value_error("Action message of " + std::to_string(size) +
+                              " bytes does not fit in the buffer of " +
+                              std::to_string(bufferSize) + " bytes");
+    }
+    msg.SerializeWithCachedSizesToArray(static_cast<uint8_t*>(info.ptr));
+    return static_cast<uint32_t>(size);
+}
+
+} // namespace
+
+Ns3AiGymCodec::Ns3AiGymCodec(const py::bytes& obsSpace, const py::bytes& actSpace, bool delta)
+    : m_delta(delta),
+      m_asContiguous(py::module_::import("numpy").attr("ascontiguousarray")),
+      m_stats(py::none()),
+      m_sparseFactory(py::none())
+{
+    CompileSpace(obsSpace, m_obsNode);
+    CompileSpace(actSpace, m_actNode);
+}
+
+py::object
+Ns3AiGymCodec::TakeStats()
+{
+    py::object stats = m_stats;
+    m_stats = py::none();
+    return stats;
+}
+
+void
+Ns3AiGymCodec::SetSparseFactory(py::object factory)
+{
+    m_sparseFactory = factory;
+}
+
+void
+Ns3AiGymCodec::AddAgent(uint32_t agentId, const py::bytes& obsSpace, const py::bytes& actSpace)
+{
+    Agent& agent = m_agents[agentId];
+    agent = Agent();
+    CompileSpace(obsSpace, agent.obs);
+    CompileSpace(actSpace, agent.act);
+}
+
+void
+Ns3AiGymCodec::CompileSpace(const py::bytes& space, Node& node)
+{
+    std::string desc = space;
+    ns3_ai_gym::SpaceV2 spacePbMsg;
+    Check(spacePbMsg.ParseFromString(desc));
+    CompileSpace(spacePbMsg, node);
+}
+
+void
+Ns3AiGymCodec::CompileSpace(const ns3_ai_gym::SpaceV2& space, Node& node)
+{
+    node.name = space.name();
+    switch (space.space_case())
+    {
+    case ns3_ai_gym::SpaceV2::kDiscrete:
+        node.kind = Node::DISCRETE;
+        break;
+    case ns3_ai_gym::SpaceV2::kBox: {
+        node.kind = Node::BOX;
+        const ns3_ai_gym::BoxSpaceV2& box = space.box();
+        // the element type of Box data sent by Python is float32 by default
+        node.dataType =
+            box.dtype() == ns3_ai_gym::NoDataType ? ns3_ai_gym::FLOAT32 : box.dtype();
+        node.dtype = DtypeOf(node.dataType);
+        node.shape.assign(box.shape().begin(), box.shape().end());
+        for (py::ssize_t dim : node.shape)
+        {
+            node.count *= dim;
+        }
+        break;
+    }
+    case ns3_ai_gym::SpaceV2::kTuple:
+    case ns3_ai_gym::SpaceV2::kDict: {
+        bool isTuple = space.space_case() == ns3_ai_gym::SpaceV2::kTuple;
+        node.kind = isTuple ? Node::TUPLE : Node::DICT;
+        for (const ns3_ai_gym::SpaceV2& element :
+             isTuple ? space.tuple().element() : space.dict().element())
+        {
+            node.elements.emplace_back();
+            CompileSpace(element, node.elements.back());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+py::tuple
+Ns3AiGymCodec::DecodeState(MsgInterface& msgInterface, py::buffer buffer, uint32_t size)
+{
+    py::buffer_info info = buffer.request();
+    if (size > static_cast<std::size_t>(info.size * info.itemsize))
+    {
+        throw py::value_error("State message is larger than its buffer");
+    }
+    // the message is reused, so that its fields keep their buffers
+    Check(m_stateMsg.ParseFromArray(info.ptr, static_cast<int>(size)));
+    return DecodeStateMsg(msgInterface, m_stateMsg, m_obsNode);
+}
+
+py::dict
+Ns3AiGymCodec::DecodeStates(MsgInterface& msgInterface, py::buffer buffer, uint32_t size)
+{
+    py::buffer_info info = buffer.request();
+    if (size > static_cast<std::size_t>(info.size * info.itemsize))
+    {
+        throw py::value_error("State message is larger than its buffer");
+    }
+    Check(m_stateBatchMsg.ParseFromArray(info.ptr, static_cast<int>(size)));
+    if (m_stateBatchMsg.has_stats())
+    {
+        m_stats = py::bytes(m_stateBatchMsg.stats().SerializeAsString());
+    }
+
+    // the observation of every agent is decoded in the agent's space
+    py::dict states;
+    for (const ns3_ai_gym::EnvStateMsg& state : m_stateBatchMsg.agents())
+    {
+        auto agent = m_agents.find(state.agentid());
+        if (agent == m_agents.end())
+        {
+            throw std::runtime_error("State of unknown agent " + std::to_string(state.agentid()));
+        }
+        states[py::int_(state.agentid())] = DecodeStateMsg(msgInterface, state, agent->second.obs);
+    }
+    return states;
+}
+
+py::tuple
+Ns3AiGymCodec::DecodeStateMsg(MsgInterface& msgInterface,
+                              const ns3_ai_gym::EnvStateMsg& state,
+                              Node& obsNode)
+{
+    py::object obs = py::none();
+    if (state.has_obsdatav2())
+    {
+        obs = DecodeData(msgInterface, state.obsdatav2(), obsNode);
+    }
+    if (state.has_stats())
+    {
+        m_stats = py::bytes(state.stats().SerializeAsString());
+    }
+    return py::make_tuple(obs,
+                          state.reward(),
+                          state.isgameover(),
+                          static_cast<uint64_t>(state.reason()),
+                          py::str(state.info()));
+}
+
+py::object
+Ns3AiGymCodec::DecodeData(MsgInterface& msgInterface,
+                          const ns3_ai_gym::DataV2& data,
+                          Node& node)
+{
+    switch (data.data_case())
+    {
+    case ns3_ai_gym::DataV2::kDiscrete:
+        return py::int_(data.discrete());
+    case ns3_ai_gym::DataV2::kBox:
+        if (node.kind != Node::BOX)
+        {
+            throw std::runtime_error("Gym observation does not match its space");
+        }
+        return DecodeBox(msgInterface, data.box(), node);
+    case ns3_ai_gym::DataV2::kTuple: {
+        if (node.kind != Node::TUPLE ||
+            static_cast<std::size_t>(data.tuple().element_size()) > node.elements.size())
+        {
+            throw std::runtime_error("Gym observation does not match its space");
+        }
+        py::list list;
+        std::size_t idx = 0;
+        for (const ns3_ai_gym::DataV2& element : data.tuple().element())
+        {
+            list.append(DecodeData(msgInterface, element, node.elements[idx++]));
+        }
+        return py::tuple(list);
+    }
+    case ns3_ai_gym::DataV2::kDict: {
+        if (node.kind != Node::DICT)
+        {
+            throw std::runtime_error("Gym observation does not match its space");
+        }
+        py::dict dict;
+        for (const ns3_ai_gym::DataV2& element : data.dict().element())
+        {
+            Node* elementNode = nullptr;
+            for (Node& candidate : node.elements)
+            {
+                if (candidate.name == element.name())
+                {
+                    elementNode = &candidate;
+                    break;
+                }
+            }
+            if (!elementNode)
+            {
+                throw std::runtime_error("Unknown key '" + element.name() +
+                                         "' in Gym observation");
+            }
+            dict[py::str(element.name())] = DecodeData(msgInterface, element, *elementNode);
+        }
+        return dict;
+    }
+    default:
+        return py::none();
+    }
+}
+
+py::object
+Ns3AiGymCodec::DecodeBox(MsgInterface& msgInterface,
+                         const ns3_ai_gym::BoxDataV2& box,
+                         Node& node)
+{
+    ns3_ai_gym::DataType dataType =
+        box.dtype() == ns3_ai_gym::NoDataType ? node.dataType : box.dtype();
+    std::vector<py::ssize_t> shape(box.shape().begin(), box.shape().end());
+    py::dtype dtype = dataType == node.dataType ? node.dtype : DtypeOf(dataType);
+    std::size_t itemSize = dtype.itemsize();
+
+    if (box.has_sparse())
+    {
+        const std::string& index = box.sparse().index();
+        const std::string& values = box.sparse().values();
+        std::size_t nonzero = index.size() / sizeof(uint32_t);
+        Check(values.size() == nonzero * itemSize);
+        if (shape.empty())
+        {
+            shape = node.shape;
+        }
+        if (!m_sparseFactory.is_none())
+        {
+            std::vector<py::ssize_t> count(1, static_cast<py::ssize_t>(nonzero));
+            return m_sparseFactory(py::array(DtypeOf(ns3_ai_gym::UINT32), count, index.data()),
+                                   py::array(dtype, count, values.data()),
+                                   py::tuple(py::cast(shape)));
+        }
+        // scattered into zeros, the elements are read as they come
+        py::array array(dtype, shape);
+        uint8_t* arrayData = static_cast<uint8_t*>(array.mutable_data());
+        std::memset(arrayData, 0, array.nbytes());
+        for (std::size_t k = 0; k < nonzero; ++k)
+        {
+            uint32_t idx;
+            std::memcpy(&idx, index.data() + k * sizeof(uint32_t), sizeof(uint32_t));
+            Check(idx < static_cast<std::size_t>(array.size()));
+            std::memcpy(arrayData + idx * itemSize, values.data() + k * itemSize, itemSize);
+        }
+        return array;
+    }
+
+    if (box.has_delta())
+    {
+        // with delta encoding, the array of every Box is kept and updated in place
+        if (!m_delta || !node.frame)
+        {
+            throw std::runtime_error("Delta encoded observation without a previous one");
+        }
+        const std::string& index = box.delta().index();
+        const std::string& values = box.delta().values();
+        py::array frame = py::reinterpret_borrow<py::array>(node.frame);
+        std::size_t changed = index.size() / sizeof(uint32_t);
+        Check(static_cast<std::size_t>(frame.itemsize()) == itemSize &&
+              values.size() == changed * itemSize);
+        uint8_t* frameData = static_cast<uint8_t*>(frame.mutable_data());
+        for (std::size_t k = 0; k < changed; ++k)
+        {
+            uint32_t idx;
+            std::memcpy(&idx, index.data() + k * sizeof(uint32_t), sizeof(uint32_t));
+            Check(idx < static_cast<std::size_t>(frame.size()));
+            std::memcpy(frameData + idx * itemSize, values.data() + k * itemSize, itemSize);
+        }
+        return frame;
+    }
+
+    // the elements are inline, or in a payload of the segment
+    const void* data = box.data().data();
+    std::size_t size = box.data().size();
+    if (box.has_payload())
+    {
+        data = msgInterface.GetPayloadAddress(box.payload().handle());
+        size = box.payload().size();
+    }
+    Check(size % itemSize == 0);
+    std::size_t count = size / itemSize;
+    std::size_t shapeCount = 1;
+    for (py::ssize_t dim : shape)
+    {
+        shapeCount *= dim;
+    }
+    // the shape of the space, unless the simulation sent data of another size
+    if (count == node.count)
+    {
+        shape = node.shape;
+    }
+    else if (count != shapeCount)
+    {
+        shape.assign(1, static_cast<py::ssize_t>(count));
+    }
+
+    if (m_delta && node.frame && size)
+    {
+        py::array frame = py::reinterpret_borrow<py::array>(node.frame);
+        if (frame.dtype().equal(dtype) && static_cast<std::size_t>(frame.ndim()) == shape.size() &&
+            std::equal(shape.begin(), shape.end(), frame.shape()))
+        {
+            std::memcpy(frame.mutable_data(), data, size);
+            return frame;
+        }
+    }
+
+    py::array array(dtype, shape);
+    if (size)
+    {
+        std::memcpy(array.mutable_data(), data, size);
+    }
+    if (m_delta)
+    {
+        node.frame = array;
+    }
+    return array;
+}
+
+uint32_t
+Ns3AiGymCodec::EncodeAction(py::buffer buffer,
+                            py::handle actions,
+                            bool stopSimReq,
+                            py::handle obsFields,
+                            bool resetReq)
+{
+    // the message is reused, so that its fields keep their buffers
+    m_actMsg.set_stopsimreq(stopSimReq);
+    m_actMsg.set_resetreq(resetReq);
+    if (actions.is_none())
+    {
+        m_actMsg.clear_actdatav2();
+    }
+    else
+    {
+        FillData(actions, m_actNode, m_actMsg.mutable_actdatav2());
+    }
+    SetObsFields(obsFields, m_actMsg);
+    return Serialize(m_actMsg, buffer);
+}
+
+uint32_t
+Ns3AiGymCodec::EncodeActions(py::buffer buffer,
+                             py::handle actions,
+                             bool stopSimReq,
+                             py::handle obsFields,
+                             bool resetReq)
+{
+    auto* agents = m_actBatchMsg.mutable_agents();
+    int count = 0;
+    if (!actions.is_none())
+    {
+        for (py::handle item : actions.attr("items")())
+        {
+            py::tuple pair = py::reinterpret_borrow<py::tuple>(item);
+            uint32_t agentId = pair[0].cast<uint32_t>();
+            auto agent = m_agents.find(agentId);
+            if (agent == m_agents.end())
+            {
+                throw py::value_error("Action of unknown agent " + std::to_string(agentId));
+            }
+            ns3_ai_gym::EnvActMsg* agentMsg =
+                count < agents->size() ? agents->Mutable(count) : agents->Add();
+            ++count;
+            agentMsg->set_agentid(agentId);
+            py::object action = pair[1];
+            if (action.is_none())
+            {
+                agentMsg->clear_actdatav2();
+            }
+            else
+            {
+                FillData(action, agent->second.act, agentMsg->mutable_actdatav2());
+            }
+        }
+    }
+    while (agents->size() > count)
+    {
+        agents->RemoveLast();
+    }
+    m_actBatchMsg.set_stopsimreq(stopSimReq);
+    m_actBatchMsg.set_resetreq(resetReq);
+    SetObsFields(obsFields, m_actBatchMsg);
+    return Serialize(m_actBatchMsg, buffer);
+}
+
+void
+Ns3AiGymCodec::FillData(py::handle actions, const Node& node, ns3_ai_gym::DataV2* data)
+{
+    switch (node.kind)
+    {
+    case Node::DISCRETE:
+        data->set_discrete(py::int_(py::reinterpret_borrow<py::object>(actions)).cast<int64_t>());
+        break;
+    case Node::BOX: {
+        // converted only if the actions are not an array of the space's dtype
+        py::array array = m_asContiguous(actions, node.dtype);
+        ns3_ai_gym::BoxDataV2* box = data->mutable_box();
+        box->set_dtype(node.dataType);
+        box->mutable_shape()->Clear();
+        for (py::ssize_t dim = 0; dim < array.ndim(); ++dim)
+        {
+            box->add_shape(static_cast<uint32_t>(array.shape(dim)));
+        }
+        // assign() reuses the buffer of the field
+        box->mutable_data()->assign(static_cast<const char*>(array.data()), array.nbytes());
+        break;
+    }
+    case Node::TUPLE:
+    case Node::DICT: {
+        bool isTuple = node.kind == Node::TUPLE;
+        auto* elements = isTuple ? data->mutable_tuple()->mutable_element()
+                                 : data->mutable_dict()->mutable_element();
+        py::iterable items = isTuple ? py::iterable(py::reinterpret_borrow<py::object>(actions))
+                                     : py::iterable(actions.attr("items")());
+        int count = 0;
+        for (py::handle item : items)
+        {
+            const Node* elementNode = nullptr;
+            py::object value;
+            if (isTuple)
+            {
+                value = py::reinterpret_borrow<py::object>(item);
+                if (static_cast<std::size_t>(count) >= node.elements.size())
+                {
+                    throw py::value_error("Action has more elements than its space");
+                }
+                elementNode = &node.elements[count];
+            }
+            else
+            {
+                py::tuple pair = py::reinterpret_borrow<py::tuple>(item);
+                std::string name = pair[0].cast<std::string>();
+                value = pair[1];
+                for (const Node& candidate : node.elements)
+                {
+                    if (candidate.name == name)
+                    {
+                        elementNode = &candidate;
+                        break;
+                    }
+                }
+                if (!elementNode)
+                {
+                    throw py::value_error("Unknown key '" + name + "' in action");
+                }
+            }
+            ns3_ai_gym::DataV2* element =
+                count < elements->size() ? elements->Mutable(count) : elements->Add();
+            ++count;
+            if (!isTuple)
+            {
+                element->set_name(elementNode->name);
+            }
+            FillData(value, *elementNode, element);
+        }
+        while (elements->size() > count)
+        {
+            elements->RemoveLast();
+        }
+        break;
+    }
+    default:
+        throw py::value_error("The environment has no action space");
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3AI_GYM_PY_CODEC_H
+#define NS3AI_GYM_PY_CODEC_H
+
+#include <ns3/ai-module.h>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+
+/**
+ * Decodes v2 state messages into Python objects and encodes Python actions
+ * into v2 action messages, with the C++ classes generated from messages.proto
+ * instead of the protobuf Python runtime.
+ *
+ * The codec is compiled once from the serialized SpaceV2 descriptions of the
+ * observation and action spaces. Box data is copied between the messages and
+ * numpy arrays of the space's dtype and shape with one memcpy.
+ */
+class Ns3AiGymCodec
+{
+  public:
+    using MsgInterface = ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>;
+
+    /**
+     * \param obsSpace serialized SpaceV2 of the observations
+     * \param actSpace serialized SpaceV2 of the actions
+     * \param delta whether Box observations may be delta encoded
+     */
+    Ns3AiGymCodec(const py::bytes& obsSpace, const py::bytes& actSpace, bool delta);
+
+    /**
+     * Decode an EnvStateMsg of the given size. Out-of-band data is resolved
+     * through the message interface, so this must be called before PyRecvEnd.
+     *
+     * \return (obs, reward, isGameOver, reason, info)
+     */
+    py::tuple DecodeState(MsgInterface& msgInterface, py::buffer buffer, uint32_t size);
+
+    /**
+     * Encode an EnvActMsg into the buffer. Actions are omitted if None, and
+     * so is the observation field mask, given as a serialized FieldMask.
+     * resetReq ends the episode, when the simulation runs episodes in process.
+     *
+     * \return size of the message, or ValueError if it does not fit
+     */
+    uint32_t EncodeAction(py::buffer buffer,
+                          py::handle actions,
+                          bool stopSimReq,
+                          py::handle obsFields,
+                          bool resetReq);
+
+    /**
+     * Take the serialized ProfileStats of the last decoded message carrying
+     * them, i.e., the final state of a profiled simulation, or None
+     */
+    py::object TakeStats();
+
+    /**
+     * Set how sparse Box observations are returned: factory(index, values,
+     * shape) is called with the uint32 row-major indices and the values of
+     * their nonzero elements. If None, they are returned as dense arrays.
+     */
+    void SetSparseFactory(py::object factory);
+
+    /**
+     * Add the spaces of an agent, in multi-agent mode
+     */
+    void AddAgent(uint32_t agentId, const py::bytes& obsSpace, const py::bytes& actSpace);
+
+    /**
+     * Decode an EnvStateBatchMsg of the given size, like DecodeState.
+     *
+     * \return {agentId: (obs, reward, isGameOver, reason, info)}
+     */
+    py::dict DecodeStates(MsgInterface& msgInterface, py::buffer buffer, uint32_t size);
+
+    /**
+     * Encode an EnvActBatchMsg from {agentId: action} into the buffer. Agents
+     * whose action is None are sent without one, and all are omitted if None.
+     * The observation field mask and resetReq are handled as by EncodeAction.
+     *
+     * \return size of the message, or ValueError if it does not fit
+     */
+    uint32_t EncodeActions(py::buffer buffer,
+                           py::handle actions,
+                           bool stopSimReq,
+                           py::handle obsFields,
+                           bool resetReq);
+
+  private:
+    /// Space compiled into what is needed to convert its data
+    struct Node
+    {
+        enum Kind
+        {
+            NONE,
+            DISCRETE,
+            BOX,
+            TUPLE,
+            DICT,
+        };
+
+        Kind kind{NONE};
+        std::string name;
+        ns3_ai_gym::DataType dataType{ns3_ai_gym::NoDataType};
+        py::dtype dtype;
+        std::vector<py::ssize_t> shape;
+        std::size_t count{1};
+        std::vector<Node> elements;
+        py::object frame; ///< last observation array, with delta encoding
+    };
+
+    /// Spaces of an agent
+    struct Agent
+    {
+        Node obs;
+        Node act;
+    };
+
+    static void CompileSpace(const py::bytes& space, Node& node);
+    static void CompileSpace(const ns3_ai_gym::SpaceV2& space, Node& node);
+    py::tuple DecodeStateMsg(MsgInterface& msgInterface,
+                             const ns3_ai_gym::EnvStateMsg& state,
+                             Node& obsNode);
+    py::object DecodeData(MsgInterface& msgInterface, const ns3_ai_gym::DataV2& data, Node& node);
+    py::object DecodeBox(MsgInterface& msgInterface,
+                         const ns3_ai_gym::BoxDataV2& box,
+                         Node& node);
+    void FillData(py::handle actions, const Node& node, ns3_ai_gym::DataV2* data);
+
+    Node m_obsNode;
+    Node m_actNode;
+    std::map<uint32_t, Agent> m_agents;
+    bool m_delta;
+    py::object m_asContiguous; ///< numpy.ascontiguousarray
+    py::object m_stats;        ///< serialized ProfileStats not taken yet, or None
+    py::object m_sparseFactory; ///< builds sparse Box observations, or None
+    // messages reused across steps, so that their fields keep their buffers
+    ns3_ai_gym::EnvStateMsg m_stateMsg;
+    ns3_ai_gym::EnvStateBatchMsg m_stateBatchMsg;
+    ns3_ai_gym::EnvActMsg m_actMsg;
+    ns3_ai_gym::EnvActBatchMsg m_actBatchMsg;
+};
+
+#endif // NS3AI_GYM_PY_CODEC_H
@@ -17,6 +17,8 @@
  * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
  */
 
+#include "gym_py_codec.h"
+
 #include <ns3/ai-module.h>
 
 #include <pybind11/pybind11.h>
@@ -26,6 +28,7 @@ namespace py = pybind11;
 PYBIND11_MODULE(ns3ai_gym_msg_py, m)
 {
     m.attr("msg_buffer_size") = MSG_BUFFER_SIZE;
+    m.attr("flat_data_offset") = NS3AI_GYM_FLAT_DATA_OFFSET;
 
     py::class_<Ns3AiGymMsg>(m, "Ns3AiGymMsg")
         .def(py::init<>())
@@ -53,10 +56,43 @@ PYBIND11_MODULE(ns3ai_gym_msg_py, m)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PySendEnd)
+        .def("PyCheckAttached",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyCheckAttached)
+        .def("PyResetSync",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyResetSync)
         .def("GetCpp2PyStruct",
              &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetCpp2PyStruct,
              py::return_value_policy::reference)
         .def("GetPy2CppStruct",
              &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetPy2CppStruct,
-             py::return_value_policy::reference);
+             py::return_value_policy::reference)
+        .def("GetPayload",
+             [](ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>& msgInterface,
+                uint64_t handle,
+                uint32_t size) {
+                 // Get memoryview of a payload in the shared memory segment
+                 return py::memoryview::from_memory(msgInterface.GetPayloadAddress(handle), size);
+             });
+
+    py::class_<Ns3AiGymCodec>(m, "Ns3AiGymCodec")
+        .def(py::init<const py::bytes&, const py::bytes&, bool>())
+        .def("decode_state", &Ns3AiGymCodec::DecodeState)
+        .def("encode_action",
+             &Ns3AiGymCodec::EncodeAction,
+             py::arg("buffer"),
+             py::arg("actions"),
+             py::arg("stopSimReq"),
+             py::arg("obsFields") = py::none(),
+             py::arg("resetReq") = false)
+        .def("take_stats", &Ns3AiGymCodec::TakeStats)
+        .def("set_sparse_factory", &Ns3AiGymCodec::SetSparseFactory)
+        .def("add_agent", &Ns3AiGymCodec::AddAgent)
+        .def("decode_states", &Ns3AiGymCodec::DecodeStates)
+        .def("encode_actions",
+             &Ns3AiGymCodec::EncodeActions,
+             py::arg("buffer"),
+             py::arg("actions"),
+             py::arg("stopSimReq"),
+             py::arg("obsFields") = py::none(),
+             py::arg("resetReq") = false);
 }
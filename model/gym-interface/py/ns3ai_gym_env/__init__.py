@@ -1,4 +1,6 @@
 from gymnasium.envs.registration import register
+from ns3ai_gym_env.envs import (Ns3MultiAgentEnv, Ns3VecEnv, run_agent, read_trajectory,
+                                VariableColumn)
 
 register(
     id="ns3ai_gym_env/Ns3-v0",
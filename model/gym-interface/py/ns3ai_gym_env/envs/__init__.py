@@ -1 +1,4 @@
-from ns3ai_gym_env.envs.ns3_environment import Ns3Env
+from ns3ai_gym_env.envs.ns3_environment import Ns3Env, run_agent
+from ns3ai_gym_env.envs.ns3_multi_agent_environment import Ns3MultiAgentEnv
+from ns3ai_gym_env.envs.ns3_vec_environment import Ns3VecEnv
+from ns3ai_gym_env.envs.trajectory import read_trajectory, VariableColumn
@@ -1,3 +1,4 @@
+import struct
 import numpy as np
 import gymnasium as gym
 from gymnasium import spaces
@@ -5,9 +6,103 @@ import messages_pb2 as pb
 import ns3ai_gym_msg_py as py_binding
 from ns3ai_utils import Experiment
 
+# highest Gym protocol version supported by this side
+PROTOCOL_VERSION = 2
+
+# element types of v2 Box data
+_DTYPES_V2 = {
+    pb.INT8: np.int8,
+    pb.INT16: np.int16,
+    pb.INT32: np.int32,
+    pb.INT64: np.int64,
+    pb.UINT8: np.uint8,
+    pb.UINT16: np.uint16,
+    pb.UINT32: np.uint32,
+    pb.UINT64: np.uint64,
+    pb.FLOAT16: np.float16,
+    pb.FLOAT32: np.float32,
+    pb.FLOAT64: np.float64,
+    pb.BOOL: np.bool_,
+}
+
+# headers of the flat layout, see Ns3AiGymFlatState and Ns3AiGymFlatAction
+_FLAT_STATE = struct.Struct('=fBBHII')
+_FLAT_ACTION = struct.Struct('=BBB')
+
+
+def create_space_v2(spacePb):
+    kind = spacePb.WhichOneof('space')
+    if kind == 'discrete':
+        return spaces.Discrete(spacePb.discrete.n)
+
+    if kind == 'box':
+        boxPb = spacePb.box
+        # the bounds are sent as double, so that they are exact for float64
+        # spaces and for integers up to 2**53
+        low = np.asarray(boxPb.low, dtype=np.float64)
+        high = np.asarray(boxPb.high, dtype=np.float64)
+        low = low[0] if low.size == 1 else low
+        high = high[0] if high.size == 1 else high
+        return spaces.Box(low=low, high=high, shape=tuple(boxPb.shape),
+                          dtype=_DTYPES_V2.get(boxPb.dtype, np.float32))
+
+    if kind == 'tuple':
+        return spaces.Tuple(tuple(create_space_v2(e) for e in spacePb.tuple.element))
+
+    if kind == 'dict':
+        return spaces.Dict({e.name: create_space_v2(e) for e in spacePb.dict.element})
+
+    return None
+
+
+def mask_space(space, fields):
+    # Dict space of the requested lazy observation fields, all of them if none
+    if not fields or not isinstance(space, spaces.Dict):
+        return space
+    return spaces.Dict({name: space[name] for name in fields if name in space.spaces})
+
+
+def check_obs_fields(fields, names):
+    unknown = [name for name in fields or [] if name not in names]
+    if unknown:
+        raise ValueError('Unknown observation fields: %s' % ', '.join(unknown))
+
+
+def sparse_factory(sparseFormat):
+    # builds sparse Box observations from the row-major indices and the values of their
+    # nonzero elements, see Ns3AiGymCodec.set_sparse_factory, None for dense arrays. The
+    # libraries are imported on the first sparse observation, so they stay optional
+    if sparseFormat is None:
+        return None
+
+    if sparseFormat == 'scipy':
+        def scipy_factory(index, values, shape):
+            from scipy import sparse
+            return sparse.coo_array((values, np.unravel_index(index, shape)), shape=shape)
+        return scipy_factory
+
+    if sparseFormat == 'torch':
+        def torch_factory(index, values, shape):
+            import torch
+            coords = np.stack(np.unravel_index(index.astype(np.int64), shape))
+            return torch.sparse_coo_tensor(torch.from_numpy(coords), torch.from_numpy(values),
+                                           shape)
+        return torch_factory
+
+    raise ValueError("Unknown sparse format '%s', use 'scipy', 'torch' or None" % sparseFormat)
+
+
+def decode_stats(statsPb):
+    # {phase: {'count', 'totalNs', 'minNs', 'maxNs', 'histogram'}} of a ProfileStats
+    return {phase.name: {'count': phase.count,
+                         'totalNs': phase.totalNs,
+                         'minNs': phase.minNs,
+                         'maxNs': phase.maxNs,
+                         'histogram': list(phase.histogram)}
+            for phase in statsPb.phases}
+
 
 class Ns3Env(gym.Env):
-    _created = False
 
     def _create_space(self, spaceDesc):
         space = None
@@ -60,6 +155,9 @@ class Ns3Env(gym.Env):
 
         return space
 
+    def _create_space_v2(self, spacePb):
+        return create_space_v2(spacePb)
+
     def _create_data(self, dataContainerPb):
         if dataContainerPb.type == pb.Discrete:
             discreteContainerPb = pb.DiscreteDataContainer()
@@ -81,8 +179,7 @@ class Ns3Env(gym.Env):
             else:
                 data = boxContainerPb.floatData
 
-            # TODO: reshape using shape info
-            data = np.array(data)
+            data = np.array(data).reshape(boxContainerPb.shape)
             return data
 
         elif dataContainerPb.type == pb.Tuple:
@@ -116,12 +213,68 @@ class Ns3Env(gym.Env):
         simInitMsg.ParseFromString(request)
         self.msgInterface.PyRecvEnd()
 
-        self.action_space = self._create_space(simInitMsg.actSpace)
-        self.observation_space = self._create_space(simInitMsg.obsSpace)
+        # simulations without versioning send 0, which means v1
+        self.version = max(1, min(simInitMsg.version, self.maxVersion))
+        if self.version >= 2:
+            self.action_space = self._create_space_v2(simInitMsg.actSpaceV2)
+            self.observation_space = self._create_space_v2(simInitMsg.obsSpaceV2)
+        else:
+            self.action_space = self._create_space(simInitMsg.actSpace)
+            self.observation_space = self._create_space(simInitMsg.obsSpace)
+
+        # lazy observation fields, of which only the requested ones are evaluated
+        self.obsFieldNames = list(simInitMsg.obsFields)
+        self.fullObservationSpace = self.observation_space
+        try:
+            check_obs_fields(self.obsFields, self.obsFieldNames)
+            error = None
+        except ValueError as e:
+            error = e
+        self.observation_space = mask_space(self.fullObservationSpace, self.obsFields)
+        self.pendingObsFields = None
+        # whether a reset starts the next episode in the same simulation process
+        self.episodes = simInitMsg.episodes
+
+        # buffers of the following messages, allocated by the simulation
+        self.payload = self.version >= 2
+        if self.payload and simInitMsg.bufferSize:
+            self.stateBuffer = self.msgInterface.GetPayload(simInitMsg.stateBuffer.handle,
+                                                            simInitMsg.stateBuffer.size)
+            self.actBuffer = self.msgInterface.GetPayload(simInitMsg.actBuffer.handle,
+                                                          simInitMsg.actBuffer.size)
+        else:
+            self.stateBuffer = self.msgInterface.GetCpp2PyStruct().get_buffer_full()
+            self.actBuffer = self.msgInterface.GetPy2CppStruct().get_buffer_full()
+
+        # only the changed elements of Box observations
+        self.delta = self.useDelta and simInitMsg.delta and self.version >= 2
+
+        # raw bytes instead of protobuf, if both spaces are Boxes
+        self.flat = (self.useFlat and simInitMsg.flatLayout and self.version >= 2
+                     and isinstance(self.observation_space, spaces.Box)
+                     and isinstance(self.action_space, spaces.Box))
+        if self.flat:
+            self._map_flat_layout()
+
+        # v2 messages are decoded and encoded natively, following the spaces
+        self.codec = None
+        if self.version >= 2 and not self.flat:
+            self.codec = py_binding.Ns3AiGymCodec(simInitMsg.obsSpaceV2.SerializeToString(),
+                                                  simInitMsg.actSpaceV2.SerializeToString(),
+                                                  self.delta)
+            self.codec.set_sparse_factory(self.sparseFactory)
 
         reply = pb.SimInitAck()
         reply.done = True
-        reply.stopSimReq = False
+        # the simulation is stopped if the requested fields are unknown
+        reply.stopSimReq = error is not None
+        reply.version = self.version
+        reply.flatLayout = self.flat
+        reply.payload = self.payload
+        reply.delta = self.delta
+        reply.actionRepeat = self.actionRepeat
+        if self.obsFieldNames and self.obsFields:
+            reply.obsFields.fields.extend(self.obsFields)
         reply_str = reply.SerializeToString()
         assert len(reply_str) <= py_binding.msg_buffer_size
 
@@ -129,38 +282,150 @@ class Ns3Env(gym.Env):
         self.msgInterface.GetPy2CppStruct().size = len(reply_str)
         self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(reply_str)] = reply_str
         self.msgInterface.PySendEnd()
+        if error is not None:
+            raise error
+        return True
+
+    def _map_flat_layout(self):
+        # numpy views of the observation and action in the shared memory
+        offset = py_binding.flat_data_offset
+        obsSpace = self.observation_space
+        self.obsView = np.frombuffer(self.stateBuffer,
+                                     dtype=obsSpace.dtype, count=int(np.prod(obsSpace.shape)),
+                                     offset=offset).reshape(obsSpace.shape)
+        actSpace = self.action_space
+        self.actView = np.frombuffer(self.actBuffer,
+                                     dtype=actSpace.dtype, count=int(np.prod(actSpace.shape)),
+                                     offset=offset).reshape(actSpace.shape)
+
+    def _send_flat(self, stopSimReq, actions=None, resetReq=False):
+        self.msgInterface.PySendBegin()
+        msg = self.msgInterface.GetPy2CppStruct()
+        _FLAT_ACTION.pack_into(self.actBuffer, 0, stopSimReq, actions is not None, resetReq)
+        msg.size = py_binding.flat_data_offset
+        if actions is not None:
+            self.actView[...] = np.reshape(actions, self.actView.shape)
+            msg.size += self.actView.nbytes
+        self.msgInterface.PySendEnd()
+        self.newStateRx = False
         return True
 
+    def _rx_env_state_flat(self):
+        self.msgInterface.PyRecvBegin()
+        buffer = self.stateBuffer
+        reward, isGameOver, reason, statsSize, infoOffset, infoSize = \
+            _FLAT_STATE.unpack_from(buffer, 0)
+        # copy, since the view is overwritten by the next state
+        if self.obsOut is None:
+            self.obsData = self.obsView.copy()
+        else:
+            np.copyto(self.obsOut, self.obsView)
+            self.obsData = self.obsOut
+        self.extraInfo = bytes(buffer[infoOffset:infoOffset + infoSize]).decode()
+        if statsSize:
+            statsOffset = infoOffset + infoSize
+            self.stats = decode_stats(pb.ProfileStats.FromString(
+                bytes(buffer[statsOffset:statsOffset + statsSize])))
+        self.msgInterface.PyRecvEnd()
+
+        self.reward = reward
+        self.gameOver = bool(isGameOver)
+        self.gameOverReason = reason
+        return self.gameOver
+
     def send_close_command(self):
+        if self.flat:
+            return self._send_flat(True)
+        if self.codec:
+            return self._send_encoded(True)
+
         reply = pb.EnvActMsg()
         reply.stopSimReq = True
+        return self._send_msg(reply)
 
+    def _send_reset(self):
+        # ends the episode, or only acknowledges its final state
+        if self.flat:
+            return self._send_flat(False, resetReq=True)
+        if self.codec:
+            return self._send_encoded(False, resetReq=True)
+
+        reply = pb.EnvActMsg()
+        reply.resetReq = True
+        return self._send_msg(reply)
+
+    def _send_msg(self, reply):
         replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= py_binding.msg_buffer_size
+        if len(replyMsg) > len(self.actBuffer):
+            raise ValueError('Action message of %d bytes does not fit in the buffer of %d bytes'
+                             % (len(replyMsg), len(self.actBuffer)))
         self.msgInterface.PySendBegin()
         self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(replyMsg)] = replyMsg
+        self.actBuffer[:len(replyMsg)] = replyMsg
         self.msgInterface.PySendEnd()
 
         self.newStateRx = False
         return True
 
+    def _send_encoded(self, stopSimReq, actions=None, obsFields=None, resetReq=False):
+        if obsFields is not None:
+            obsFields = obsFields.SerializeToString()
+        self.msgInterface.PySendBegin()
+        # written straight into the buffer, ValueError if it does not fit
+        size = self.codec.encode_action(self.actBuffer, actions, stopSimReq, obsFields,
+                                        resetReq)
+        self.msgInterface.GetPy2CppStruct().size = size
+        self.msgInterface.PySendEnd()
+
+        self.newStateRx = False
+        return True
+
+    def _rx_env_state_encoded(self):
+        self.msgInterface.PyRecvBegin()
+        # out-of-band data is only valid until the end of receiving
+        (self.obsData, self.reward, self.gameOver, self.gameOverReason,
+         self.extraInfo) = self.codec.decode_state(self.msgInterface, self.stateBuffer,
+                                                   self.msgInterface.GetCpp2PyStruct().size)
+        self.msgInterface.PyRecvEnd()
+        stats = self.codec.take_stats()
+        if stats is not None:
+            self.stats = decode_stats(pb.ProfileStats.FromString(stats))
+        return self.gameOver
+
     def rx_env_state(self):
         if self.newStateRx:
             return
 
+        if self.flat:
+            if self._rx_env_state_flat() and not self.episodes:
+                self.send_close_command()
+            if not self.extraInfo:
+                self.extraInfo = {}
+            self.newStateRx = True
+            return
+
+        if self.codec:
+            if self._rx_env_state_encoded() and not self.episodes:
+                self.send_close_command()
+            if not self.extraInfo:
+                self.extraInfo = {}
+            self.newStateRx = True
+            return
+
         envStateMsg = pb.EnvStateMsg()
         self.msgInterface.PyRecvBegin()
-        request = self.msgInterface.GetCpp2PyStruct().get_buffer()
+        request = self.stateBuffer[:self.msgInterface.GetCpp2PyStruct().size]
         envStateMsg.ParseFromString(request)
-        self.msgInterface.PyRecvEnd()
-
         self.obsData = self._create_data(envStateMsg.obsData)
+        self.msgInterface.PyRecvEnd()
         self.reward = envStateMsg.reward
         self.gameOver = envStateMsg.isGameOver
         self.gameOverReason = envStateMsg.reason
+        if envStateMsg.HasField('stats'):
+            self.stats = decode_stats(envStateMsg.stats)
 
-        if self.gameOver:
+        # with episodes, the simulation waits for the reset
+        if self.gameOver and not self.episodes:
             self.send_close_command()
 
         self.extraInfo = envStateMsg.info
@@ -250,19 +515,32 @@ class Ns3Env(gym.Env):
         return dataContainer
 
     def send_actions(self, actions):
-        reply = pb.EnvActMsg()
+        if self.flat:
+            return self._send_flat(False, actions)
+        obsFields = self.pendingObsFields
+        self.pendingObsFields = None
+        if self.codec:
+            return self._send_encoded(False, actions, obsFields)
 
+        reply = pb.EnvActMsg()
         actionMsg = self._pack_data(actions, self.action_space)
         reply.actData.CopyFrom(actionMsg)
-
-        replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= py_binding.msg_buffer_size
-        self.msgInterface.PySendBegin()
-        self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(replyMsg)] = replyMsg
-        self.msgInterface.PySendEnd()
-        self.newStateRx = False
-        return True
+        if obsFields is not None:
+            reply.obsFields.CopyFrom(obsFields)
+        return self._send_msg(reply)
+
+    def set_obs_fields(self, fields):
+        """Request only the given lazy observation fields, None for all.
+
+        The request is sent with the next actions, and applies from the state
+        that follows them. observation_space is changed accordingly.
+        """
+        if not self.obsFieldNames:
+            raise ValueError('The simulation has no lazy observation fields')
+        check_obs_fields(fields, self.obsFieldNames)
+        self.obsFields = list(fields) if fields else None
+        self.observation_space = mask_space(self.fullObservationSpace, self.obsFields)
+        self.pendingObsFields = pb.FieldMask(fields=self.obsFields or [])
 
     def get_state(self):
         obs = self.get_obs()
@@ -271,12 +549,40 @@ class Ns3Env(gym.Env):
         extraInfo = {"info": self.get_extra_info()}
         return obs, reward, done, False, extraInfo
 
-    def __init__(self, targetName, ns3Path, ns3Settings=None, shmSize=4096):
-        if self._created:
-            raise Exception('Error: Ns3Env is singleton')
-        self._created = True
-        self.exp = Experiment(targetName, ns3Path, py_binding, shmSize=shmSize)
+    def __init__(self, targetName, ns3Path, ns3Settings=None, shmSize=1 << 20,
+                 protocolVersion=PROTOCOL_VERSION, flatLayout=True, deltaEncoding=True,
+                 actionRepeat=0, obsFields=None, segName='My Seg', forkServer=False, poolSize=0,
+                 sparseFormat='scipy'):
+        # environments with distinct segment names can run side by side, with a fork server,
+        # a reset forks the simulation at its checkpoint instead of launching it, and with a
+        # pool, it takes a simulation launched ahead
+        self.exp = Experiment(targetName, ns3Path, py_binding, shmSize=shmSize, segName=segName,
+                              forkServer=forkServer, poolSize=poolSize)
         self.ns3Settings = ns3Settings
+        # highest protocol version accepted, the simulation may offer less
+        self.maxVersion = protocolVersion
+        self.version = 1
+        # whether to accept the flat layout offered by the simulation
+        self.useFlat = flatLayout
+        self.flat = False
+        # whether the simulation's message buffers and out-of-band data are used
+        self.payload = False
+        self.stateBuffer = None
+        self.actBuffer = None
+        # whether to accept delta encoded observations, if enabled by the simulation
+        self.useDelta = deltaEncoding
+        self.delta = False
+        # steps between decisions, 0 to keep those of the simulation's ActionRepeat
+        self.actionRepeat = actionRepeat
+        # names of the lazy observation fields requested, None for all
+        self.obsFields = list(obsFields) if obsFields else None
+        self.obsFieldNames = []
+        self.fullObservationSpace = None
+        self.pendingObsFields = None
+        self.codec = None
+        self.episodes = False
+        # how observations in sparse Box spaces are returned, 'scipy', 'torch' or None for dense
+        self.sparseFactory = sparse_factory(sparseFormat)
 
         self.newStateRx = False
         self.obsData = None
@@ -284,6 +590,11 @@ class Ns3Env(gym.Env):
         self.gameOver = False
         self.gameOverReason = None
         self.extraInfo = None
+        # array the flat observation is copied into, a new one at every state if None
+        self.obsOut = None
+        # time spent in the phases of the exchanges, sent with the final state if the
+        # simulation profiles them (Profile attribute of OpenGymInterface), see decode_stats
+        self.stats = None
 
         self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True)
         self.initialize_env()
@@ -302,6 +613,16 @@ class Ns3Env(gym.Env):
             obs = self.get_obs()
             return obs, {}
 
+        if self.episodes:
+            # the simulation goes on with the next episode, from its first state
+            self.rx_env_state()
+            self._send_reset()
+            self.gameOver = False
+            self.gameOverReason = None
+            self.rx_env_state()
+            self.envDirty = False
+            return self.get_obs(), {}
+
         # not using self.exp.kill() here in order for semaphores to reset to initial state
         if not self.gameOver:
             self.rx_env_state()
@@ -315,7 +636,7 @@ class Ns3Env(gym.Env):
         self.gameOverReason = None
         self.extraInfo = None
 
-        self.msgInterface = self.exp.run(show_output=True)
+        self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True)
         self.initialize_env()
         # get first observations
         self.rx_env_state()
@@ -336,3 +657,22 @@ class Ns3Env(gym.Env):
         self.exp.kill()
         # destroy the message interface and its shared memory segment
         del self.exp
+
+
+def run_agent(get_action, targetName, ns3Path, ns3Settings=None, shmSize=1 << 20):
+    """Drive get_action(obs, reward, done, info) with Ns3Env until the episode is done.
+
+    This is the shared memory counterpart of the embedded agent: a module
+    defining get_action can be run by this function, or be loaded by the
+    simulation itself with the OpenGymInterface::EmbeddedAgent attribute.
+    """
+    env = Ns3Env(targetName, ns3Path, ns3Settings, shmSize)
+    try:
+        obs, info = env.reset()
+        reward = 0
+        done = False
+        while not done:
+            action = get_action(obs, reward, done, info)
+            obs, reward, done, _, info = env.step(action)
+    finally:
+        env.close()
@@ -0,0 +1,229 @@
+import messages_pb2 as pb
+import ns3ai_gym_msg_py as py_binding
+from ns3ai_utils import Experiment
+from ns3ai_gym_env.envs.ns3_environment import (create_space_v2, mask_space, check_obs_fields,
+                                                decode_stats, sparse_factory)
+
+
+class Ns3MultiAgentEnv:
+    """Environment of the agents registered with OpenGymEnv::SetAgentId.
+
+    It follows the PettingZoo parallel API: observations, actions, rewards and
+    infos are dicts keyed by agent ID. The simulation sends the states of the
+    agents notified at the same simulation time in one message, so a step only
+    returns the results of those agents, and they are the ones expected to act.
+    """
+
+    metadata = {'name': 'ns3ai_multi_agent_v0'}
+
+    def __init__(self, targetName, ns3Path, ns3Settings=None, shmSize=1 << 20, obsFields=None,
+                 segName='My Seg', forkServer=False, poolSize=0, sparseFormat='scipy'):
+        self.exp = Experiment(targetName, ns3Path, py_binding, shmSize=shmSize, segName=segName,
+                              forkServer=forkServer, poolSize=poolSize)
+        self.ns3Settings = ns3Settings
+        # all agents of the simulation, and those of the last states that are not done
+        self.possible_agents = []
+        self.agents = []
+        self.observation_spaces = {}
+        self.action_spaces = {}
+        # names of the lazy observation fields requested, None for all
+        self.obsFields = list(obsFields) if obsFields else None
+        self.obsFieldNames = []
+        self.fullObservationSpaces = {}
+        self.pendingObsFields = None
+        self.codec = None
+        # how observations in sparse Box spaces are returned, see Ns3Env
+        self.sparseFactory = sparse_factory(sparseFormat)
+        self.episodes = False
+        self.stateBuffer = None
+        self.actBuffer = None
+
+        self.states = {}
+        self.gameOver = False
+        # time spent in the phases of the exchanges, with the final states, see Ns3Env
+        self.stats = None
+
+        self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True)
+        self.initialize_env()
+        # get first observations
+        self.rx_env_states()
+        self.envDirty = False
+
+    def observation_space(self, agent):
+        return self.observation_spaces[agent]
+
+    def action_space(self, agent):
+        return self.action_spaces[agent]
+
+    def initialize_env(self):
+        simInitMsg = pb.SimInitMsg()
+        self.msgInterface.PyRecvBegin()
+        request = self.msgInterface.GetCpp2PyStruct().get_buffer()
+        simInitMsg.ParseFromString(request)
+        self.msgInterface.PyRecvEnd()
+
+        reply = pb.SimInitAck()
+        reply.done = True
+        if not simInitMsg.agents or simInitMsg.version < 2:
+            reply.stopSimReq = True
+            self._send_init_ack(reply)
+            raise RuntimeError('The simulation has no agents registered with SetAgentId, '
+                               'use Ns3Env')
+
+        # states and actions are decoded and encoded in the space of their agent
+        self.codec = py_binding.Ns3AiGymCodec(b'', b'', False)
+        self.codec.set_sparse_factory(self.sparseFactory)
+        self.possible_agents = []
+        for agentPb in simInitMsg.agents:
+            agent = agentPb.agentId
+            self.possible_agents.append(agent)
+            self.fullObservationSpaces[agent] = create_space_v2(agentPb.obsSpace)
+            self.action_spaces[agent] = create_space_v2(agentPb.actSpace)
+            self.codec.add_agent(agent, agentPb.obsSpace.SerializeToString(),
+                                 agentPb.actSpace.SerializeToString())
+
+        # lazy observation fields, by name across all agents
+        self.obsFieldNames = list(simInitMsg.obsFields)
+        try:
+            check_obs_fields(self.obsFields, self.obsFieldNames)
+        except ValueError:
+            reply.stopSimReq = True
+            self._send_init_ack(reply)
+            raise
+        self._mask_observation_spaces()
+        self.pendingObsFields = None
+        # whether a reset starts the next episode in the same simulation process
+        self.episodes = simInitMsg.episodes
+
+        # buffers of the following messages, allocated by the simulation
+        if simInitMsg.bufferSize:
+            self.stateBuffer = self.msgInterface.GetPayload(simInitMsg.stateBuffer.handle,
+                                                            simInitMsg.stateBuffer.size)
+            self.actBuffer = self.msgInterface.GetPayload(simInitMsg.actBuffer.handle,
+                                                          simInitMsg.actBuffer.size)
+        else:
+            self.stateBuffer = self.msgInterface.GetCpp2PyStruct().get_buffer_full()
+            self.actBuffer = self.msgInterface.GetPy2CppStruct().get_buffer_full()
+
+        reply.stopSimReq = False
+        reply.version = 2
+        reply.payload = True
+        reply.multiAgent = True
+        if self.obsFieldNames and self.obsFields:
+            reply.obsFields.fields.extend(self.obsFields)
+        self._send_init_ack(reply)
+        return True
+
+    def _send_init_ack(self, reply):
+        reply_str = reply.SerializeToString()
+        assert len(reply_str) <= py_binding.msg_buffer_size
+
+        self.msgInterface.PySendBegin()
+        self.msgInterface.GetPy2CppStruct().size = len(reply_str)
+        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(reply_str)] = reply_str
+        self.msgInterface.PySendEnd()
+
+    def _mask_observation_spaces(self):
+        for agent, space in self.fullObservationSpaces.items():
+            self.observation_spaces[agent] = mask_space(space, self.obsFields)
+
+    def set_obs_fields(self, fields):
+        """Request only the given lazy observation fields of all agents, None for all.
+
+        The request is sent with the next actions, and applies from the states
+        that follow them. The observation spaces are changed accordingly.
+        """
+        if not self.obsFieldNames:
+            raise ValueError('The simulation has no lazy observation fields')
+        check_obs_fields(fields, self.obsFieldNames)
+        self.obsFields = list(fields) if fields else None
+        self._mask_observation_spaces()
+        self.pendingObsFields = pb.FieldMask(fields=self.obsFields or [])
+
+    def _send(self, stopSimReq, actions=None, resetReq=False):
+        obsFields = None
+        if self.pendingObsFields is not None and not stopSimReq:
+            obsFields = self.pendingObsFields.SerializeToString()
+            self.pendingObsFields = None
+        self.msgInterface.PySendBegin()
+        # written straight into the buffer, ValueError if it does not fit
+        size = self.codec.encode_actions(self.actBuffer, actions, stopSimReq, obsFields,
+                                         resetReq)
+        self.msgInterface.GetPy2CppStruct().size = size
+        self.msgInterface.PySendEnd()
+        return True
+
+    def send_close_command(self):
+        return self._send(True)
+
+    def rx_env_states(self):
+        self.msgInterface.PyRecvBegin()
+        # out-of-band data is only valid until the end of receiving
+        self.states = self.codec.decode_states(self.msgInterface, self.stateBuffer,
+                                               self.msgInterface.GetCpp2PyStruct().size)
+        self.msgInterface.PyRecvEnd()
+        stats = self.codec.take_stats()
+        if stats is not None:
+            self.stats = decode_stats(pb.ProfileStats.FromString(stats))
+
+        # (obs, reward, isGameOver, reason, info) of every agent of the message
+        self.agents = [agent for agent, state in self.states.items() if not state[2]]
+        self.gameOver = any(state[2] and state[3] == pb.EnvStateMsg.SimulationEnd
+                            for state in self.states.values())
+        # with episodes, the simulation waits for the reset
+        if self.gameOver and not self.episodes:
+            self.send_close_command()
+
+    def get_state(self):
+        observations = {agent: state[0] for agent, state in self.states.items()}
+        rewards = {agent: state[1] for agent, state in self.states.items()}
+        terminations = {agent: state[2] for agent, state in self.states.items()}
+        truncations = {agent: False for agent in self.states}
+        infos = {agent: {'info': state[4]} for agent, state in self.states.items()}
+        return observations, rewards, terminations, truncations, infos
+
+    def step(self, actions):
+        self._send(False, actions)
+        self.rx_env_states()
+        self.envDirty = True
+        return self.get_state()
+
+    def reset(self, seed=None, options=None):
+        if not self.envDirty:
+            observations, _, _, _, infos = self.get_state()
+            return observations, infos
+
+        if self.episodes:
+            # the simulation goes on with the next episode, from its first states
+            self._send(False, resetReq=True)
+            self.gameOver = False
+            self.rx_env_states()
+            self.envDirty = False
+            observations, _, _, _, infos = self.get_state()
+            return observations, infos
+
+        # not using self.exp.kill() here in order for semaphores to reset to initial state
+        if not self.gameOver:
+            self.send_close_command()
+
+        self.msgInterface = None
+        self.states = {}
+        self.gameOver = False
+
+        self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True)
+        self.initialize_env()
+        # get first observations
+        self.rx_env_states()
+        self.envDirty = False
+
+        observations, _, _, _, infos = self.get_state()
+        return observations, infos
+
+    def render(self):
+        return
+
+    def close(self):
+        # environment is not needed anymore, so kill subprocess in a straightforward way
+        self.exp.kill()
+        # destroy the message interface and its shared memory segment
+        del self.exp
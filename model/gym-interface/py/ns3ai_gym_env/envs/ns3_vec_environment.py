@@ -0,0 +1,131 @@
+import os
+from copy import deepcopy
+import numpy as np
+from gymnasium import spaces
+from gymnasium.vector.utils import batch_space, concatenate, create_empty_array, iterate
+from ns3ai_gym_env.envs.ns3_environment import Ns3Env
+
+
+class Ns3VecEnv:
+    """N simulations of the same target, stepped together.
+
+    Every simulation runs in its own ns-3 process with its own shared memory
+    segment, so they advance in parallel between step_async and step_wait.
+    Observations, rewards, terminations and truncations are batched along a
+    new first axis. Environments that are done are reset in step_wait, and
+    their last observation is in infos['final_observation'].
+    """
+
+    metadata = {'autoreset_mode': 'same-step'}
+
+    def __init__(self, numEnvs, targetName, ns3Path, ns3Settings=None, shmSize=1 << 20,
+                 copy=True, **kwargs):
+        """ns3Settings is either shared by all simulations or a list of one per simulation,
+        e.g. to give them distinct RngRun. Other arguments are passed to Ns3Env.
+        """
+        if numEnvs < 1:
+            raise ValueError('Ns3VecEnv needs at least one environment')
+        if ns3Settings is None or isinstance(ns3Settings, dict):
+            ns3Settings = [ns3Settings] * numEnvs
+        if len(ns3Settings) != numEnvs:
+            raise ValueError('Ns3VecEnv needs one setting per environment')
+        self.num_envs = numEnvs
+        # observations are batched into dense arrays
+        kwargs.setdefault('sparseFormat', None)
+        # whether observations are returned as copies of the batch, which is reused
+        self.copy = copy
+
+        # segment names must be distinct across the processes of the host
+        prefix = 'ns3ai-%d-%x' % (os.getpid(), id(self))
+        self.envs = []
+        try:
+            for i, setting in enumerate(ns3Settings):
+                self.envs.append(Ns3Env(targetName, ns3Path, setting, shmSize,
+                                        segName='%s-%d' % (prefix, i), **kwargs))
+        except BaseException:
+            self.close()
+            raise
+
+        self.single_observation_space = self.envs[0].observation_space
+        self.single_action_space = self.envs[0].action_space
+        self.observation_space = batch_space(self.single_observation_space, numEnvs)
+        self.action_space = batch_space(self.single_action_space, numEnvs)
+
+        self.observations = create_empty_array(self.single_observation_space, numEnvs)
+        self.rewards = np.zeros(numEnvs, dtype=np.float64)
+        self.terminations = np.zeros(numEnvs, dtype=np.bool_)
+        self.truncations = np.zeros(numEnvs, dtype=np.bool_)
+        # flat observations are copied from the shared memory straight into the batch
+        self.inPlace = (isinstance(self.single_observation_space, spaces.Box)
+                        and all(env.flat for env in self.envs))
+        if self.inPlace:
+            for i, env in enumerate(self.envs):
+                env.obsOut = self.observations[i]
+                np.copyto(env.obsOut, env.obsData)
+        self.waiting = False
+
+    def _gather_observations(self):
+        if not self.inPlace:
+            concatenate(self.single_observation_space, [env.obsData for env in self.envs],
+                        self.observations)
+        return deepcopy(self.observations) if self.copy else self.observations
+
+    def _gather_infos(self):
+        return {'info': np.array([env.extraInfo for env in self.envs], dtype=object),
+                '_info': np.ones(self.num_envs, dtype=np.bool_)}
+
+    def reset(self, seed=None, options=None):
+        if self.waiting:
+            self.step_wait()
+        for env in self.envs:
+            env.reset()
+        return self._gather_observations(), self._gather_infos()
+
+    def step_async(self, actions):
+        if self.waiting:
+            raise RuntimeError('step_async called again before step_wait')
+        # every simulation runs as soon as it has its action
+        for env, action in zip(self.envs, iterate(self.action_space, actions)):
+            env.send_actions(action)
+            env.envDirty = True
+        self.waiting = True
+
+    def step_wait(self):
+        if not self.waiting:
+            raise RuntimeError('step_wait called without step_async')
+        self.waiting = False
+
+        finalObservations = np.full(self.num_envs, None, dtype=object)
+        finalInfos = np.full(self.num_envs, None, dtype=object)
+        done = np.zeros(self.num_envs, dtype=np.bool_)
+        for i, env in enumerate(self.envs):
+            env.rx_env_state()
+            self.rewards[i] = env.reward
+            self.terminations[i] = env.gameOver
+            if env.gameOver:
+                # the next episode starts in a new simulation
+                done[i] = True
+                finalObservations[i] = deepcopy(env.obsData)
+                finalInfos[i] = {'info': env.extraInfo}
+                env.reset()
+
+        infos = self._gather_infos()
+        if done.any():
+            infos['final_observation'] = finalObservations
+            infos['_final_observation'] = done
+            infos['final_info'] = finalInfos
+            infos['_final_info'] = done
+        return (self._gather_observations(), self.rewards.copy(), self.terminations.copy(),
+                self.truncations.copy(), infos)
+
+    def step(self, actions):
+        self.step_async(actions)
+        return self.step_wait()
+
+    def render(self):
+        return
+
+    def close(self):
+        for env in self.envs:
+            env.close()
+        self.envs = []
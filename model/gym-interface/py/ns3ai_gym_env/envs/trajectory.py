@@ -0,0 +1,87 @@
+import json
+import os
+import numpy as np
+
+
+class VariableColumn:
+    """Column of rows of variable size, e.g. serialized DataV2 or strings.
+
+    Row i is a memoryview of the bytes between the end offsets of rows i - 1
+    and i in <column>.idx.
+    """
+
+    def __init__(self, data, ends):
+        self.data = data
+        self.ends = ends
+
+    def __len__(self):
+        return len(self.ends)
+
+    def __getitem__(self, i):
+        if i < 0:
+            i += len(self.ends)
+        if not 0 <= i < len(self.ends):
+            raise IndexError('row %d out of range' % i)
+        begin = int(self.ends[i - 1]) if i else 0
+        return memoryview(self.data)[begin:int(self.ends[i])]
+
+
+def _map(path, dtype, count, shape=()):
+    if count == 0:
+        return np.zeros((0,) + shape, dtype=dtype)
+    return np.memmap(path, dtype=dtype, mode='r', shape=(count,) + shape)
+
+
+def _simulation_key(name):
+    # <segment>-<n>, in the order of the simulations of every segment
+    prefix, _, index = name.rpartition('-')
+    return (prefix, int(index)) if index.isdigit() else (name, -1)
+
+
+def read_trajectory(directory):
+    """Memory-map the columns of a trajectory written with OpenGymInterface::TrajectoryPath.
+
+    Every simulation writes its trajectory to its own subdirectory
+    <segment>-<n> of the path. Returns a list with the trajectory of every
+    simulation, by segment name and index, or of the one simulation if the
+    directory is such a subdirectory. A trajectory is a dict of the columns by
+    name: arrays shaped (rows,) + shape for fixed columns, and VariableColumn
+    for the others. The rows are those complete in every column, so a
+    trajectory cut by a crash is still read consistently.
+    """
+    if os.path.exists(os.path.join(directory, 'schema.json')):
+        return [_read_simulation(directory)]
+    names = [name for name in os.listdir(directory)
+             if os.path.exists(os.path.join(directory, name, 'schema.json'))]
+    return [_read_simulation(os.path.join(directory, name))
+            for name in sorted(names, key=_simulation_key)]
+
+
+def _read_simulation(directory):
+    with open(os.path.join(directory, 'schema.json')) as f:
+        schema = json.load(f)
+    if schema['version'] != 1:
+        raise ValueError('Unsupported trajectory version %d' % schema['version'])
+
+    columns = schema['columns']
+    rows = None
+    for column in columns:
+        name = os.path.join(directory, column['name'])
+        if column['variable']:
+            count = os.path.getsize(name + '.idx') // 8
+        else:
+            rowSize = np.dtype(column['dtype']).itemsize * int(np.prod(column['shape']))
+            count = os.path.getsize(name + '.bin') // rowSize
+        rows = count if rows is None else min(rows, count)
+
+    trajectory = {}
+    for column in columns:
+        name = os.path.join(directory, column['name'])
+        if column['variable']:
+            ends = _map(name + '.idx', np.uint64, rows)
+            data = _map(name + '.bin', np.uint8, int(ends[-1]) if rows else 0)
+            trajectory[column['name']] = VariableColumn(data, ends)
+        else:
+            trajectory[column['name']] = _map(name + '.bin', np.dtype(column['dtype']), rows,
+                                              tuple(column['shape']))
+    return trajectory
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_MSG_BATCHER_H
+#define NS3_AI_MSG_BATCHER_H
+
+#include "ns3-ai-msg-interface.h"
+
+#include <ns3/abort.h>
+#include <ns3/callback.h>
+#include <ns3/event-id.h>
+#include <ns3/simulator.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief A micro-batcher on top of the vector-based message interface.
+ *
+ * Requests submitted at the same simulation time are gathered and sent
+ * to Python as one vector message, so that Python can process them all
+ * at once. The i-th element of Python's reply vector answers the i-th
+ * request, and is passed to the callback given with that request before
+ * the simulation time advances.
+ */
+template <typename Cpp2PyMsgType, typename Py2CppMsgType>
+class Ns3AiMsgBatcher
+{
+  public:
+    /**
+     * Callback invoked with the reply to a request
+     */
+    typedef Callback<void, const Py2CppMsgType&> ReplyCallback;
+
+    Ns3AiMsgBatcher() = delete;
+
+    explicit Ns3AiMsgBatcher(Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType>* interface)
+        : m_interface(interface)
+    {
+    };
+
+    ~Ns3AiMsgBatcher()
+    {
+        m_flushEvent.Cancel();
+    };
+
+    /**
+     * Submit a request to the batch of current simulation time. The first
+     * request at a time schedules the flush, which runs after all the
+     * events already scheduled at that time.
+     */
+    void Submit(const Cpp2PyMsgType& request, ReplyCallback cb)
+    {
+        if (m_requests.empty())
+        {
+            m_flushEvent = Simulator::ScheduleNow(&Ns3AiMsgBatcher::Flush, this);
+        }
+        m_requests.push_back(request);
+        m_callbacks.push_back(cb);
+    };
+
+    /**
+     * Get the number of requests waiting for the next flush
+     */
+    uint32_t GetPendingCount() const
+    {
+        return m_requests.size();
+    };
+
+    /**
+     * Send all pending requests in one message, wait for the replies and
+     * invoke the callbacks. Normally called automatically.
+     */
+    void Flush()
+    {
+        if (m_requests.empty())
+        {
+            return;
+        }
+
+        // if Python has requested to stop, the pending requests are dropped
+        if (!m_interface->CppSendBegin())
+        {
+            m_requests.clear();
+            m_callbacks.clear();
+            return;
+        }
+        m_interface->GetCpp2PyVector()->assign(m_requests.begin(), m_requests.end());
+        m_interface->CppSendEnd();
+
+        if (!m_interface->CppRecvBegin())
+        {
+            m_requests.clear();
+            m_callbacks.clear();
+            return;
+        }
+        auto py2cppVector = m_interface->GetPy2CppVector();
+        NS_ABORT_MSG_IF(py2cppVector->size() != m_requests.size(),
+                        "Python replied " << py2cppVector->size() << " messages to a batch of "
+                                          << m_requests.size() << " requests");
+        m_replies.assign(py2cppVector->begin(), py2cppVector->end());
+        m_interface->CppRecvEnd();
+
+        // requests submitted by the callbacks go to a new batch
+        m_requests.clear();
+        std::vector<ReplyCallback> callbacks;
+        callbacks.swap(m_callbacks);
+        for (std::size_t i = 0; i < callbacks.size(); ++i)
+        {
+            callbacks[i](m_replies[i]);
+        }
+    };
+
+  private:
+    Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType>* m_interface;
+    std::vector<Cpp2PyMsgType> m_requests;
+    std::vector<ReplyCallback> m_callbacks;
+    std::vector<Py2CppMsgType> m_replies;
+    EventId m_flushEvent;
+};
+
+} // namespace ns3
+
+#endif // NS3_AI_MSG_BATCHER_H
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_MSG_CHANNEL_H
+#define NS3_AI_MSG_CHANNEL_H
+
+#include "ns3-ai-msg-interface.h"
+
+#include <ns3/abort.h>
+#include <ns3/callback.h>
+#include <ns3/event-id.h>
+#include <ns3/nstime.h>
+#include <ns3/simulator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief A message tagged with the ID of the request it belongs to
+ */
+template <typename MsgType>
+struct Ns3AiTaggedMsg
+{
+    uint64_t id;
+    MsgType msg;
+};
+
+/**
+ * \brief A request/response channel on top of the vector-based message
+ * interface.
+ *
+ * Unlike the message interface, which exchanges messages in turns, the
+ * channel lets C++ submit any number of tagged requests. Python may answer
+ * them in any order and in batches. C++ retrieves the responses by ID,
+ * either by polling or through a callback which is scheduled as an event.
+ * The vectors are used as queues guarded by locks, and the interface must
+ * be created with the vector enabled and with handle finish.
+ */
+template <typename ReqType, typename RespType>
+class Ns3AiMsgChannel
+{
+  public:
+    typedef Ns3AiMsgInterfaceImpl<Ns3AiTaggedMsg<ReqType>, Ns3AiTaggedMsg<RespType>> Interface;
+
+    /**
+     * Callback invoked with the ID of a request and its response
+     */
+    typedef Callback<void, uint64_t, const RespType&> ResponseCallback;
+
+    Ns3AiMsgChannel() = delete;
+
+    explicit Ns3AiMsgChannel(Interface* interface)
+        : m_interface(interface),
+          m_pollInterval(MicroSeconds(100)),
+          m_waitTimeout(0)
+    {
+    };
+
+    ~Ns3AiMsgChannel()
+    {
+        m_pollEvent.Cancel();
+    };
+
+    /**
+     * Sets the interval of the polling, which is scheduled automatically
+     * while there are requests waiting for a callback
+     */
+    void SetPollInterval(Time interval)
+    {
+        m_pollInterval = interval;
+    };
+
+    /**
+     * Sets the wall-clock time after which Wait gives up on Python and
+     * aborts the simulation, such as when the Python process has died.
+     * Zero (the default) waits without limit
+     */
+    void SetWaitTimeout(std::chrono::milliseconds timeout)
+    {
+        m_waitTimeout = timeout;
+    };
+
+    /**
+     * Submit a request whose response is retrieved with TryGet or Wait
+     */
+    void Submit(uint64_t id, const ReqType& req)
+    {
+        Submit(id, req, MakeNullCallback<void, uint64_t, const RespType&>());
+    };
+
+    /**
+     * Submit a request whose response is passed to the callback, in an
+     * event scheduled when the response is collected
+     */
+    void Submit(uint64_t id, const ReqType& req, ResponseCallback cb)
+    {
+        NS_ABORT_MSG_IF(m_outstanding.find(id) != m_outstanding.end() ||
+                            m_completed.find(id) != m_completed.end(),
+                        "Request " << id << " is already submitted");
+        m_outstanding[id] = cb;
+
+        m_interface->LockCpp2Py();
+        m_interface->GetCpp2PyVector()->push_back(Ns3AiTaggedMsg<ReqType>{id, req});
+        m_interface->UnlockCpp2Py();
+
+        if (!cb.IsNull() && m_pollEvent.IsExpired())
+        {
+            m_pollEvent = Simulator::Schedule(m_pollInterval, &Ns3AiMsgChannel::AutoPoll, this);
+        }
+    };
+
+    /**
+     * Collect the responses that Python has sent so far. Responses with
+     * a callback are scheduled to be delivered now, others are kept for
+     * TryGet and Wait. Returns the number of responses collected.
+     */
+    uint32_t Poll()
+    {
+        m_interface->LockPy2Cpp();
+        auto py2cppVector = m_interface->GetPy2CppVector();
+        m_responses.assign(py2cppVector->begin(), py2cppVector->end());
+        py2cppVector->clear();
+        m_interface->UnlockPy2Cpp();
+
+        for (const auto& resp : m_responses)
+        {
+            auto it = m_outstanding.find(resp.id);
+            NS_ABORT_MSG_IF(it == m_outstanding.end(),
+                            "Response to unknown request " << resp.id);
+            if (it->second.IsNull())
+            {
+                m_completed[resp.id] = resp.msg;
+            }
+            else
+            {
+                Simulator::ScheduleNow(&Ns3AiMsgChannel::Deliver, it->second, resp.id, resp.msg);
+            }
+            m_outstanding.erase(it);
+        }
+        return m_responses.size();
+    };
+
+    /**
+     * Get the response of a request submitted without callback, if it
+     * has arrived. The response is removed from the channel.
+     */
+    bool TryGet(uint64_t id, RespType& resp)
+    {
+        auto it = m_completed.find(id);
+        if (it == m_completed.end())
+        {
+            Poll();
+            it = m_completed.find(id);
+            if (it == m_completed.end())
+            {
+                return false;
+            }
+        }
+        resp = it->second;
+        m_completed.erase(it);
+        return true;
+    };
+
+    /**
+     * Block until the response of a request submitted without callback
+     * arrives. The response is removed from the channel. Returns false
+     * (and leaves resp unchanged) if Python has requested to stop the
+     * simulation. Polling backs off from spinning to yielding and then
+     * to short sleeps, so that a slow agent does not compete with a busy
+     * loop for the locks. Aborts when the timeout set with SetWaitTimeout
+     * expires
+     */
+    bool Wait(uint64_t id, RespType& resp)
+    {
+        NS_ABORT_MSG_IF(m_outstanding.find(id) == m_outstanding.end() &&
+                            m_completed.find(id) == m_completed.end(),
+                        "Waiting for unknown request " << id);
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::microseconds sleep(1);
+        for (uint32_t attempt = 0; !TryGet(id, resp); ++attempt)
+        {
+            if (m_interface->CppGetStopRequested())
+            {
+                return false;
+            }
+            NS_ABORT_MSG_IF(m_waitTimeout.count() > 0 &&
+                                std::chrono::steady_clock::now() - start > m_waitTimeout,
+                            "No response to request " << id << " from Python within "
+                                                      << m_waitTimeout.count() << " ms");
+            if (attempt < SPIN_ATTEMPTS)
+            {
+                continue;
+            }
+            if (attempt < SPIN_ATTEMPTS + YIELD_ATTEMPTS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min(sleep * 2, MAX_SLEEP);
+        }
+        return true;
+    };
+
+    /**
+     * Get the number of requests that are not answered yet
+     */
+    uint32_t GetOutstandingCount() const
+    {
+        return m_outstanding.size();
+    };
+
+  private:
+    static constexpr uint32_t SPIN_ATTEMPTS = 64;    ///< polls before yielding in Wait
+    static constexpr uint32_t YIELD_ATTEMPTS = 1024; ///< yielding polls before sleeping
+    static constexpr std::chrono::microseconds MAX_SLEEP{1000}; ///< longest sleep in Wait
+
+    static void Deliver(ResponseCallback cb, uint64_t id, RespType resp)
+    {
+        cb(id, resp);
+    };
+
+    void AutoPoll()
+    {
+        Poll();
+        for (const auto& it : m_outstanding)
+        {
+            if (!it.second.IsNull())
+            {
+                m_pollEvent =
+                    Simulator::Schedule(m_pollInterval, &Ns3AiMsgChannel::AutoPoll, this);
+                break;
+            }
+        }
+    };
+
+    Interface* m_interface;
+    Time m_pollInterval;
+    std::chrono::milliseconds m_waitTimeout;
+    EventId m_pollEvent;
+    std::map<uint64_t, ResponseCallback> m_outstanding; ///< requests not answered yet
+    std::map<uint64_t, RespType> m_completed;           ///< responses not retrieved yet
+    std::vector<Ns3AiTaggedMsg<RespType>> m_responses;
+};
+
+} // namespace ns3
+
+#endif // NS3_AI_MSG_CHANNEL_H
@@ -22,11 +22,14 @@
 
 #include "ns3-ai-semaphore.h"
 
+#include <ns3/abort.h>
 #include <ns3/singleton.h>
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <string>
 #include <vector>
 #include <boost/interprocess/allocators/allocator.hpp>
@@ -36,6 +39,25 @@
 namespace ns3
 {
 
+/**
+ * \brief Flags in the control lane of msg interface
+ */
+enum Ns3AiCtrlFlag : uint8_t
+{
+    NS3AI_CTRL_FINISHED = 1 << 0, ///< C++ to Python: simulation is over
+    NS3AI_CTRL_STOP = 1 << 1,     ///< Python to C++: stop the simulation
+    NS3AI_CTRL_ATTACHED = 1 << 2, ///< C++ to Python: simulation attached to the segment
+};
+
+/**
+ * \brief A control message: a code with a value, such as a hyperparameter
+ */
+struct Ns3AiCtrlMsg
+{
+    int32_t code;
+    double value;
+};
+
 /**
  * \brief Structure containing semaphores used in msg interface
  */
@@ -45,7 +67,21 @@ struct Ns3AiMsgSync
     volatile uint8_t m_cpp2pyFullCount{0};
     volatile uint8_t m_py2cppEmptyCount{1};
     volatile uint8_t m_py2cppFullCount{0};
-    bool m_isFinished{false};
+    // control lane, checked on every wait of the data channel
+    volatile uint8_t m_cpp2pyFlags{0};
+    volatile uint8_t m_py2cppFlags{0};
+    volatile uint8_t m_cpp2pyCtrlFullCount{0};
+    volatile uint8_t m_py2cppCtrlFullCount{0};
+    Ns3AiCtrlMsg m_cpp2pyCtrl{0, 0.0};
+    Ns3AiCtrlMsg m_py2cppCtrl{0, 0.0};
+    // bookkeeping for staleness of actions (used in async mode)
+    volatile uint64_t m_cpp2pySeq{0};   ///< sequence number of the latest C++ message
+    volatile int64_t m_cpp2pyStamp{0};  ///< time stamp of the latest C++ message
+    volatile uint64_t m_py2cppSeq{0};   ///< sequence number the latest Python reply answers
+    volatile int64_t m_py2cppStamp{0};  ///< time stamp the latest Python reply answers
+    // mutexes of the vectors (used by the request/response channel)
+    volatile uint8_t m_cpp2pyLock{1};
+    volatile uint8_t m_py2cppLock{1};
 };
 
 /**
@@ -64,22 +100,29 @@ class Ns3AiMsgInterfaceImpl
                                    const char* segment_name = "My Seg",
                                    const char* cpp2py_msg_name = "My Cpp to Python Msg",
                                    const char* py2cpp_msg_name = "My Python to Cpp Msg",
-                                   const char* lockable_name = "My Lockable")
+                                   const char* lockable_name = "My Lockable",
+                                   bool async = false)
         : m_isCreator(is_memory_creator),
           m_useVector(use_vector),
           m_handleFinish(handle_finish),
+          m_async(async),
           m_segName(segment_name),
-          m_isFinished(false)
+          m_isFinished(false),
+          m_cppSeq(0),
+          m_pySeq(0),
+          m_pyStamp(0)
     {
         using namespace boost::interprocess;
         if (m_isCreator)
         {
             shared_memory_object::remove(m_segName.c_str());
-            static managed_shared_memory segment(create_only, m_segName.c_str(), size);
+            m_segmentObject = managed_shared_memory(create_only, m_segName.c_str(), size);
+            managed_shared_memory& segment = m_segmentObject;
+            m_segment = &segment;
             if (m_useVector)
             {
-                static const Cpp2PyMsgAllocator alloc_env(segment.get_segment_manager());
-                static const Cpp2PyMsgAllocator alloc_act(segment.get_segment_manager());
+                const Cpp2PyMsgAllocator alloc_env(segment.get_segment_manager());
+                const Py2CppMsgAllocator alloc_act(segment.get_segment_manager());
                 m_cpp2pyVector = segment.construct<Cpp2PyMsgVector>(cpp2py_msg_name)(alloc_env);
                 m_py2cppVector = segment.construct<Py2CppMsgVector>(py2cpp_msg_name)(alloc_act);
                 m_cpp2pyStruct = nullptr;
@@ -96,7 +139,9 @@ class Ns3AiMsgInterfaceImpl
         }
         else
         {
-            static managed_shared_memory segment(open_only, segment_name);
+            m_segmentObject = managed_shared_memory(open_only, segment_name);
+            managed_shared_memory& segment = m_segmentObject;
+            m_segment = &segment;
             if (m_useVector)
             {
                 m_cpp2pyVector = segment.find<Cpp2PyMsgVector>(cpp2py_msg_name).first;
@@ -112,6 +157,8 @@ class Ns3AiMsgInterfaceImpl
                 m_py2CppStruct = segment.find<Py2CppMsgType>(py2cpp_msg_name).first;
             }
             m_sync = segment.find<Ns3AiMsgSync>(lockable_name).first;
+            // tells the launcher that the simulation is ready, instead of a fixed delay
+            Ns3AiSemaphore::atomic_or8(&m_sync->m_cpp2pyFlags, NS3AI_CTRL_ATTACHED);
         }
     };
 
@@ -187,29 +234,65 @@ class Ns3AiMsgInterfaceImpl
 
     /**
      * C++ side starts writing into shared memory, struct-based
-     * or vector-based
+     * or vector-based. Returns false (and nothing must be written)
+     * if Python has requested to stop
      */
-    void CppSendBegin()
+    bool CppSendBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2pyEmptyCount);
+        return Ns3AiSemaphore::sem_wait_unless(&m_sync->m_cpp2pyEmptyCount,
+                                               &m_sync->m_py2cppFlags,
+                                               NS3AI_CTRL_STOP);
     };
 
     /**
      * C++ side stops writing into shared memory, struct-based
-     * or vector-based
+     * or vector-based. The optional stamp (normally the simulation
+     * time in time steps) is echoed back with Python's reply, see
+     * CppGetReplyStamp
      */
-    void CppSendEnd()
+    void CppSendEnd(int64_t stamp = 0)
     {
+        m_sync->m_cpp2pySeq = ++m_cppSeq;
+        m_sync->m_cpp2pyStamp = stamp;
         Ns3AiSemaphore::sem_post(&m_sync->m_cpp2pyFullCount);
     };
 
+    /**
+     * Async mode only. C++ side tries to start writing into shared
+     * memory without blocking. If Python has not yet picked up the
+     * previous message, that message is stale and is overwritten.
+     * Returns false if Python is reading the previous message right
+     * now, in which case nothing must be written and CppSendEnd must
+     * not be called
+     */
+    bool CppTrySendBegin()
+    {
+        NS_ABORT_MSG_UNLESS(m_async, "CppTrySendBegin is only available in async mode");
+        return Ns3AiSemaphore::sem_try_wait(&m_sync->m_cpp2pyEmptyCount) ||
+               Ns3AiSemaphore::sem_try_wait(&m_sync->m_cpp2pyFullCount);
+    };
+
     /**
      * C++ side starts reading from shared memory, struct-based
-     * or vector-based
+     * or vector-based. Returns false (and nothing must be read)
+     * if Python has requested to stop
      */
-    void CppRecvBegin()
+    bool CppRecvBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cppFullCount);
+        return Ns3AiSemaphore::sem_wait_unless(&m_sync->m_py2cppFullCount,
+                                               &m_sync->m_py2cppFlags,
+                                               NS3AI_CTRL_STOP);
+    };
+
+    /**
+     * Async mode only. C++ side tries to start reading from shared
+     * memory without blocking. Returns true if a new reply from Python
+     * is available, in which case CppRecvEnd must be called after reading
+     */
+    bool CppTryRecvBegin()
+    {
+        NS_ABORT_MSG_UNLESS(m_async, "CppTryRecvBegin is only available in async mode");
+        return Ns3AiSemaphore::sem_try_wait(&m_sync->m_py2cppFullCount);
     };
 
     /**
@@ -221,32 +304,96 @@ class Ns3AiMsgInterfaceImpl
         Ns3AiSemaphore::sem_post(&m_sync->m_py2cppEmptyCount);
     };
 
+    /**
+     * C++ side gets the staleness of the latest reply from Python, i.e.,
+     * how many messages C++ has sent after the one the reply answers.
+     * Always 0 in blocking mode. Call between CppRecvBegin and CppRecvEnd
+     */
+    uint64_t CppGetReplyStaleness()
+    {
+        return m_cppSeq - m_sync->m_py2cppSeq;
+    };
+
+    /**
+     * C++ side gets the stamp given to CppSendEnd for the message which
+     * the latest reply from Python answers. Call between CppRecvBegin
+     * and CppRecvEnd
+     */
+    int64_t CppGetReplyStamp()
+    {
+        return m_sync->m_py2cppStamp;
+    };
+
     /**
      * C++ side sets the overall status to finished when
-     * the simulation is over
+     * the simulation is over. It is signalled in the control lane,
+     * so it never waits for Python
      */
     void CppSetFinished()
     {
         assert(m_handleFinish);
         m_isFinished = true;
-        CppSendBegin();
-        m_sync->m_isFinished = true;
-        CppSendEnd();
+        Ns3AiSemaphore::atomic_or8(&m_sync->m_cpp2pyFlags, NS3AI_CTRL_FINISHED);
+    };
+
+    /**
+     * C++ side gets whether Python has requested to stop the simulation
+     */
+    bool CppGetStopRequested()
+    {
+        return Ns3AiSemaphore::atomic_read8(&m_sync->m_py2cppFlags) & NS3AI_CTRL_STOP;
+    };
+
+    /**
+     * C++ side sends a control message to Python. It does not wait
+     * behind data transfers. Returns false if Python has not received
+     * the previous control message yet
+     */
+    bool CppSendControl(int32_t code, double value)
+    {
+        if (Ns3AiSemaphore::atomic_read8(&m_sync->m_cpp2pyCtrlFullCount))
+        {
+            return false;
+        }
+        m_sync->m_cpp2pyCtrl = Ns3AiCtrlMsg{code, value};
+        Ns3AiSemaphore::sem_post(&m_sync->m_cpp2pyCtrlFullCount);
+        return true;
+    };
+
+    /**
+     * C++ side receives a control message from Python, if there is one
+     */
+    bool CppRecvControl(int32_t& code, double& value)
+    {
+        if (!Ns3AiSemaphore::atomic_read8(&m_sync->m_py2cppCtrlFullCount))
+        {
+            return false;
+        }
+        code = m_sync->m_py2cppCtrl.code;
+        value = m_sync->m_py2cppCtrl.value;
+        Ns3AiSemaphore::sem_try_wait(&m_sync->m_py2cppCtrlFullCount);
+        return true;
     };
 
     // for Python side:
 
     /**
      * Python side starts reading from shared memory, struct-based
-     * or vector-based
+     * or vector-based. Returns false (and nothing must be read) if
+     * the simulation is over, which is also reported by PyGetFinished
      */
-    void PyRecvBegin()
+    bool PyRecvBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2pyFullCount);
-        if (m_handleFinish)
+        if (!Ns3AiSemaphore::sem_wait_unless(&m_sync->m_cpp2pyFullCount,
+                                             &m_sync->m_cpp2pyFlags,
+                                             NS3AI_CTRL_FINISHED))
         {
-            m_isFinished = m_sync->m_isFinished;
+            m_isFinished = true;
+            return false;
         }
+        m_pySeq = m_sync->m_cpp2pySeq;
+        m_pyStamp = m_sync->m_cpp2pyStamp;
+        return true;
     };
 
     /**
@@ -260,19 +407,29 @@ class Ns3AiMsgInterfaceImpl
 
     /**
      * Python side starts writing into shared memory, struct-based
-     * or vector-based
+     * or vector-based. Returns false if the simulation is over
      */
-    void PySendBegin()
+    bool PySendBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cppEmptyCount);
+        if (!Ns3AiSemaphore::sem_wait_unless(&m_sync->m_py2cppEmptyCount,
+                                             &m_sync->m_cpp2pyFlags,
+                                             NS3AI_CTRL_FINISHED))
+        {
+            m_isFinished = true;
+            return false;
+        }
+        return true;
     };
 
     /**
      * Python side stops writing into shared memory, struct-based
-     * or vector-based
+     * or vector-based. The reply is marked as answering the message
+     * received last
      */
     void PySendEnd()
     {
+        m_sync->m_py2cppSeq = m_pySeq;
+        m_sync->m_py2cppStamp = m_pyStamp;
         Ns3AiSemaphore::sem_post(&m_sync->m_py2cppFullCount);
     };
 
@@ -285,6 +442,169 @@ class Ns3AiMsgInterfaceImpl
         return m_isFinished;
     };
 
+    /**
+     * Python side checks whether the simulation is over, without
+     * receiving a message first. Used when messages are not exchanged
+     * in turns, such as in the request/response channel
+     */
+    bool PyCheckFinished()
+    {
+        assert(m_handleFinish);
+        m_isFinished = Ns3AiSemaphore::atomic_read8(&m_sync->m_cpp2pyFlags) & NS3AI_CTRL_FINISHED;
+        return m_isFinished;
+    };
+
+    /**
+     * Python side checks whether the simulation has attached to the
+     * shared memory segment, i.e., whether it is ready to exchange messages
+     */
+    bool PyCheckAttached()
+    {
+        return Ns3AiSemaphore::atomic_read8(&m_sync->m_cpp2pyFlags) & NS3AI_CTRL_ATTACHED;
+    };
+
+    /**
+     * Python side resets the semaphores, flags and control messages of
+     * the segment, before the next simulation attaches to it. The
+     * previous simulation must be over, e.g. killed
+     */
+    void PyResetSync()
+    {
+        assert(m_isCreator);
+        *m_sync = Ns3AiMsgSync();
+        m_isFinished = false;
+        m_pySeq = 0;
+        m_pyStamp = 0;
+        m_pyCtrl = Ns3AiCtrlMsg{0, 0.0};
+    };
+
+    /**
+     * Python side requests C++ side to stop the simulation. Waits
+     * on C++ side return false afterwards
+     */
+    void PySetStop()
+    {
+        Ns3AiSemaphore::atomic_or8(&m_sync->m_py2cppFlags, NS3AI_CTRL_STOP);
+    };
+
+    /**
+     * Python side sends a control message to C++. It does not wait
+     * behind data transfers. Returns false if C++ has not received
+     * the previous control message yet
+     */
+    bool PySendControl(int32_t code, double value)
+    {
+        if (Ns3AiSemaphore::atomic_read8(&m_sync->m_py2cppCtrlFullCount))
+        {
+            return false;
+        }
+        m_sync->m_py2cppCtrl = Ns3AiCtrlMsg{code, value};
+        Ns3AiSemaphore::sem_post(&m_sync->m_py2cppCtrlFullCount);
+        return true;
+    };
+
+    /**
+     * Python side receives a control message from C++, if there is
+     * one. The message is then read by PyGetControlCode and
+     * PyGetControlValue
+     */
+    bool PyRecvControl()
+    {
+        if (!Ns3AiSemaphore::atomic_read8(&m_sync->m_cpp2pyCtrlFullCount))
+        {
+            return false;
+        }
+        m_pyCtrl = m_sync->m_cpp2pyCtrl;
+        Ns3AiSemaphore::sem_try_wait(&m_sync->m_cpp2pyCtrlFullCount);
+        return true;
+    };
+
+    /**
+     * Python side gets the code of the control message received last
+     */
+    int32_t PyGetControlCode()
+    {
+        return m_pyCtrl.code;
+    };
+
+    /**
+     * Python side gets the value of the control message received last
+     */
+    double PyGetControlValue()
+    {
+        return m_pyCtrl.value;
+    };
+
+    // for both sides, when the vectors are used as queues rather than
+    // exchanged in turns:
+
+    /**
+     * Locks the vector used in C++ to Python transmission
+     */
+    void LockCpp2Py()
+    {
+        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2pyLock);
+    };
+
+    /**
+     * Unlocks the vector used in C++ to Python transmission
+     */
+    void UnlockCpp2Py()
+    {
+        Ns3AiSemaphore::sem_post(&m_sync->m_cpp2pyLock);
+    };
+
+    /**
+     * Locks the vector used in Python to C++ transmission
+     */
+    void LockPy2Cpp()
+    {
+        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cppLock);
+    };
+
+    /**
+     * Unlocks the vector used in Python to C++ transmission
+     */
+    void UnlockPy2Cpp()
+    {
+        Ns3AiSemaphore::sem_post(&m_sync->m_py2cppLock);
+    };
+
+    // for both sides, for data not fitting in the messages:
+
+    /**
+     * Allocates a payload of the given size in the free space of the
+     * shared memory segment. Returns nullptr if the segment is full
+     */
+    void* AllocatePayload(std::size_t size)
+    {
+        return m_segment->allocate(size, std::nothrow);
+    };
+
+    /**
+     * Frees a payload allocated by AllocatePayload
+     */
+    void DeallocatePayload(void* payload)
+    {
+        m_segment->deallocate(payload);
+    };
+
+    /**
+     * Gets the handle of a payload, which identifies it on both sides
+     */
+    uint64_t GetPayloadHandle(const void* payload)
+    {
+        return m_segment->get_handle_from_address(payload);
+    };
+
+    /**
+     * Gets the address of a payload in this process from its handle
+     */
+    void* GetPayloadAddress(uint64_t handle)
+    {
+        return m_segment->get_address_from_handle(handle);
+    };
+
   private:
     Cpp2PyMsgType* m_cpp2pyStruct;
     Py2CppMsgType* m_py2CppStruct;
@@ -292,15 +612,25 @@ class Ns3AiMsgInterfaceImpl
     Py2CppMsgVector* m_py2cppVector;
 
     Ns3AiMsgSync* m_sync;
+    /// segment mapped by this interface, so that several interfaces map distinct segments
+    boost::interprocess::managed_shared_memory m_segmentObject;
+    boost::interprocess::managed_shared_memory* m_segment;
     const bool m_isCreator;
     const bool m_useVector;
     const bool m_handleFinish;
+    const bool m_async;
     const std::string m_segName;
     bool m_isFinished;
+    uint64_t m_cppSeq;   ///< number of messages sent by C++
+    uint64_t m_pySeq;    ///< sequence number of the message Python received last
+    int64_t m_pyStamp;   ///< stamp of the message Python received last
+    Ns3AiCtrlMsg m_pyCtrl{0, 0.0}; ///< control message Python received last
 };
 
 /**
- * \brief The message interface, a singleton class
+ * \brief The message interface, a singleton class. The setters configure
+ * the impl created by the first GetInterface call, and abort if they would
+ * change the configuration afterwards
  */
 
 class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
@@ -312,6 +642,8 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetIsMemoryCreator(bool isMemoryCreator)
     {
+        NS_ABORT_MSG_IF(m_interfaceCreated && isMemoryCreator != m_isMemoryCreator,
+                        "SetIsMemoryCreator has no effect after GetInterface");
         this->m_isMemoryCreator = isMemoryCreator;
     };
 
@@ -321,6 +653,8 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetUseVector(bool useVector)
     {
+        NS_ABORT_MSG_IF(m_interfaceCreated && useVector != m_useVector,
+                        "SetUseVector has no effect after GetInterface");
         this->m_useVector = useVector;
     };
 
@@ -330,9 +664,24 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetHandleFinish(bool handleFinish)
     {
+        NS_ABORT_MSG_IF(m_interfaceCreated && handleFinish != m_handleFinish,
+                        "SetHandleFinish has no effect after GetInterface");
         this->m_handleFinish = handleFinish;
     };
 
+    /**
+     * Sets if C++ side uses the asynchronous (non-blocking) mode, in
+     * which C++ publishes messages and collects replies with
+     * CppTrySendBegin and CppTryRecvBegin, never waiting for Python.
+     * Python side needs no change
+     */
+    void SetAsync(bool async)
+    {
+        NS_ABORT_MSG_IF(m_interfaceCreated && async != m_async,
+                        "SetAsync has no effect after GetInterface");
+        this->m_async = async;
+    };
+
     /**
      * Sets shared memory segment size, only valid for
      * the shared memory creator. Normally the default
@@ -340,25 +689,43 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetMemorySize(uint32_t size)
     {
+        NS_ABORT_MSG_IF(m_interfaceCreated && size != m_size,
+                        "SetMemorySize has no effect after GetInterface");
         this->m_size = size;
     };
 
     /**
      * Sets the names of the named objects. See Boost's
      * documentation for details. Normally the default
-     * names are OK.
+     * names are OK. The NS3AI_SEGMENT_NAME environment
+     * variable, if set, overrides the segment name.
      */
     void SetNames(std::string segmentName,
                   std::string cpp2pyMsgName,
                   std::string py2cppMsgName,
                   std::string lockableName)
     {
+        NS_ABORT_MSG_IF(m_interfaceCreated &&
+                            (segmentName != m_segmentName || cpp2pyMsgName != m_cpp2pyMsgName ||
+                             py2cppMsgName != m_py2cppMsgName || lockableName != m_lockableName),
+                        "SetNames has no effect after GetInterface");
         this->m_segmentName = segmentName;
         this->m_cpp2pyMsgName = cpp2pyMsgName;
         this->m_py2cppMsgName = py2cppMsgName;
         this->m_lockableName = lockableName;
     };
 
+    /**
+     * Gets the name of the segment, which the
+     * NS3AI_SEGMENT_NAME environment variable overrides
+     */
+    std::string GetSegmentName() const
+    {
+        // a launcher running several simulations gives each one its segment
+        const char* segmentName = std::getenv("NS3AI_SEGMENT_NAME");
+        return segmentName ? segmentName : this->m_segmentName;
+    };
+
     /**
      * Gets the impl which has semaphore (synchronization)
      * methods
@@ -371,10 +738,12 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
             this->m_useVector,
             this->m_handleFinish,
             this->m_size,
-            this->m_segmentName.c_str(),
+            GetSegmentName().c_str(),
             this->m_cpp2pyMsgName.c_str(),
             this->m_py2cppMsgName.c_str(),
-            this->m_lockableName.c_str());
+            this->m_lockableName.c_str(),
+            this->m_async);
+        m_interfaceCreated = true;
         return &interface;
     };
 
@@ -382,6 +751,8 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
     bool m_isMemoryCreator;
     bool m_useVector;
     bool m_handleFinish;
+    bool m_async = false;
+    bool m_interfaceCreated = false; ///< the impl exists, so settings can no longer change
     uint32_t m_size = 4096;
     std::string m_segmentName = "My Seg";
     std::string m_cpp2pyMsgName = "My Cpp to Python Msg";
@@ -46,6 +46,11 @@ struct Ns3AiSemaphore
         return __sync_fetch_and_add(const_cast<uint8_t*>(mem), val);
     }
 
+    static inline uint8_t atomic_or8(volatile uint8_t* mem, uint8_t val)
+    {
+        return __sync_fetch_and_or(const_cast<uint8_t*>(mem), val);
+    }
+
     static inline bool atomic_add_unless8(volatile uint8_t* mem, uint8_t value, uint8_t unless_this)
     {
         uint8_t old;
@@ -76,6 +81,24 @@ struct Ns3AiSemaphore
         }
     }
 
+    /**
+     * Waits on the semaphore unless any bit of the mask is set in flags.
+     * Returns false (without decrementing the semaphore) in the latter case.
+     */
+    static inline bool sem_wait_unless(volatile uint8_t* mem,
+                                       const volatile uint8_t* flags,
+                                       uint8_t mask)
+    {
+        while (!sem_try_wait(mem))
+        {
+            if (atomic_read8(flags) & mask)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     static inline uint8_t sem_post(volatile uint8_t* mem)
     {
         return atomic_add8(mem, 1);
@@ -18,6 +18,8 @@
 #         Muyuan Shen <muyuan_shen@hust.edu.cn>
 
 import os
+import re
+import runpy
 import subprocess
 import psutil
 import time
@@ -25,6 +27,13 @@ import signal
 
 
 SIMULATION_EARLY_ENDING = 0.5   # wait and see if the subprocess is running after creation
+ATTACH_POLL_INTERVAL = 0.001    # interval of the checks whether the simulation has attached
+RECV_SPIN_ATTEMPTS = 64         # polls of recv_requests before yielding
+RECV_YIELD_ATTEMPTS = 1024      # yielding polls before sleeping
+RECV_MAX_SLEEP = 0.001          # longest sleep of recv_requests
+
+# built programs of the ns-3 trees, by path
+_programs = {}
 
 
 def get_setting(setting_map):
@@ -34,23 +43,49 @@ def get_setting(setting_map):
     return ret
 
 
+# find the built program of a target, from the list written by ns3 at every build
+# \param[in] path : ns-3 root directory
+# \param[in] pname : target name, such as ns3ai_rltcp_gym or scratch/sim
+# \return absolute path of the program, or None if it is not found
+def find_ns3_program(path, pname):
+    path = os.path.abspath(path)
+    if path not in _programs:
+        try:
+            status = runpy.run_path(os.path.join(path, 'build', 'build-status.py'))
+            _programs[path] = status.get('ns3_runnable_programs', [])
+        except (OSError, SyntaxError):
+            _programs[path] = []
+    # programs are named ns3.<version>-<target>-<profile>, scratch ones by their file
+    name = re.compile(r'ns3[^-]*-{}(-[^-]+)?$'.format(re.escape(os.path.basename(pname))))
+    for program in _programs[path]:
+        if name.match(os.path.basename(program)) and os.access(program, os.X_OK):
+            return program
+    return None
+
+
 def run_single_ns3(path, pname, setting=None, env=None, show_output=False):
-    if env is None:
-        env = {}
-    env.update(os.environ)
+    # variables given here take precedence over those of this process
+    env = {**os.environ, **(env or {})}
     env['LD_LIBRARY_PATH'] = os.path.abspath(os.path.join(path, 'build', 'lib'))
-    # import pdb; pdb.set_trace()
-    exec_path = os.path.join(path, 'ns3')
-    if not setting:
-        cmd = '{} run {}'.format(exec_path, pname)
+    # the built program is run directly, without a shell and without the ns3 wrapper
+    # reconfiguring the build, which must then be up to date
+    program = find_ns3_program(path, pname)
+    if program:
+        args = [program] + ['--{}={}'.format(key, value) for key, value in (setting or {}).items()]
+        cmd = ' '.join(args)
     else:
-        cmd = '{} run {} --{}'.format(exec_path, pname, get_setting(setting))
+        exec_path = os.path.join(path, 'ns3')
+        if not setting:
+            cmd = '{} run {}'.format(exec_path, pname)
+        else:
+            cmd = '{} run {} --{}'.format(exec_path, pname, get_setting(setting))
+        args = cmd
     if show_output:
-        proc = subprocess.Popen(cmd, shell=True, text=True, env=env,
+        proc = subprocess.Popen(args, shell=not program, text=True, env=env,
                                 stdin=subprocess.PIPE,
                                 preexec_fn=os.setpgrp)
     else:
-        proc = subprocess.Popen(cmd, shell=True, text=True, env=env,
+        proc = subprocess.Popen(args, shell=not program, text=True, env=env,
                                 stdin=subprocess.PIPE,
                                 stdout=subprocess.PIPE,
                                 stderr=subprocess.PIPE,
@@ -59,6 +94,20 @@ def run_single_ns3(path, pname, setting=None, env=None, show_output=False):
     return cmd, proc
 
 
+# wait until the simulation has attached to the segment of the message interface
+# \return whether it has, False if the process ended before
+def wait_attached(msgInterface, proc):
+    # bindings without the attached flag fall back to a fixed delay
+    if not hasattr(msgInterface, 'PyCheckAttached'):
+        time.sleep(SIMULATION_EARLY_ENDING)
+        return proc.poll() is None
+    while not msgInterface.PyCheckAttached():
+        if proc.poll() is not None:
+            return False
+        time.sleep(ATTACH_POLL_INTERVAL)
+    return True
+
+
 # used to kill the ns-3 script process and its child processes
 def kill_proc_tree(p, timeout=None, on_terminate=None):
     print('ns3ai_utils: Killing subprocesses...')
@@ -92,8 +141,11 @@ def sigint_handler(sig, frame):
 
 
 # This class sets up the shared memory and runs the simulation process.
+# Experiments with distinct segment names can run side by side, since the
+# simulation attaches to the segment named by NS3AI_SEGMENT_NAME.
+# With a pool, simulations are launched ahead of the runs, and wait attached
+# to their own segments until a run takes them.
 class Experiment:
-    _created = False
 
     # init ns-3 environment
     # \param[in] memSize : share memory size
@@ -106,10 +158,9 @@ class Experiment:
                  segName="My Seg",
                  cpp2pyMsgName="My Cpp to Python Msg",
                  py2cppMsgName="My Python to Cpp Msg",
-                 lockableName="My Lockable"):
-        if self._created:
-            raise Exception('ns3ai_utils: Error: Experiment is singleton')
-        self._created = True
+                 lockableName="My Lockable",
+                 forkServer=False,
+                 poolSize=0):
         self.targetName = targetName  # ns-3 target name, not file name
         os.chdir(ns3Path)
         self.msgModule = msgModule
@@ -121,16 +172,21 @@ class Experiment:
         self.cpp2pyMsgName = cpp2pyMsgName
         self.py2cppMsgName = py2cppMsgName
         self.lockableName = lockableName
+        # whether the simulation is set up once, and forked for every run
+        self.forkServer = forkServer
+        self.episode = 0
+        # number of simulations launched ahead, as (setting, cmd, proc, msgInterface)
+        self.poolSize = poolSize
+        self.pool = []
 
-        self.msgInterface = msgModule.Ns3AiMsgInterfaceImpl(
-            True, self.useVector, self.handleFinish,
-            self.shmSize, self.segName, self.cpp2pyMsgName, self.py2cppMsgName, self.lockableName
-        )
-        if self.useVector:
-            if self.vectorSize is None:
-                raise Exception('ns3ai_utils: Error: Using vector but size is unknown')
-            self.msgInterface.GetCpp2PyVector().resize(self.vectorSize)
-            self.msgInterface.GetPy2CppVector().resize(self.vectorSize)
+        if self.useVector and self.vectorSize is None:
+            raise Exception('ns3ai_utils: Error: Using vector but size is unknown')
+        if self.forkServer and self.poolSize:
+            raise Exception('ns3ai_utils: Error: Fork server and pool are exclusive')
+        # in fork-server mode and with a pool, every episode has its own segment
+        self.msgInterface = None
+        if not forkServer and not poolSize:
+            self.msgInterface = self._create_interface(self.segName)
 
         self.proc = None
         self.simCmd = None
@@ -138,23 +194,111 @@ class Experiment:
 
     def __del__(self):
         self.kill()
+        self.drain_pool()
         del self.msgInterface
         print('ns3ai_utils: Experiment destroyed')
 
+    def _create_interface(self, segName):
+        msgInterface = self.msgModule.Ns3AiMsgInterfaceImpl(
+            True, self.useVector, self.handleFinish,
+            self.shmSize, segName, self.cpp2pyMsgName, self.py2cppMsgName, self.lockableName
+        )
+        if self.useVector:
+            msgInterface.GetCpp2PyVector().resize(self.vectorSize)
+            msgInterface.GetPy2CppVector().resize(self.vectorSize)
+        return msgInterface
+
+    # request an episode from the fork server, which forks a child at the
+    # checkpoint of the simulation (OpenGymInterface::Checkpoint)
+    def _fork_episode(self):
+        self.episode += 1
+        segName = '{}-{}'.format(self.segName, self.episode)
+        # the previous segment is removed, and the new one exists before the child attaches
+        self.msgInterface = None
+        self.msgInterface = self._create_interface(segName)
+        self.proc.stdin.write(segName + '\n')
+        self.proc.stdin.flush()
+        self._wait_attached()
+        return self.msgInterface
+
+    # launch a simulation attached to a new segment, for the pool
+    def _launch(self, setting, show_output):
+        self.episode += 1
+        segName = '{}-{}'.format(self.segName, self.episode)
+        msgInterface = self._create_interface(segName)
+        cmd, proc = run_single_ns3('./', self.targetName, setting=setting,
+                                   env={'NS3AI_SEGMENT_NAME': segName}, show_output=show_output)
+        return setting, cmd, proc, msgInterface
+
+    # take a simulation launched with the same setting from the pool, and refill it
+    def _run_from_pool(self, setting, show_output):
+        self.kill()
+        self.msgInterface = None
+        # simulations that died are neither taken nor counted, so they are replaced
+        self.pool = [entry for entry in self.pool if entry[2].poll() is None]
+        for i, (poolSetting, _, proc, _) in enumerate(self.pool):
+            if poolSetting == setting and proc.poll() is None:
+                _, self.simCmd, self.proc, self.msgInterface = self.pool.pop(i)
+                break
+        else:
+            _, self.simCmd, self.proc, self.msgInterface = self._launch(setting, show_output)
+        # the next runs are likely to use the same setting, the others are killed
+        self._kill_pool([entry for entry in self.pool if entry[0] != setting])
+        self.pool = [entry for entry in self.pool if entry[0] == setting]
+        while len(self.pool) < self.poolSize:
+            self.pool.append(self._launch(setting, show_output))
+        signal.signal(signal.SIGINT, sigint_handler)
+        self._wait_attached()
+        return self.msgInterface
+
+    # exit if an early error occurred, such as wrong target name
+    def _wait_attached(self):
+        if not wait_attached(self.msgInterface, self.proc):
+            print('ns3ai_utils: Subprocess died very early')
+            exit(1)
+
+    # kill the simulations of pool entries
+    def _kill_pool(self, entries):
+        for _, _, proc, _ in entries:
+            if proc.poll() is None:
+                kill_proc_tree(proc)
+
+    # kill the simulations of the pool
+    def drain_pool(self):
+        self._kill_pool(self.pool)
+        self.pool = []
+
     # run ns3 script in cmd with the setting being input
     # \param[in] setting : ns3 script input parameters(default : None)
     # \param[in] show_output : whether to show output or not(default : False)
+    # In fork-server mode, the setting only applies when the server is launched.
+    # With a pool, the simulation is taken from the pool if one was launched with the same
+    # setting, and the pool is refilled with simulations of that setting.
     def run(self, setting=None, show_output=False):
+        if self.poolSize:
+            return self._run_from_pool(setting, show_output)
+        if self.forkServer and self.proc and self.isalive():
+            return self._fork_episode()
         self.kill()
+        # the segment is reused, so the previous simulation must not leave its flags
+        # and semaphores to this one (the fork server and the pool use new segments)
+        if hasattr(self.msgInterface, 'PyResetSync'):
+            self.msgInterface.PyResetSync()
+        env = {'NS3AI_SEGMENT_NAME': self.segName}
+        if self.forkServer:
+            env['NS3AI_FORK_SERVER'] = '1'
         self.simCmd, self.proc = run_single_ns3(
-            './', self.targetName, setting=setting, show_output=show_output)
+            './', self.targetName, setting=setting, env=env, show_output=show_output)
         print("ns3ai_utils: Running ns-3 with: ", self.simCmd)
-        # exit if an early error occurred, such as wrong target name
-        time.sleep(SIMULATION_EARLY_ENDING)
-        if not self.isalive():
-            print('ns3ai_utils: Subprocess died very early')
-            exit(1)
         signal.signal(signal.SIGINT, sigint_handler)
+        if self.forkServer:
+            # the server does not attach, only its children do
+            time.sleep(SIMULATION_EARLY_ENDING)
+            if not self.isalive():
+                print('ns3ai_utils: Subprocess died very early')
+                exit(1)
+            return self._fork_episode()
+        self._wait_attached()
         return self.msgInterface
 
     def kill(self):
@@ -167,4 +311,62 @@ class Experiment:
         return self.proc.poll() is None
 
 
-__all__ = ['Experiment']
+# Python end of the request/response channel (Ns3AiMsgChannel in C++).
+# The message interface must be created with vector and handle finish
+# enabled, and its binding must expose the lock methods, PyCheckFinished
+# and tagged structs with `id` and `msg` members.
+class Ns3AiMsgChannel:
+
+    def __init__(self, msgInterface):
+        self.msgInterface = msgInterface
+
+    # take all pending requests. While blocking, polling backs off from spinning
+    # to yielding and then to short sleeps, as Wait does in C++, so that a slow
+    # simulation does not compete with a busy loop for the lock
+    # \param[in] extract : function converting a request struct to a Python value
+    # \param[in] block : whether to wait until there is at least one request
+    # \param[in] timeout : seconds after which a blocking call raises TimeoutError,
+    #                      None to wait without limit
+    # \return list of (id, value), or None if the simulation is over
+    def recv_requests(self, extract, block=True, timeout=None):
+        start = time.monotonic()
+        sleep = 1e-6
+        attempt = 0
+        while True:
+            if self.msgInterface.PyCheckFinished():
+                return None
+            self.msgInterface.LockCpp2Py()
+            reqVec = self.msgInterface.GetCpp2PyVector()
+            requests = [(reqVec[i].id, extract(reqVec[i].msg)) for i in range(len(reqVec))]
+            reqVec.resize(0)
+            self.msgInterface.UnlockCpp2Py()
+            if requests or not block:
+                return requests
+            if timeout is not None and time.monotonic() - start > timeout:
+                raise TimeoutError('ns3ai_utils: No request from the simulation within '
+                                   '{} s'.format(timeout))
+            attempt += 1
+            if attempt < RECV_SPIN_ATTEMPTS:
+                continue
+            if attempt < RECV_SPIN_ATTEMPTS + RECV_YIELD_ATTEMPTS:
+                os.sched_yield()
+                continue
+            time.sleep(sleep)
+            sleep = min(sleep * 2, RECV_MAX_SLEEP)
+
+    # answer requests, in any order
+    # \param[in] responses : iterable of (id, value)
+    # \param[in] fill : function writing a Python value into a response struct
+    def send_responses(self, responses, fill):
+        responses = list(responses)
+        self.msgInterface.LockPy2Cpp()
+        respVec = self.msgInterface.GetPy2CppVector()
+        n = len(respVec)
+        respVec.resize(n + len(responses))
+        for i, (reqId, value) in enumerate(responses):
+            respVec[n + i].id = reqId
+            fill(respVec[n + i].msg, value)
+        self.msgInterface.UnlockPy2Cpp()
+
+
+__all__ = ['Experiment', 'Ns3AiMsgChannel']
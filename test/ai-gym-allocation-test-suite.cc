@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/step-pipeline.h>
+#include <ns3/test.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// memory from the replaced operator new is released with free(), which is not a mismatch
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+using namespace ns3;
+
+namespace
+{
+
+std::atomic<uint64_t> g_allocations{0}; ///< calls of operator new in this process
+
+} // namespace
+
+// counts the allocations of the whole test runner, the other operators forward to these
+void*
+operator new(std::size_t size)
+{
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+/**
+ * \brief The allocations are counted at all
+ */
+class GymAllocationCounterTestCase : public TestCase
+{
+  public:
+    GymAllocationCounterTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymAllocationCounterTestCase::GymAllocationCounterTestCase()
+    : TestCase("Allocations are counted")
+{
+}
+
+void
+GymAllocationCounterTestCase::DoRun()
+{
+    uint64_t before = g_allocations;
+    // a direct call, which the compiler cannot elide as it may a new expression
+    void* volatile p = ::operator new(64);
+    ::operator delete(p);
+    NS_TEST_ASSERT_MSG_EQ(g_allocations - before, 1, "operator new is not replaced");
+}
+
+/**
+ * \brief A step of the v2 protocol in steady state does not allocate
+ *
+ * The state is encoded and serialized, and the reply decoded into the action
+ * container of the previous step, as OpenGymInterface does around the shared
+ * memory. Replies without an action, such as those answering a reset, are
+ * interleaved if asked.
+ */
+class GymSteadyStateAllocationTestCase : public TestCase
+{
+  public:
+    /**
+     * \param emptyEvery every how many steps the reply has no action, 0 for never
+     */
+    GymSteadyStateAllocationTestCase(uint32_t emptyEvery);
+
+  private:
+    void DoRun() override;
+
+    uint32_t m_emptyEvery;
+};
+
+GymSteadyStateAllocationTestCase::GymSteadyStateAllocationTestCase(uint32_t emptyEvery)
+    : TestCase(emptyEvery ? "No allocation in steady state, with replies without action"
+                          : "No allocation in steady state"),
+      m_emptyEvery(emptyEvery)
+{
+}
+
+void
+GymSteadyStateAllocationTestCase::DoRun()
+{
+    const uint32_t warmUpSteps = 4;
+    const uint32_t steps = 32;
+
+    OpenGymStepPipeline pipeline;
+    pipeline.SetProtocol(2, false, false);
+    pipeline.SetSteadyState(true);
+
+    auto obs = CreateObject<OpenGymBoxContainer<float>>(std::vector<uint32_t>{64});
+    OpenGymStepState state;
+    state.obs = obs;
+    state.extraInfo = "steady";
+
+    // the replies as Python serializes them
+    ns3_ai_gym::EnvActMsg reply;
+    ns3_ai_gym::BoxDataV2* box = reply.mutable_actdatav2()->mutable_box();
+    box->set_dtype(ns3_ai_gym::FLOAT32);
+    box->add_shape(8);
+    std::vector<float> actionData(8, 0.5);
+    box->set_data(actionData.data(), actionData.size() * sizeof(float));
+    std::string actionWire = reply.SerializeAsString();
+    std::string emptyWire = ns3_ai_gym::EnvActMsg().SerializeAsString();
+    std::vector<uint8_t> stateBuffer(4096);
+
+    for (uint32_t step = 0; step < steps; ++step)
+    {
+        bool empty = m_emptyEvery && step % m_emptyEvery == m_emptyEvery - 1;
+        const std::string& wire = empty ? emptyWire : actionWire;
+        uint64_t before = g_allocations;
+
+        obs->SetValue(step % 64, step);
+        state.reward = 1;
+        NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "Every state is a decision");
+        pipeline.Record(state);
+        NS_TEST_ASSERT_MSG_EQ(pipeline.LookupAction(state), nullptr, "The cache is disabled");
+        const ns3_ai_gym::EnvStateMsg& stateMsg = pipeline.EncodeState(state, nullptr);
+        std::size_t size = stateMsg.ByteSizeLong();
+        NS_TEST_ASSERT_MSG_LT(size, stateBuffer.size(), "The state fits in the buffer");
+        stateMsg.SerializeToArray(stateBuffer.data(), size);
+        pipeline.DecodeReply(reinterpret_cast<const uint8_t*>(wire.data()), wire.size());
+        Ptr<OpenGymDataContainer> action = pipeline.DecodeAction();
+        pipeline.AcceptAction(action, &pipeline.GetReply().actdatav2());
+
+        uint64_t allocations = g_allocations - before;
+        NS_TEST_ASSERT_MSG_EQ(!action, empty, "The reply has an action unless it is empty");
+        if (step >= warmUpSteps)
+        {
+            NS_TEST_EXPECT_MSG_EQ(allocations, 0, "Step " << step << " allocated");
+        }
+    }
+}
+
+/**
+ * \brief Tests of the allocations of the Gym interface
+ */
+class AiGymAllocationTestSuite : public TestSuite
+{
+  public:
+    AiGymAllocationTestSuite();
+};
+
+AiGymAllocationTestSuite::AiGymAllocationTestSuite()
+    : TestSuite("ai-gym-allocation", Type::UNIT)
+{
+    AddTestCase(new GymAllocationCounterTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymSteadyStateAllocationTestCase(0), TestCase::Duration::QUICK);
+    AddTestCase(new GymSteadyStateAllocationTestCase(3), TestCase::Duration::QUICK);
+}
+
+static AiGymAllocationTestSuite g_aiGymAllocationTestSuite; ///< the test suite
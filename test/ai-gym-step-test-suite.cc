@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/step-pipeline.h>
+#include <ns3/test.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace ns3;
+
+namespace
+{
+
+Ptr<OpenGymBoxContainer<float>>
+MakeBox(const std::vector<float>& values)
+{
+    auto box = CreateObject<OpenGymBoxContainer<float>>(
+        std::vector<uint32_t>{static_cast<uint32_t>(values.size())});
+    box->SetData(values);
+    return box;
+}
+
+Ptr<OpenGymDiscreteContainer>
+MakeDiscrete(uint32_t value)
+{
+    auto discrete = CreateObject<OpenGymDiscreteContainer>(10);
+    discrete->SetValue(value);
+    return discrete;
+}
+
+std::vector<float>
+ToFloats(const std::string& data)
+{
+    std::vector<float> values(data.size() / sizeof(float));
+    std::memcpy(values.data(), data.data(), data.size());
+    return values;
+}
+
+/**
+ * Apply the elements changed since the previous state to its data
+ */
+void
+ApplyDelta(const ns3_ai_gym::BoxDeltaV2& delta, std::vector<float>* values)
+{
+    std::vector<uint32_t> index(delta.index().size() / sizeof(uint32_t));
+    std::memcpy(index.data(), delta.index().data(), delta.index().size());
+    std::vector<float> changed = ToFloats(delta.values());
+    for (std::size_t i = 0; i < index.size(); ++i)
+    {
+        (*values)[index[i]] = changed[i];
+    }
+}
+
+/**
+ * Map a segment for the payload area. There is no Python side in the tests,
+ * so this process also creates the segment, and the message interface is
+ * configured as by OpenGymInterface.
+ */
+void
+CreatePayloadSegment()
+{
+    static Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg> creator(true,
+                                                                    false,
+                                                                    false,
+                                                                    1 << 16,
+                                                                    "ns3-ai-test-segment");
+    auto interface = Ns3AiMsgInterface::Get();
+    interface->SetIsMemoryCreator(false);
+    interface->SetUseVector(false);
+    interface->SetHandleFinish(false);
+    interface->SetNames("ns3-ai-test-segment",
+                        "My Cpp to Python Msg",
+                        "My Python to Cpp Msg",
+                        "My Lockable");
+    interface->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+}
+
+} // namespace
+
+/**
+ * \brief Stacked observations sent as deltas from one state to the next
+ */
+class GymStepDeltaStackTestCase : public TestCase
+{
+  public:
+    GymStepDeltaStackTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymStepDeltaStackTestCase::GymStepDeltaStackTestCase()
+    : TestCase("Delta encoding of stacked observations")
+{
+}
+
+void
+GymStepDeltaStackTestCase::DoRun()
+{
+    OpenGymStepPipeline pipeline;
+    pipeline.SetProtocol(2, true, false);
+    pipeline.GetDecimator().SetStack(2);
+    pipeline.GetDeltaEncoder().SetKeyframeInterval(100);
+
+    Ptr<OpenGymBoxContainer<float>> obs = MakeBox({1, 2, 3, 4});
+    OpenGymStepState state;
+    state.obs = obs;
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "Every stacked state is a decision");
+    const ns3_ai_gym::BoxDataV2& keyframe = pipeline.EncodeState(state, nullptr).obsdatav2().box();
+    NS_TEST_ASSERT_MSG_EQ(keyframe.has_delta(), false, "The first state is a keyframe");
+    NS_TEST_ASSERT_MSG_EQ(keyframe.shape_size(), 2, "Observations are stacked on a new axis");
+    NS_TEST_EXPECT_MSG_EQ(keyframe.shape(0), 2, "Two observations are stacked");
+    std::vector<float> received = ToFloats(keyframe.data());
+    std::vector<float> expected{1, 2, 3, 4, 1, 2, 3, 4};
+    NS_TEST_ASSERT_MSG_EQ((received == expected), true, "The first observation is repeated");
+
+    // the newest observation is the second one of the stack
+    obs->SetValue(2, 30);
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "Every stacked state is a decision");
+    const ns3_ai_gym::BoxDataV2& second = pipeline.EncodeState(state, nullptr).obsdatav2().box();
+    NS_TEST_ASSERT_MSG_EQ(second.has_delta(), true, "One changed element is sent as a delta");
+    NS_TEST_EXPECT_MSG_EQ(second.data().size(), 0, "A delta carries no full data");
+    NS_TEST_ASSERT_MSG_EQ(second.delta().index().size(), sizeof(uint32_t), "One element changed");
+    ApplyDelta(second.delta(), &received);
+    expected = {1, 2, 3, 4, 1, 2, 30, 4};
+    NS_TEST_ASSERT_MSG_EQ((received == expected), true, "The delta rebuilds the stack");
+
+    // shifting the history changes both halves of the stack
+    obs->SetValue(0, 10);
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "Every stacked state is a decision");
+    const ns3_ai_gym::BoxDataV2& third = pipeline.EncodeState(state, nullptr).obsdatav2().box();
+    NS_TEST_ASSERT_MSG_EQ(third.has_delta(), true, "Two changed elements are sent as a delta");
+    ApplyDelta(third.delta(), &received);
+    expected = {1, 2, 30, 4, 10, 2, 30, 4};
+    NS_TEST_ASSERT_MSG_EQ((received == expected), true, "The delta rebuilds the shifted stack");
+}
+
+/**
+ * \brief Actions cached under observations sent with an encoding
+ *
+ * The cache key is the inline observation, so a state answered by the cache
+ * must not see the delta or payload of the state sent before it.
+ */
+class GymStepCacheKeyTestCase : public TestCase
+{
+  public:
+    /**
+     * \param useDelta whether observations are delta encoded
+     * \param usePayload whether observations are carried out of band
+     * \param tolerance of the decimator, which fills the observation itself if positive
+     */
+    GymStepCacheKeyTestCase(bool useDelta, bool usePayload, double tolerance);
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Run a step through the pipeline, answered by the cache or the agent.
+     * Returns the action taken.
+     */
+    uint32_t Step(OpenGymStepPipeline& pipeline,
+                  const std::vector<float>& values,
+                  uint32_t agentAction,
+                  float* reward);
+
+    bool m_useDelta;
+    bool m_usePayload;
+    double m_tolerance;
+};
+
+GymStepCacheKeyTestCase::GymStepCacheKeyTestCase(bool useDelta, bool usePayload, double tolerance)
+    : TestCase(std::string("Cache keys of ") +
+               (useDelta ? "delta encoded" : (usePayload ? "out of band" : "inline")) +
+               " observations" + (tolerance > 0 ? " filled by the decimator" : "")),
+      m_useDelta(useDelta),
+      m_usePayload(usePayload),
+      m_tolerance(tolerance)
+{
+}
+
+uint32_t
+GymStepCacheKeyTestCase::Step(OpenGymStepPipeline& pipeline,
+                              const std::vector<float>& values,
+                              uint32_t agentAction,
+                              float* reward)
+{
+    OpenGymStepState state;
+    state.obs = MakeBox(values);
+    state.reward = 1;
+    pipeline.Decimate(state);
+    pipeline.Record(state);
+    Ptr<OpenGymDataContainer> action;
+    if (const ns3_ai_gym::DataV2* data = pipeline.LookupAction(state))
+    {
+        action = pipeline.DecodeData(*data);
+        pipeline.AcceptAction(action, data);
+    }
+    else
+    {
+        pipeline.EncodeState(state, nullptr);
+        action = MakeDiscrete(agentAction);
+        pipeline.AcceptAction(action);
+    }
+    *reward = state.reward;
+    return DynamicCast<OpenGymDiscreteContainer>(action)->GetValue();
+}
+
+void
+GymStepCacheKeyTestCase::DoRun()
+{
+    OpenGymStepPipeline pipeline;
+    pipeline.SetProtocol(2, m_useDelta, m_usePayload);
+    pipeline.GetActionCache().SetCapacity(8);
+    pipeline.GetDeltaEncoder().SetKeyframeInterval(100);
+    pipeline.GetDecimator().SetTolerance(m_tolerance);
+    if (m_usePayload)
+    {
+        CreatePayloadSegment();
+        pipeline.GetPayloadArea().SetThreshold(0);
+    }
+
+    // the observations differ in one element, so that the second one is sent as a delta
+    std::vector<float> a{1, 2, 3, 4};
+    std::vector<float> b{1, 2, 9, 4};
+    std::vector<float> c{5, 6, 7, 8};
+    float reward;
+    NS_TEST_EXPECT_MSG_EQ(Step(pipeline, a, 1, &reward), 1, "The agent answers a");
+    NS_TEST_EXPECT_MSG_EQ(Step(pipeline, b, 2, &reward), 2, "The agent answers b");
+    NS_TEST_EXPECT_MSG_EQ(Step(pipeline, a, 0, &reward), 1, "The cache answers a");
+    NS_TEST_EXPECT_MSG_EQ(Step(pipeline, b, 0, &reward), 2, "The cache answers b");
+    NS_TEST_EXPECT_MSG_EQ(pipeline.GetActionCache().GetHits(), 2, "Both states were cached");
+    NS_TEST_EXPECT_MSG_EQ(pipeline.GetActionCache().GetMisses(), 2, "Both states were new");
+
+    NS_TEST_EXPECT_MSG_EQ(Step(pipeline, c, 3, &reward), 3, "The agent answers c");
+    NS_TEST_EXPECT_MSG_EQ_TOL(reward, 3, 1e-6, "The rewards of cached states are deferred");
+}
+
+/**
+ * \brief Actions of an in-process policy repeated by the decimator
+ */
+class GymStepPolicyRepeatTestCase : public TestCase
+{
+  public:
+    GymStepPolicyRepeatTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymStepPolicyRepeatTestCase::GymStepPolicyRepeatTestCase()
+    : TestCase("Policy actions repeated by the decimator")
+{
+}
+
+void
+GymStepPolicyRepeatTestCase::DoRun()
+{
+    OpenGymStepPipeline pipeline;
+    pipeline.SetProtocol(2, false, false);
+    pipeline.GetDecimator().SetRepeat(3);
+
+    OpenGymStepState state;
+    state.obs = MakeBox({1, 2});
+    state.reward = 1;
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "The first state is a decision");
+    NS_TEST_EXPECT_MSG_EQ(pipeline.LookupAction(state), nullptr, "The cache is disabled");
+    // a policy answers without the state being encoded
+    Ptr<OpenGymDataContainer> first = MakeDiscrete(1);
+    pipeline.AcceptAction(first);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        state.reward = 1;
+        NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), false, "The action is repeated");
+        NS_TEST_EXPECT_MSG_EQ(pipeline.GetRepeatedAction(), first, "The policy action repeats");
+    }
+    state.reward = 1;
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "Every third state is a decision");
+    NS_TEST_EXPECT_MSG_EQ_TOL(state.reward, 3, 1e-6, "The repeated rewards are summed");
+    Ptr<OpenGymDataContainer> second = MakeDiscrete(2);
+    pipeline.AcceptAction(second);
+
+    state.reward = 1;
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), false, "The action is repeated");
+    NS_TEST_EXPECT_MSG_EQ(pipeline.GetRepeatedAction(), second, "The new action repeats");
+    state.reward = 1;
+    state.isGameOver = true;
+    NS_TEST_ASSERT_MSG_EQ(pipeline.Decimate(state), true, "The final state is a decision");
+    NS_TEST_EXPECT_MSG_EQ_TOL(state.reward, 2, 1e-6, "The final state gets the rewards so far");
+}
+
+/**
+ * \brief Tests of the stages of a Gym step
+ */
+class AiGymStepTestSuite : public TestSuite
+{
+  public:
+    AiGymStepTestSuite();
+};
+
+AiGymStepTestSuite::AiGymStepTestSuite()
+    : TestSuite("ai-gym-step", Type::UNIT)
+{
+    AddTestCase(new GymStepDeltaStackTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymStepCacheKeyTestCase(false, false, 0), TestCase::Duration::QUICK);
+    AddTestCase(new GymStepCacheKeyTestCase(true, false, 0), TestCase::Duration::QUICK);
+    AddTestCase(new GymStepCacheKeyTestCase(true, false, 0.5), TestCase::Duration::QUICK);
+    AddTestCase(new GymStepCacheKeyTestCase(false, true, 0), TestCase::Duration::QUICK);
+    AddTestCase(new GymStepCacheKeyTestCase(false, true, 0.5), TestCase::Duration::QUICK);
+    AddTestCase(new GymStepPolicyRepeatTestCase, TestCase::Duration::QUICK);
+}
+
+static AiGymStepTestSuite g_aiGymStepTestSuite; ///< the test suite
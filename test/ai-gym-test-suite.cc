@@ -0,0 +1,1025 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/config.h>
+#include <ns3/test.h>
+#include <ns3/trace-source-accessor.h>
+#include <ns3/traced-value.h>
+#include <ns3/uinteger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ns3;
+
+namespace
+{
+
+/**
+ * Fill a message with a Box of floats, as the interface does before encoding
+ */
+void
+FillBox(const std::vector<float>& values, ns3_ai_gym::DataV2* dataPbMsg)
+{
+    auto box = CreateObject<OpenGymBoxContainer<float>>(
+        std::vector<uint32_t>{static_cast<uint32_t>(values.size())});
+    box->SetData(values);
+    box->FillDataPbMsgV2(dataPbMsg, nullptr);
+}
+
+std::vector<float>
+ToFloats(const std::string& data)
+{
+    std::vector<float> values(data.size() / sizeof(float));
+    std::memcpy(values.data(), data.data(), data.size());
+    return values;
+}
+
+std::string
+ReadFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+/**
+ * \brief Delta encoding of Box observations
+ */
+class GymDeltaEncoderTestCase : public TestCase
+{
+  public:
+    GymDeltaEncoderTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymDeltaEncoderTestCase::GymDeltaEncoderTestCase()
+    : TestCase("Delta encoder")
+{
+}
+
+void
+GymDeltaEncoderTestCase::DoRun()
+{
+    OpenGymDeltaEncoder encoder;
+    encoder.SetKeyframeInterval(3);
+    // the message is reused, as the state message of the interface
+    ns3_ai_gym::DataV2 msg;
+
+    std::vector<float> values{1, 2, 3, 4, 5, 6, 7, 8};
+    for (uint32_t state = 0; state < 6; ++state)
+    {
+        values[state] += 10;
+        FillBox(values, &msg);
+        encoder.Encode(&msg, nullptr);
+        bool keyframe = state % 3 == 0;
+        NS_TEST_EXPECT_MSG_EQ(msg.box().has_delta(),
+                              !keyframe,
+                              "State " << state << " is " << (keyframe ? "not " : "")
+                                       << "a delta");
+        if (keyframe)
+        {
+            NS_TEST_EXPECT_MSG_EQ((ToFloats(msg.box().data()) == values),
+                                  true,
+                                  "A keyframe carries the full data");
+        }
+        else
+        {
+            NS_TEST_EXPECT_MSG_EQ(msg.box().data().size(), 0, "A delta carries no full data");
+            uint32_t index;
+            NS_TEST_ASSERT_MSG_EQ(msg.box().delta().index().size(), sizeof(index), "One change");
+            std::memcpy(&index, msg.box().delta().index().data(), sizeof(index));
+            NS_TEST_EXPECT_MSG_EQ(index, state, "The changed element is sent");
+            NS_TEST_EXPECT_MSG_EQ(ToFloats(msg.box().delta().values())[0],
+                                  values[state],
+                                  "The changed value is sent");
+        }
+    }
+
+    // a Box whose size changed is sent in full, and the next state is a delta against it
+    encoder.SetKeyframeInterval(100);
+    encoder.Reset();
+    FillBox(values, &msg);
+    encoder.Encode(&msg, nullptr);
+    values.push_back(9);
+    FillBox(values, &msg);
+    encoder.Encode(&msg, nullptr);
+    NS_TEST_EXPECT_MSG_EQ(msg.box().has_delta(), false, "A resized Box is sent in full");
+    NS_TEST_EXPECT_MSG_EQ(msg.box().data().size(), values.size() * sizeof(float), "Full data");
+    values[8] = 90;
+    FillBox(values, &msg);
+    encoder.Encode(&msg, nullptr);
+    NS_TEST_EXPECT_MSG_EQ(msg.box().has_delta(), true, "The resized Box is the new reference");
+
+    // a delta as large as the data is not worth it
+    for (float& value : values)
+    {
+        value = -value;
+    }
+    FillBox(values, &msg);
+    encoder.Encode(&msg, nullptr);
+    NS_TEST_EXPECT_MSG_EQ(msg.box().has_delta(), false, "A large delta is not sent");
+    NS_TEST_EXPECT_MSG_EQ((ToFloats(msg.box().data()) == values), true, "The data is sent");
+}
+
+/**
+ * \brief Action repeat, tolerance band and stacking of the decimator
+ */
+class GymDecimatorTestCase : public TestCase
+{
+  public:
+    GymDecimatorTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymDecimatorTestCase::GymDecimatorTestCase()
+    : TestCase("Decimator")
+{
+}
+
+void
+GymDecimatorTestCase::DoRun()
+{
+    ns3_ai_gym::DataV2 obs;
+    FillBox({1, 2}, &obs);
+    float reward;
+
+    // the agent decides every third step, and on the final one
+    OpenGymDecimator repeat;
+    repeat.SetRepeat(3);
+    NS_TEST_EXPECT_MSG_EQ(repeat.IsPassThrough(), false, "Repeating is not a pass-through");
+    NS_TEST_EXPECT_MSG_EQ(repeat.NeedsObservation(), false, "Repeating needs no observation");
+    std::vector<bool> decisions;
+    std::vector<float> rewards;
+    for (uint32_t step = 0; step < 8; ++step)
+    {
+        reward = 1;
+        bool decide = repeat.Step(&obs, &reward, step == 7);
+        decisions.push_back(decide);
+        if (decide)
+        {
+            rewards.push_back(reward);
+        }
+    }
+    std::vector<bool> expectedDecisions{true, false, false, true, false, false, true, true};
+    NS_TEST_EXPECT_MSG_EQ((decisions == expectedDecisions), true, "Decisions every 3 steps");
+    std::vector<float> expectedRewards{1, 3, 3, 1};
+    NS_TEST_EXPECT_MSG_EQ((rewards == expectedRewards), true, "Rewards summed until a decision");
+    repeat.SetAction(CreateObject<OpenGymDiscreteContainer>(2));
+    repeat.Reset();
+    NS_TEST_EXPECT_MSG_EQ(repeat.GetAction(), nullptr, "A reset drops the repeated action");
+    reward = 1;
+    NS_TEST_EXPECT_MSG_EQ(repeat.Step(&obs, &reward, false), true, "Episodes start deciding");
+
+    // the agent decides once the observation leaves the band around that of its last decision
+    OpenGymDecimator tolerance;
+    tolerance.SetTolerance(0.5);
+    NS_TEST_EXPECT_MSG_EQ(tolerance.NeedsObservation(), true, "A band needs the observation");
+    std::vector<std::vector<float>> observations{{1, 2},
+                                                 {1.2, 2},
+                                                 {1.4, 1.7},
+                                                 {1.6, 2},
+                                                 {1.9, 2}};
+    decisions.clear();
+    for (const auto& values : observations)
+    {
+        FillBox(values, &obs);
+        reward = 1;
+        decisions.push_back(tolerance.Step(&obs, &reward, false));
+    }
+    expectedDecisions = {true, false, false, true, false};
+    NS_TEST_EXPECT_MSG_EQ((decisions == expectedDecisions), true, "Decisions out of the band");
+
+    // the latest observations are stacked along a new first axis
+    OpenGymDecimator stack;
+    stack.SetStack(3);
+    ns3_ai_gym::SpaceV2 space;
+    ns3_ai_gym::BoxSpaceV2* boxSpace = space.mutable_box();
+    boxSpace->add_shape(2);
+    boxSpace->add_low(0);
+    boxSpace->add_low(-1);
+    boxSpace->add_high(1);
+    boxSpace->add_high(2);
+    NS_TEST_ASSERT_MSG_EQ(stack.StackSpace(&space), true, "A dense Box can be stacked");
+    NS_TEST_EXPECT_MSG_EQ(boxSpace->shape_size(), 2, "The space has a new axis");
+    NS_TEST_EXPECT_MSG_EQ(boxSpace->shape(0), 3, "The new axis is the first");
+    NS_TEST_EXPECT_MSG_EQ(boxSpace->low_size(), 6, "The bounds are repeated");
+    NS_TEST_EXPECT_MSG_EQ(boxSpace->low(5), -1, "The bounds are repeated in order");
+    std::vector<std::vector<float>> stacked{{1, 1, 1, 1, 1, 1},
+                                            {1, 1, 1, 1, 2, 2},
+                                            {1, 1, 2, 2, 3, 3},
+                                            {2, 2, 3, 3, 4, 4}};
+    for (uint32_t step = 0; step < stacked.size(); ++step)
+    {
+        float value = step + 1;
+        FillBox({value, value}, &obs);
+        reward = 1;
+        NS_TEST_ASSERT_MSG_EQ(stack.Step(&obs, &reward, false), true, "Stacking decides");
+        NS_TEST_EXPECT_MSG_EQ(obs.box().shape(0), 3, "The observation has a new axis");
+        NS_TEST_EXPECT_MSG_EQ((ToFloats(obs.box().data()) == stacked[step]),
+                              true,
+                              "Step " << step << " stacks the latest observations");
+    }
+}
+
+/**
+ * \brief An environment observing a Dict of lazy fields
+ */
+class GymFieldTestEnv : public OpenGymEnv
+{
+  public:
+    GymFieldTestEnv()
+    {
+        AddObservationField("cheap",
+                            CreateObject<OpenGymDiscreteSpace>(4),
+                            MakeCallback(&GymFieldTestEnv::GetCheap, this));
+        AddObservationField("costly",
+                            CreateObject<OpenGymDiscreteSpace>(4),
+                            MakeCallback(&GymFieldTestEnv::GetCostly, this));
+    }
+
+    Ptr<OpenGymSpace> GetActionSpace() override
+    {
+        return CreateObject<OpenGymDiscreteSpace>(2);
+    }
+
+    bool GetGameOver() override
+    {
+        return false;
+    }
+
+    float GetReward() override
+    {
+        return 0;
+    }
+
+    std::string GetExtraInfo() override
+    {
+        return "";
+    }
+
+    bool ExecuteActions(Ptr<OpenGymDataContainer>) override
+    {
+        return true;
+    }
+
+    uint32_t m_cheapCalls{0};  ///< number of calls of the producer of the cheap field
+    uint32_t m_costlyCalls{0}; ///< number of calls of the producer of the costly field
+
+  private:
+    Ptr<OpenGymDataContainer> GetCheap()
+    {
+        m_cheapCalls++;
+        return CreateObject<OpenGymDiscreteContainer>(4);
+    }
+
+    Ptr<OpenGymDataContainer> GetCostly()
+    {
+        m_costlyCalls++;
+        return CreateObject<OpenGymDiscreteContainer>(4);
+    }
+};
+
+/**
+ * \brief Observation fields produced only when the agent requests them
+ */
+class GymObservationFieldTestCase : public TestCase
+{
+  public:
+    GymObservationFieldTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymObservationFieldTestCase::GymObservationFieldTestCase()
+    : TestCase("Observation fields")
+{
+}
+
+void
+GymObservationFieldTestCase::DoRun()
+{
+    Ptr<GymFieldTestEnv> env = CreateObject<GymFieldTestEnv>();
+    std::vector<std::string> names{"cheap", "costly"};
+    NS_TEST_EXPECT_MSG_EQ((env->GetObservationFieldNames() == names), true, "Fields in order");
+    Ptr<OpenGymDictSpace> space = DynamicCast<OpenGymDictSpace>(env->GetObservationSpace());
+    NS_TEST_ASSERT_MSG_NE(space, nullptr, "The fields make a Dict space");
+    NS_TEST_EXPECT_MSG_NE(space->Get("costly"), nullptr, "The space has every field");
+
+    // without an interface, or a mask, every field is produced
+    Ptr<OpenGymDictContainer> obs = DynamicCast<OpenGymDictContainer>(env->GetObservation());
+    NS_TEST_ASSERT_MSG_NE(obs, nullptr, "The fields make a Dict observation");
+    NS_TEST_EXPECT_MSG_EQ(obs->GetKeys().size(), 2, "Every field is observed");
+
+    Ptr<OpenGymInterface> openGymInterface = CreateObject<OpenGymInterface>();
+    env->SetOpenGymInterface(openGymInterface);
+    openGymInterface->SetObservationFieldMask({"cheap"});
+    obs = DynamicCast<OpenGymDictContainer>(env->GetObservation());
+    NS_TEST_EXPECT_MSG_EQ(obs->GetKeys().size(), 1, "Only the requested field is observed");
+    NS_TEST_EXPECT_MSG_NE(obs->Get("cheap"), nullptr, "The requested field is observed");
+    NS_TEST_EXPECT_MSG_EQ(env->m_cheapCalls, 2, "The requested field is produced");
+    NS_TEST_EXPECT_MSG_EQ(env->m_costlyCalls, 1, "The field not requested is not produced");
+
+    openGymInterface->SetObservationFieldMask({});
+    obs = DynamicCast<OpenGymDictContainer>(env->GetObservation());
+    NS_TEST_EXPECT_MSG_EQ(obs->GetKeys().size(), 2, "An empty mask requests every field");
+    env->Dispose();
+}
+
+/**
+ * \brief Episodes forked from the checkpoint of a fork server
+ */
+class GymForkServerTestCase : public TestCase
+{
+  public:
+    GymForkServerTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymForkServerTestCase::GymForkServerTestCase()
+    : TestCase("Fork server")
+{
+}
+
+void
+GymForkServerTestCase::DoRun()
+{
+    NS_TEST_ASSERT_MSG_EQ(std::getenv("NS3AI_FORK_SERVER"), nullptr, "Not run by a fork server");
+    // outside fork-server mode, the checkpoint is a no-op
+    CreateObject<OpenGymInterface>()->Checkpoint();
+
+    int fds[2];
+    NS_TEST_ASSERT_MSG_EQ(pipe(fds), 0, "Cannot create a pipe");
+    // the buffered output would be written again by the server
+    std::cout.flush();
+    std::fflush(nullptr);
+    pid_t server = fork();
+    NS_TEST_ASSERT_MSG_NE(server, -1, "Cannot fork the server");
+    if (server == 0)
+    {
+        // the server reads the requests of Python, and every episode reports its segment
+        close(fds[0]);
+        std::istringstream requests("episode-1\n\nepisode-2\n");
+        std::cin.rdbuf(requests.rdbuf());
+        setenv("NS3AI_FORK_SERVER", "1", 1);
+        CreateObject<OpenGymInterface>()->Checkpoint();
+        std::string report = std::getenv("NS3AI_SEGMENT_NAME");
+        report += std::getenv("NS3AI_FORK_SERVER") ? " server\n" : "\n";
+        ssize_t written = write(fds[1], report.data(), report.size());
+        _exit(written == static_cast<ssize_t>(report.size()) ? 0 : 1);
+    }
+    close(fds[1]);
+    std::string reports;
+    char buffer[256];
+    ssize_t size;
+    while ((size = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+        reports.append(buffer, size);
+    }
+    close(fds[0]);
+    int status;
+    NS_TEST_ASSERT_MSG_EQ(waitpid(server, &status, 0), server, "The server is not a child");
+    NS_TEST_EXPECT_MSG_EQ((WIFEXITED(status) && WEXITSTATUS(status) == 0),
+                          true,
+                          "The server exits once the requests are closed");
+
+    // the episodes run in parallel, and report in any order
+    std::vector<std::string> segments;
+    std::istringstream lines(reports);
+    for (std::string line; std::getline(lines, line);)
+    {
+        segments.push_back(line);
+    }
+    std::sort(segments.begin(), segments.end());
+    std::vector<std::string> expected{"episode-1", "episode-2"};
+    NS_TEST_EXPECT_MSG_EQ((segments == expected),
+                          true,
+                          "Every request forks an episode on its segment");
+}
+
+/**
+ * \brief Durations accounted to the phases of the exchanges
+ */
+class GymProfilerTestCase : public TestCase
+{
+  public:
+    GymProfilerTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymProfilerTestCase::GymProfilerTestCase()
+    : TestCase("Profiler")
+{
+}
+
+void
+GymProfilerTestCase::DoRun()
+{
+    OpenGymProfiler profiler;
+    {
+        OpenGymProfiler::Scope scope(profiler, OpenGymProfiler::WAIT);
+    }
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetCount(OpenGymProfiler::WAIT), 0, "Disabled, nothing counts");
+
+    profiler.SetEnabled(true);
+    {
+        OpenGymProfiler::Scope scope(profiler, OpenGymProfiler::WAIT);
+        scope.Stop();
+    }
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetCount(OpenGymProfiler::WAIT), 1, "A scope counts once");
+
+    // bucket i counts the durations in [2^i, 2^(i+1)) ns
+    std::vector<uint64_t> durations{1, 3, 2, 1000, uint64_t(1) << 50};
+    for (uint64_t ns : durations)
+    {
+        profiler.Add(OpenGymProfiler::DECODE, ns);
+    }
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetCount(OpenGymProfiler::DECODE), 5, "Every duration counts");
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetTotal(OpenGymProfiler::DECODE),
+                          1006 + (uint64_t(1) << 50),
+                          "Durations are summed");
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetMin(OpenGymProfiler::DECODE), 1, "The least duration");
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetMax(OpenGymProfiler::DECODE),
+                          uint64_t(1) << 50,
+                          "The largest duration");
+    const auto& histogram = profiler.GetHistogram(OpenGymProfiler::DECODE);
+    NS_TEST_EXPECT_MSG_EQ(histogram[0], 1, "1 ns is in the first bucket");
+    NS_TEST_EXPECT_MSG_EQ(histogram[1], 2, "2 and 3 ns are in the second bucket");
+    NS_TEST_EXPECT_MSG_EQ(histogram[9], 1, "1000 ns is in [512, 1024)");
+    NS_TEST_EXPECT_MSG_EQ(histogram[OpenGymProfiler::HISTOGRAM_SIZE - 1],
+                          1,
+                          "The last bucket is open");
+
+    ns3_ai_gym::ProfileStats stats;
+    profiler.FillStatsPbMsg(&stats);
+    NS_TEST_ASSERT_MSG_EQ(stats.phases_size(),
+                          OpenGymProfiler::PHASE_COUNT,
+                          "Every phase is sent");
+    const ns3_ai_gym::PhaseStats& decode = stats.phases(OpenGymProfiler::DECODE);
+    NS_TEST_EXPECT_MSG_EQ(decode.name(), "Decode", "Phases are named");
+    NS_TEST_EXPECT_MSG_EQ(decode.count(), 5, "The count is sent");
+    NS_TEST_EXPECT_MSG_EQ(decode.histogram_size(),
+                          OpenGymProfiler::HISTOGRAM_SIZE,
+                          "The histogram is sent up to its last bucket");
+    NS_TEST_EXPECT_MSG_EQ(stats.phases(OpenGymProfiler::WAIT).histogram_size() <
+                              static_cast<int>(OpenGymProfiler::HISTOGRAM_SIZE),
+                          true,
+                          "Trailing empty buckets are not sent");
+    NS_TEST_EXPECT_MSG_EQ(stats.phases(OpenGymProfiler::EXECUTE).histogram_size(),
+                          0,
+                          "A phase without durations has no histogram");
+
+    profiler.Reset();
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetCount(OpenGymProfiler::DECODE), 0, "Reset forgets");
+    NS_TEST_EXPECT_MSG_EQ(profiler.GetMin(OpenGymProfiler::DECODE), 0, "Reset forgets");
+}
+
+/**
+ * \brief Columnar files of a trajectory, written by chunks
+ */
+class GymTrajectoryTestCase : public TestCase
+{
+  public:
+    GymTrajectoryTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymTrajectoryTestCase::GymTrajectoryTestCase()
+    : TestCase("Trajectory writer")
+{
+}
+
+void
+GymTrajectoryTestCase::DoRun()
+{
+    ns3_ai_gym::SpaceV2 obsSpace;
+    obsSpace.mutable_box()->set_dtype(ns3_ai_gym::FLOAT32);
+    obsSpace.mutable_box()->add_shape(2);
+    ns3_ai_gym::SpaceV2 actSpace;
+    actSpace.mutable_discrete()->set_n(4);
+
+    // five rows by chunks of two, the last chunk being written on Close
+    std::string path = CreateTempDirFilename("trajectory");
+    OpenGymTrajectoryWriter writer;
+    writer.Open(path, "My Seg", obsSpace, actSpace, 2);
+    NS_TEST_ASSERT_MSG_EQ(writer.IsOpen(), true, "The trajectory is open");
+    std::string directory = writer.GetDirectory();
+    std::string prefix = path + "/My_Seg-";
+    NS_TEST_ASSERT_MSG_EQ(directory.compare(0, prefix.size(), prefix),
+                          0,
+                          "The simulation has its subdirectory");
+    ns3_ai_gym::DataV2 obs;
+    ns3_ai_gym::DataV2 action;
+    for (uint32_t step = 0; step < 5; ++step)
+    {
+        FillBox({float(step), -float(step)}, &obs);
+        writer.AddState(obs, step + 0.5, step == 4, step % 2 ? "odd" : "");
+        // the agent does not act on the third and final states
+        if (step != 2 && step != 4)
+        {
+            action.set_discrete(step);
+            writer.AddAction(action);
+        }
+    }
+    writer.Close();
+    NS_TEST_EXPECT_MSG_EQ(writer.GetRows(), 5, "Every state makes a row");
+
+    // fixed-size columns are packed rows
+    NS_TEST_EXPECT_MSG_EQ((ToFloats(ReadFile(directory + "/obs.bin")) ==
+                           std::vector<float>{0, 0, 1, -1, 2, -2, 3, -3, 4, -4}),
+                          true,
+                          "Observations are packed in order");
+    std::string actionData = ReadFile(directory + "/action.bin");
+    std::vector<int64_t> actions(actionData.size() / sizeof(int64_t));
+    std::memcpy(actions.data(), actionData.data(), actionData.size());
+    NS_TEST_EXPECT_MSG_EQ((actions == std::vector<int64_t>{0, 1, 0, 3, 0}),
+                          true,
+                          "Missing actions are zeros");
+    NS_TEST_EXPECT_MSG_EQ(ReadFile(directory + "/acted.bin"),
+                          std::string("\1\1\0\1\0", 5),
+                          "Rows tell whether the agent acted");
+    NS_TEST_EXPECT_MSG_EQ(ReadFile(directory + "/done.bin"),
+                          std::string("\0\0\0\0\1", 5),
+                          "The final row is done");
+    NS_TEST_EXPECT_MSG_EQ((ToFloats(ReadFile(directory + "/reward.bin")) ==
+                           std::vector<float>{0.5, 1.5, 2.5, 3.5, 4.5}),
+                          true,
+                          "Rewards are packed in order");
+
+    // variable columns have the end offsets of their rows
+    NS_TEST_EXPECT_MSG_EQ(ReadFile(directory + "/info.bin"), "oddodd", "Infos are concatenated");
+    std::string indexData = ReadFile(directory + "/info.idx");
+    std::vector<uint64_t> index(indexData.size() / sizeof(uint64_t));
+    std::memcpy(index.data(), indexData.data(), indexData.size());
+    NS_TEST_EXPECT_MSG_EQ((index == std::vector<uint64_t>{0, 3, 3, 6, 6}),
+                          true,
+                          "Infos end at their offsets");
+
+    std::string schema = ReadFile(directory + "/schema.json");
+    NS_TEST_EXPECT_MSG_NE(schema.find("{\"name\": \"obs\", \"dtype\": \"float32\", "
+                                      "\"shape\": [2], \"variable\": false}"),
+                          std::string::npos,
+                          "The schema describes the observations");
+    NS_TEST_EXPECT_MSG_NE(schema.find("{\"name\": \"action\", \"dtype\": \"int64\", "
+                                      "\"shape\": [], \"variable\": false}"),
+                          std::string::npos,
+                          "The schema describes the actions");
+    NS_TEST_EXPECT_MSG_NE(schema.find("{\"name\": \"info\", \"dtype\": \"bytes\", "
+                                      "\"shape\": [], \"variable\": true}"),
+                          std::string::npos,
+                          "The schema describes the infos");
+
+    // a relaunched simulation of the same segment leaves the first trajectory alone
+    OpenGymTrajectoryWriter relaunched;
+    relaunched.Open(path, "My Seg", obsSpace, actSpace, 2);
+    NS_TEST_EXPECT_MSG_EQ(relaunched.GetDirectory(),
+                          prefix + std::to_string(std::stoul(directory.substr(prefix.size())) + 1),
+                          "The next simulation takes the next index");
+    // a synced final state is in the files before the trajectory is closed
+    FillBox({5, -5}, &obs);
+    relaunched.AddState(obs, 5.5, true, "");
+    relaunched.Sync();
+    NS_TEST_EXPECT_MSG_EQ((ToFloats(ReadFile(relaunched.GetDirectory() + "/obs.bin")) ==
+                           std::vector<float>{5, -5}),
+                          true,
+                          "The final state is written");
+    NS_TEST_EXPECT_MSG_EQ(ReadFile(relaunched.GetDirectory() + "/acted.bin"),
+                          std::string("\0", 1),
+                          "The final state has no action");
+    relaunched.Close();
+    NS_TEST_EXPECT_MSG_EQ(relaunched.GetRows(), 1, "Close adds no row after Sync");
+    NS_TEST_EXPECT_MSG_EQ(ReadFile(directory + "/done.bin"),
+                          std::string("\0\0\0\0\1", 5),
+                          "The first trajectory is kept");
+}
+
+/**
+ * \brief Sparse Box data sent as its nonzero elements and read back
+ */
+class GymSparseBoxTestCase : public TestCase
+{
+  public:
+    GymSparseBoxTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymSparseBoxTestCase::GymSparseBoxTestCase()
+    : TestCase("Sparse Box round trip")
+{
+}
+
+void
+GymSparseBoxTestCase::DoRun()
+{
+    auto sparse = CreateObject<OpenGymSparseBoxContainer<float>>(std::vector<uint32_t>{4, 5});
+    NS_TEST_EXPECT_MSG_EQ(sparse->SetValue(3, 1.5), true, "An element is set");
+    NS_TEST_EXPECT_MSG_EQ(sparse->AddValue(17, -2), true, "An element is added");
+    NS_TEST_EXPECT_MSG_EQ(sparse->SetValue(3, 2.5), true, "An element is set again");
+    NS_TEST_EXPECT_MSG_EQ(sparse->SetValue(20, 1), false, "The element is out of the shape");
+    NS_TEST_EXPECT_MSG_EQ(sparse->GetIndex().size(), 2, "Setting again adds no element");
+
+    // the message is reused, and the dense data of a previous state is dropped
+    ns3_ai_gym::DataV2 msg;
+    FillBox(std::vector<float>(20, 1), &msg);
+    sparse->FillDataPbMsgV2(&msg, nullptr);
+    const ns3_ai_gym::BoxDataV2& box = msg.box();
+    NS_TEST_ASSERT_MSG_EQ(box.has_sparse(), true, "The data is sparse");
+    NS_TEST_EXPECT_MSG_EQ(box.data().empty(), true, "No dense data is sent");
+    NS_TEST_EXPECT_MSG_EQ(box.has_payload(), false, "No payload is sent");
+    NS_TEST_EXPECT_MSG_EQ(box.has_delta(), false, "No delta is sent");
+    NS_TEST_EXPECT_MSG_EQ(box.shape_size(), 2, "The shape is sent");
+    NS_TEST_EXPECT_MSG_EQ(box.shape(1), 5, "The shape is sent");
+    std::vector<uint32_t> index(box.sparse().index().size() / sizeof(uint32_t));
+    std::memcpy(index.data(), box.sparse().index().data(), box.sparse().index().size());
+    NS_TEST_EXPECT_MSG_EQ((index == std::vector<uint32_t>{3, 17}), true, "Index in COO");
+    NS_TEST_EXPECT_MSG_EQ((ToFloats(box.sparse().values()) == std::vector<float>{2.5, -2}),
+                          true,
+                          "Values in COO");
+
+    auto received = CreateObject<OpenGymSparseBoxContainer<float>>();
+    Ptr<OpenGymDataContainer> read = OpenGymDataContainer::CreateFromDataPbMsgV2(msg, received);
+    NS_TEST_ASSERT_MSG_EQ(read, received, "The container is reused");
+    NS_TEST_EXPECT_MSG_EQ((received->GetShape() == sparse->GetShape()), true, "Same shape");
+    NS_TEST_EXPECT_MSG_EQ((received->GetDenseData() == sparse->GetDenseData()),
+                          true,
+                          "Same elements");
+    NS_TEST_EXPECT_MSG_EQ(received->GetValue(17), -2, "An element is read");
+    NS_TEST_EXPECT_MSG_EQ(received->GetValue(4), 0, "Other elements are zero");
+
+    // dense data, e.g. an action of Python, keeps its nonzero elements
+    std::vector<float> dense(6, 0);
+    dense[1] = 7;
+    dense[5] = 8;
+    FillBox(dense, &msg);
+    NS_TEST_ASSERT_MSG_EQ(received->UpdateFromDataPbMsgV2(msg), true, "Dense data is read");
+    NS_TEST_EXPECT_MSG_EQ((received->GetIndex() == std::vector<uint32_t>{1, 5}),
+                          true,
+                          "Only the nonzero elements are kept");
+    NS_TEST_EXPECT_MSG_EQ((received->GetDenseData() == dense), true, "Same elements");
+
+    ns3_ai_gym::DataV2 other;
+    auto ints = CreateObject<OpenGymSparseBoxContainer<int32_t>>(std::vector<uint32_t>{3});
+    ints->SetValue(0, 1);
+    ints->FillDataPbMsgV2(&other, nullptr);
+    NS_TEST_EXPECT_MSG_EQ(received->UpdateFromDataPbMsgV2(other),
+                          false,
+                          "Data of another type is not read");
+}
+
+/**
+ * \brief Actions cached by observation, the least recently used evicted
+ */
+class GymActionCacheTestCase : public TestCase
+{
+  public:
+    GymActionCacheTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymActionCacheTestCase::GymActionCacheTestCase()
+    : TestCase("Action cache")
+{
+}
+
+void
+GymActionCacheTestCase::DoRun()
+{
+    OpenGymActionCache cache;
+    NS_TEST_EXPECT_MSG_EQ(cache.IsEnabled(), false, "The cache is disabled by default");
+    cache.Insert("a", "1");
+    NS_TEST_EXPECT_MSG_EQ(cache.GetSize(), 0, "A disabled cache keeps nothing");
+
+    cache.SetCapacity(2);
+    NS_TEST_ASSERT_MSG_EQ(cache.IsEnabled(), true, "The cache is enabled");
+    NS_TEST_EXPECT_MSG_EQ(cache.Lookup("a"), nullptr, "Nothing is cached yet");
+    // observations longer than a short string, whose buffers are reused on eviction
+    std::string b(64, 'b');
+    std::string c(128, 'c');
+    cache.Insert("a", "1");
+    cache.Insert(b, "2");
+    NS_TEST_EXPECT_MSG_EQ(cache.GetSize(), 2, "The cache is full");
+
+    // the lookup makes a the most recently used, so b is evicted
+    std::string* action = cache.Lookup("a");
+    NS_TEST_ASSERT_MSG_NE(action, nullptr, "a is cached");
+    NS_TEST_EXPECT_MSG_EQ(*action, "1", "The action of a");
+    cache.Insert(c, "3");
+    NS_TEST_EXPECT_MSG_EQ(cache.GetSize(), 2, "The capacity is kept");
+    NS_TEST_EXPECT_MSG_EQ(cache.Lookup(b), nullptr, "The least recently used is evicted");
+    NS_TEST_ASSERT_MSG_NE(cache.Lookup(c), nullptr, "c is cached");
+    NS_TEST_EXPECT_MSG_EQ(*cache.Lookup(c), "3", "The action of c");
+
+    // inserting again replaces the action, and makes a the most recently used
+    cache.Insert("a", "4");
+    NS_TEST_EXPECT_MSG_EQ(cache.GetSize(), 2, "The action is replaced");
+    cache.Insert(b, "5");
+    NS_TEST_EXPECT_MSG_EQ(cache.Lookup(c), nullptr, "c is the least recently used");
+    NS_TEST_ASSERT_MSG_NE(cache.Lookup("a"), nullptr, "a is cached");
+    NS_TEST_EXPECT_MSG_EQ(*cache.Lookup("a"), "4", "The replaced action of a");
+    NS_TEST_EXPECT_MSG_EQ(*cache.Lookup(b), "5", "The action of b");
+
+    // lookups: a, a, b, c, c, c, a, a, b
+    NS_TEST_EXPECT_MSG_EQ(cache.GetHits(), 6, "Hits are counted");
+    NS_TEST_EXPECT_MSG_EQ(cache.GetMisses(), 3, "Misses are counted");
+
+    cache.Clear();
+    NS_TEST_EXPECT_MSG_EQ(cache.GetSize(), 0, "The actions are dropped");
+    NS_TEST_EXPECT_MSG_EQ(cache.Lookup("a"), nullptr, "a is dropped");
+    cache.SetCapacity(0);
+    NS_TEST_EXPECT_MSG_EQ(cache.IsEnabled(), false, "The cache is disabled");
+}
+
+/**
+ * \brief Statistics of a window of samples, and their EWMA across windows
+ */
+class GymStreamStatsTestCase : public TestCase
+{
+  public:
+    GymStreamStatsTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymStreamStatsTestCase::GymStreamStatsTestCase()
+    : TestCase("Stream statistics")
+{
+}
+
+void
+GymStreamStatsTestCase::DoRun()
+{
+    OpenGymStreamStats stats;
+    NS_TEST_EXPECT_MSG_EQ(stats.GetMin(), 0, "The statistics of an empty window are 0");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetEwma(), 0, "The EWMA is disabled");
+
+    stats.SetEwmaAlpha(0.5);
+    // samples of a trace source, through the callback the interface connects
+    Callback<void, uint32_t> sample = stats.MakeSampleCallback<uint32_t>();
+    for (uint32_t value : {2, 4, 4, 4, 5, 5, 7, 9})
+    {
+        sample(value);
+    }
+    NS_TEST_EXPECT_MSG_EQ(stats.GetCount(), 8, "All the samples are counted");
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetSum(), 40, 1e-12, "Sum");
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetMean(), 5, 1e-12, "Mean");
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetVariance(), 4, 1e-12, "Population variance");
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetStdDev(), 2, 1e-12, "Standard deviation");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetMin(), 2, "Minimum");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetMax(), 9, "Maximum");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetLast(), 9, "Last sample");
+    // starts at the first sample, then halves the distance to each sample
+    double ewma = 2;
+    for (double value : {4, 4, 4, 5, 5, 7, 9})
+    {
+        ewma += 0.5 * (value - ewma);
+    }
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetEwma(), ewma, 1e-12, "EWMA");
+
+    auto box = CreateObject<OpenGymBoxContainer<float>>(std::vector<uint32_t>{2});
+    NS_TEST_EXPECT_MSG_EQ(stats.AddTo(box, {OpenGymStreamStats::MEAN, OpenGymStreamStats::MAX}),
+                          true,
+                          "The statistics are appended");
+    NS_TEST_EXPECT_MSG_EQ((box->GetData() == std::vector<float>{5, 9}), true, "In order");
+
+    // a new window keeps the EWMA and the last sample
+    stats.Reset();
+    NS_TEST_EXPECT_MSG_EQ(stats.GetCount(), 0, "The window is empty");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetMean(), 0, "The mean of an empty window is 0");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetLast(), 9, "The last sample spans the windows");
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetEwma(), ewma, 1e-12, "The EWMA spans the windows");
+    stats.Add(1);
+    ewma += 0.5 * (1 - ewma);
+    NS_TEST_EXPECT_MSG_EQ_TOL(stats.GetEwma(), ewma, 1e-12, "The EWMA goes on");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetMin(), 1, "The extremes are of the window");
+
+    stats.Clear();
+    NS_TEST_EXPECT_MSG_EQ(stats.GetEwma(), 0, "The EWMA is cleared");
+    NS_TEST_EXPECT_MSG_EQ(stats.GetLast(), 0, "The last sample is cleared");
+    stats.Add(3);
+    NS_TEST_EXPECT_MSG_EQ(stats.GetEwma(), 3, "The EWMA restarts at the first sample");
+}
+
+/**
+ * \brief Quantiles of a window of samples with the P-square algorithm
+ */
+class GymStreamQuantileTestCase : public TestCase
+{
+  public:
+    GymStreamQuantileTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymStreamQuantileTestCase::GymStreamQuantileTestCase()
+    : TestCase("Stream quantile")
+{
+}
+
+void
+GymStreamQuantileTestCase::DoRun()
+{
+    OpenGymStreamQuantile median;
+    NS_TEST_EXPECT_MSG_EQ(median.Get(), 0, "The quantile of an empty window is 0");
+    for (double value : {5, 1, 3})
+    {
+        median.Add(value);
+    }
+    NS_TEST_EXPECT_MSG_EQ(median.Get(), 3, "The quantile of a few samples is exact");
+    median.Add(4);
+    median.Add(2);
+    NS_TEST_EXPECT_MSG_EQ(median.Get(), 3, "The quantile of five samples is exact");
+
+    // a permutation of 0 to 10006, whose quantiles are known
+    const uint32_t count = 10007;
+    median.Reset();
+    NS_TEST_EXPECT_MSG_EQ(median.GetCount(), 0, "The window is empty");
+    OpenGymStreamQuantile p10(0.1);
+    OpenGymStreamQuantile p99(0.99);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        double value = (uint64_t(i) * 7919) % count;
+        median.Add(value);
+        p10.Add(value);
+        p99.Add(value);
+    }
+    NS_TEST_EXPECT_MSG_EQ(median.GetCount(), count, "All the samples are counted");
+    NS_TEST_EXPECT_MSG_EQ_TOL(median.Get(), 0.5 * (count - 1), 0.01 * count, "Median");
+    NS_TEST_EXPECT_MSG_EQ_TOL(p10.Get(), 0.1 * (count - 1), 0.01 * count, "10th percentile");
+    NS_TEST_EXPECT_MSG_EQ_TOL(p99.Get(), 0.99 * (count - 1), 0.01 * count, "99th percentile");
+
+    // a constant signal, whose markers cannot move apart
+    OpenGymStreamQuantile constant(0.9);
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        constant.Add(7);
+    }
+    NS_TEST_EXPECT_MSG_EQ(constant.Get(), 7, "The quantile of a constant is the constant");
+}
+
+namespace
+{
+
+/**
+ * Object with a traced value and an attribute, observed by the builder
+ */
+class GymObservedObject : public Object
+{
+  public:
+    static TypeId GetTypeId();
+
+    TracedValue<uint32_t> m_value; ///< traced when it changes
+    uint32_t m_limit;              ///< read as an attribute
+};
+
+NS_OBJECT_ENSURE_REGISTERED(GymObservedObject);
+
+TypeId
+GymObservedObject::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::GymObservedObject")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<GymObservedObject>()
+                            .AddAttribute("Limit",
+                                          "Value read at every step",
+                                          UintegerValue(0),
+                                          MakeUintegerAccessor(&GymObservedObject::m_limit),
+                                          MakeUintegerChecker<uint32_t>())
+                            .AddTraceSource("Value",
+                                            "Value traced when it changes",
+                                            MakeTraceSourceAccessor(&GymObservedObject::m_value),
+                                            "ns3::TracedValueCallback::Uint32");
+    return tid;
+}
+
+} // namespace
+
+/**
+ * \brief Observation built from a traced value and an attribute of an object
+ */
+class GymObservationBuilderTestCase : public TestCase
+{
+  public:
+    GymObservationBuilderTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+GymObservationBuilderTestCase::GymObservationBuilderTestCase()
+    : TestCase("Observation builder")
+{
+}
+
+void
+GymObservationBuilderTestCase::DoRun()
+{
+    Ptr<GymObservedObject> object = CreateObject<GymObservedObject>();
+    object->m_value = 5;
+    object->SetAttribute("Limit", UintegerValue(10));
+    Config::RegisterRootNamespaceObject(object);
+
+    OpenGymObservationBuilder builder;
+    builder.AddTracedValue<uint32_t>(
+        "/$ns3::GymObservedObject/Value",
+        {OpenGymStreamStats::LAST, OpenGymStreamStats::COUNT, OpenGymStreamStats::MAX});
+    builder.AddAttribute<UintegerValue>("/$ns3::GymObservedObject/Limit");
+    NS_TEST_ASSERT_MSG_EQ(builder.GetSize(), 4, "A feature per statistic and attribute");
+
+    // the value set before the source was connected is not traced
+    Ptr<OpenGymBoxContainer<float>> obs = builder.GetObservation<float>();
+    NS_TEST_EXPECT_MSG_EQ((obs->GetData() == std::vector<float>{0, 0, 0, 10}),
+                          true,
+                          "LAST is 0 until the value changes, the attribute is read");
+
+    object->m_value = 7;
+    object->m_value = 3;
+    obs = builder.GetObservation<float>();
+    NS_TEST_EXPECT_MSG_EQ((obs->GetData() == std::vector<float>{3, 2, 7, 10}),
+                          true,
+                          "The changes of the window are reduced");
+
+    // an unchanged value keeps its last value in a new window
+    object->SetAttribute("Limit", UintegerValue(12));
+    float out[4];
+    builder.Extract(out);
+    NS_TEST_EXPECT_MSG_EQ((std::vector<float>(out, out + 4) == std::vector<float>{3, 0, 0, 12}),
+                          true,
+                          "LAST spans the windows, the attribute is read again");
+    NS_TEST_EXPECT_MSG_EQ(builder.GetObservation<float>(),
+                          obs,
+                          "The container is reused across steps");
+
+    Config::UnregisterRootNamespaceObject(object);
+}
+
+/**
+ * \brief Tests of the components of the Gym interface
+ */
+class AiGymTestSuite : public TestSuite
+{
+  public:
+    AiGymTestSuite();
+};
+
+AiGymTestSuite::AiGymTestSuite()
+    : TestSuite("ai-gym", Type::UNIT)
+{
+    AddTestCase(new GymDeltaEncoderTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymDecimatorTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymObservationFieldTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymForkServerTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymProfilerTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymTrajectoryTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymSparseBoxTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymActionCacheTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymStreamStatsTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymStreamQuantileTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new GymObservationBuilderTestCase, TestCase::Duration::QUICK);
+}
+
+static AiGymTestSuite g_aiGymTestSuite; ///< the test suite
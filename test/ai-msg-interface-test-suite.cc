@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+namespace
+{
+
+/// Message of the tests, in both directions
+struct TestMsg
+{
+    uint32_t value;
+};
+
+/// Message interface of the tests, either side depending on whether it creates the segment
+using TestMsgInterface = Ns3AiMsgInterfaceImpl<TestMsg, TestMsg>;
+
+} // namespace
+
+/**
+ * \brief Several interfaces in a process, each mapping its own segment
+ */
+class MsgInterfaceSegmentsTestCase : public TestCase
+{
+  public:
+    MsgInterfaceSegmentsTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+MsgInterfaceSegmentsTestCase::MsgInterfaceSegmentsTestCase()
+    : TestCase("Interfaces map distinct segments")
+{
+}
+
+void
+MsgInterfaceSegmentsTestCase::DoRun()
+{
+    // the Python sides, as Ns3VecEnv creates them, outlive the simulations
+    TestMsgInterface pyA(true, false, true, 4096, "ns3-ai-test-segment-a");
+    TestMsgInterface pyB(true, false, true, 4096, "ns3-ai-test-segment-b");
+    NS_TEST_EXPECT_MSG_EQ(pyA.PyCheckAttached(), false, "No simulation is attached yet");
+    TestMsgInterface cppA(false, false, true, 4096, "ns3-ai-test-segment-a");
+    TestMsgInterface cppB(false, false, true, 4096, "ns3-ai-test-segment-b");
+    NS_TEST_EXPECT_MSG_EQ(pyA.PyCheckAttached(), true, "The first simulation is attached");
+    NS_TEST_EXPECT_MSG_EQ(pyB.PyCheckAttached(), true, "The second simulation is attached");
+
+    NS_TEST_ASSERT_MSG_EQ(cppA.CppSendBegin(), true, "The first simulation sends");
+    cppA.GetCpp2PyStruct()->value = 1;
+    cppA.CppSendEnd();
+    NS_TEST_ASSERT_MSG_EQ(cppB.CppSendBegin(), true, "The second simulation sends");
+    cppB.GetCpp2PyStruct()->value = 2;
+    cppB.CppSendEnd();
+
+    NS_TEST_ASSERT_MSG_EQ(pyB.PyRecvBegin(), true, "The second simulation is received");
+    NS_TEST_EXPECT_MSG_EQ(pyB.GetCpp2PyStruct()->value, 2, "Segments are not shared");
+    pyB.PyRecvEnd();
+    NS_TEST_ASSERT_MSG_EQ(pyA.PyRecvBegin(), true, "The first simulation is received");
+    NS_TEST_EXPECT_MSG_EQ(pyA.GetCpp2PyStruct()->value, 1, "Segments are not shared");
+    pyA.PyRecvEnd();
+}
+
+/**
+ * \brief Simulations run one after the other on the segment of an experiment
+ */
+class MsgInterfaceResetTestCase : public TestCase
+{
+  public:
+    MsgInterfaceResetTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+MsgInterfaceResetTestCase::MsgInterfaceResetTestCase()
+    : TestCase("Reset between simulations on the same segment")
+{
+}
+
+void
+MsgInterfaceResetTestCase::DoRun()
+{
+    // the Python side, as Experiment creates it, outlives the simulations
+    TestMsgInterface py(true, false, true, 4096, "ns3-ai-test-segment-reset");
+    for (uint32_t episode = 0; episode < 3; ++episode)
+    {
+        // as Experiment.run does before launching every simulation
+        py.PyResetSync();
+        NS_TEST_EXPECT_MSG_EQ(py.PyCheckAttached(),
+                              false,
+                              "Episode " << episode << ": no simulation is attached yet");
+        NS_TEST_EXPECT_MSG_EQ(py.PyCheckFinished(),
+                              false,
+                              "Episode " << episode << ": the simulation is not over");
+        NS_TEST_EXPECT_MSG_EQ(py.PyRecvControl(),
+                              false,
+                              "Episode " << episode << ": no control message is left");
+        {
+            TestMsgInterface cpp(false, false, true, 4096, "ns3-ai-test-segment-reset");
+            NS_TEST_EXPECT_MSG_EQ(py.PyCheckAttached(),
+                                  true,
+                                  "Episode " << episode << ": the simulation is attached");
+            NS_TEST_EXPECT_MSG_EQ(cpp.CppGetStopRequested(),
+                                  false,
+                                  "Episode " << episode << ": no stop is requested");
+            int32_t code;
+            double value;
+            NS_TEST_EXPECT_MSG_EQ(cpp.CppRecvControl(code, value),
+                                  false,
+                                  "Episode " << episode << ": no control message is left");
+
+            // a full exchange, as every simulation does
+            NS_TEST_ASSERT_MSG_EQ(cpp.CppSendBegin(), true, "The simulation sends");
+            cpp.GetCpp2PyStruct()->value = episode;
+            cpp.CppSendEnd();
+            NS_TEST_ASSERT_MSG_EQ(py.PyRecvBegin(), true, "Python receives");
+            NS_TEST_EXPECT_MSG_EQ(py.GetCpp2PyStruct()->value, episode, "The message is sent");
+            py.PyRecvEnd();
+            NS_TEST_ASSERT_MSG_EQ(py.PySendBegin(), true, "Python sends");
+            py.GetPy2CppStruct()->value = episode + 10;
+            py.PySendEnd();
+            NS_TEST_ASSERT_MSG_EQ(cpp.CppRecvBegin(), true, "The simulation receives");
+            NS_TEST_EXPECT_MSG_EQ(cpp.GetPy2CppStruct()->value,
+                                  episode + 10,
+                                  "The reply is sent");
+            cpp.CppRecvEnd();
+
+            // the episode ends with messages and a state left behind
+            NS_TEST_EXPECT_MSG_EQ(cpp.CppSendControl(1, 0.5), true, "A control message is sent");
+            NS_TEST_EXPECT_MSG_EQ(py.PySendControl(2, 0.25), true, "A control message is sent");
+            NS_TEST_ASSERT_MSG_EQ(cpp.CppSendBegin(), true, "The simulation sends");
+            cpp.CppSendEnd();
+            py.PySetStop();
+            NS_TEST_EXPECT_MSG_EQ(cpp.CppGetStopRequested(), true, "The stop is requested");
+        }
+        NS_TEST_EXPECT_MSG_EQ(py.PyCheckFinished(), true, "The simulation is over");
+    }
+}
+
+/**
+ * \brief Tests of the message interface
+ */
+class AiMsgInterfaceTestSuite : public TestSuite
+{
+  public:
+    AiMsgInterfaceTestSuite();
+};
+
+AiMsgInterfaceTestSuite::AiMsgInterfaceTestSuite()
+    : TestSuite("ai-msg-interface", Type::UNIT)
+{
+    AddTestCase(new MsgInterfaceSegmentsTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new MsgInterfaceResetTestCase, TestCase::Duration::QUICK);
+}
+
+static AiMsgInterfaceTestSuite g_aiMsgInterfaceTestSuite; ///< the test suite